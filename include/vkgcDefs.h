@@ -1457,6 +1457,19 @@ public:
   /// @returns : Hash code associated this graphics pipeline.
   static uint64_t VKAPI_CALL GetPipelineHash(const GraphicsPipelineBuildInfo *pPipelineInfo);
 
+  /// Calculates the hash code of a graphics pipeline that uses the uber fetch shader, specialized for the vertex input
+  /// state observed at bind time. The specialized variant is the same pipeline built with that vertex input state and
+  /// enableUberFetchShader cleared, so the driver can compile it in the background, cache it under this hash, and keep
+  /// drawing with the uber fetch variant until it is ready.
+  ///
+  /// @param [in]  pPipelineInfo  Info used to build the uber fetch shader variant of this graphics pipeline
+  /// @param [in]  pVertexInput   Vertex input state observed at bind time
+  ///
+  /// @returns : Hash code of the vertex-input-specialized variant of this graphics pipeline.
+  static uint64_t VKAPI_CALL
+  GetUberFetchSpecializedPipelineHash(const GraphicsPipelineBuildInfo *pPipelineInfo,
+                                      const VkPipelineVertexInputStateCreateInfo *pVertexInput);
+
   /// Calculates compute pipeline hash code.
   ///
   /// @param [in]  pPipelineInfo  Info to build this compute pipeline
@@ -33,6 +33,7 @@
 #include "lgc/util/Internal.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #define DEBUG_TYPE "lgc-builder-impl-subgroup"
@@ -40,6 +41,12 @@
 using namespace lgc;
 using namespace llvm;
 
+// -subgroup-helper-functions: share the expansion of identical subgroup reductions and scans
+static cl::opt<bool> SubgroupHelperFunctions(
+    "subgroup-helper-functions",
+    cl::desc("Expand identical subgroup clustered reductions and scans once into a shared helper function"),
+    cl::init(false));
+
 // =====================================================================================================================
 // Get shader wave size.
 //
@@ -513,6 +520,78 @@ Value *BuilderImpl::CreateSubgroupShuffleDown(Value *const value, Value *const d
   return CreateSubgroupShuffle(value, index, instName);
 }
 
+// =====================================================================================================================
+// Create a subgroup clustered reduction or scan, either expanded inline or as a call to a shared helper function.
+//
+// With -subgroup-helper-functions, one internal helper is created per (operation, type, shader stage, wave size,
+// cluster size) tuple, so identical operations in a shader are expanded only once. A constant cluster size is folded
+// into the helper; otherwise it is passed as an argument. The helper is marked always-inline so that the final code
+// is unchanged; LowerSubgroupOps decides whether large helpers with many callers are kept as calls instead.
+//
+// @param opName : Name of the operation, used in the helper function name
+// @param expand : Method that expands the operation inline
+// @param groupArithOp : The group arithmetic operation.
+// @param value : An LLVM value.
+// @param inClusterSize : The expected cluster size.
+// @param instName : Name to give final instruction.
+Value *BuilderImpl::createSubgroupHelperCall(StringRef opName, SubgroupExpandFunc expand, GroupArithOp groupArithOp,
+                                             Value *const value, Value *const inClusterSize, const Twine &instName) {
+  if (!SubgroupHelperFunctions)
+    return (this->*expand)(groupArithOp, value, inClusterSize, instName);
+
+  Function *callerFunc = GetInsertBlock()->getParent();
+  Module *module = callerFunc->getParent();
+  const ShaderStageEnum shaderStage = getShaderStage(callerFunc).value();
+  const unsigned waveSize = getShaderWaveSize();
+  auto constClusterSize = dyn_cast<ConstantInt>(inClusterSize);
+
+  std::string helperName;
+  raw_string_ostream nameStream(helperName);
+  nameStream << lgcName::SubgroupHelperPrefix << opName << "." << static_cast<unsigned>(groupArithOp) << ".";
+  getTypeName(value->getType(), nameStream);
+  nameStream << "." << getShaderStageAbbreviation(shaderStage) << ".w" << waveSize;
+  if (constClusterSize)
+    nameStream << ".c" << std::min<uint64_t>(constClusterSize->getZExtValue(), waveSize);
+  nameStream.flush();
+
+  Function *helper = module->getFunction(helperName);
+  if (!helper) {
+    SmallVector<Type *, 2> argTys = {value->getType()};
+    if (!constClusterSize)
+      argTys.push_back(getInt32Ty());
+    auto funcTy = FunctionType::get(value->getType(), argTys, false);
+    helper = Function::Create(funcTy, GlobalValue::InternalLinkage, helperName, module);
+    helper->setCallingConv(CallingConv::C);
+    helper->addFnAttr(Attribute::AlwaysInline);
+    helper->addFnAttr(Attribute::Convergent);
+    helper->addFnAttr(Attribute::NoUnwind);
+    // The expansion only reads the live mask (inaccessible memory) when helper lanes are excluded
+    const auto &fragmentMode = m_pipelineState->getShaderModes()->getFragmentShaderMode();
+    if (shaderStage == ShaderStage::Fragment && fragmentMode.waveOpsExcludeHelperLanes)
+      helper->setMemoryEffects(MemoryEffects::inaccessibleMemOnly(ModRefInfo::Ref));
+    else
+      helper->setDoesNotAccessMemory();
+    helper->setWillReturn();
+    if (callerFunc->hasFnAttribute("target-features"))
+      helper->addFnAttr(callerFunc->getFnAttribute("target-features"));
+    setShaderStage(helper, shaderStage);
+
+    // Expand the operation into the helper. The caller's debug location does not belong to the helper.
+    IRBuilderBase::InsertPointGuard guard(*this);
+    SetInsertPoint(BasicBlock::Create(getContext(), ".entry", helper));
+    SetCurrentDebugLocation(DebugLoc());
+    Value *clusterSize = constClusterSize ? inClusterSize : helper->getArg(1);
+    CreateRet((this->*expand)(groupArithOp, helper->getArg(0), clusterSize, ""));
+  }
+
+  SmallVector<Value *, 2> args = {value};
+  if (!constClusterSize)
+    args.push_back(inClusterSize);
+  CallInst *call = CreateCall(helper, args, instName);
+  call->setCallingConv(helper->getCallingConv());
+  return call;
+}
+
 // =====================================================================================================================
 // Create a subgroup clustered reduction.
 //
@@ -522,6 +601,19 @@ Value *BuilderImpl::CreateSubgroupShuffleDown(Value *const value, Value *const d
 // @param instName : Name to give final instruction.
 Value *BuilderImpl::CreateSubgroupClusteredReduction(GroupArithOp groupArithOp, Value *const value,
                                                      Value *const inClusterSize, const Twine &instName) {
+  return createSubgroupHelperCall("reduce", &BuilderImpl::expandSubgroupClusteredReduction, groupArithOp, value,
+                                  inClusterSize, instName);
+}
+
+// =====================================================================================================================
+// Expand a subgroup clustered reduction inline at the current insert point.
+//
+// @param groupArithOp : The group arithmetic operation.
+// @param value : An LLVM value.
+// @param inClusterSize : The expected cluster size.
+// @param instName : Name to give final instruction.
+Value *BuilderImpl::expandSubgroupClusteredReduction(GroupArithOp groupArithOp, Value *const value,
+                                                     Value *const inClusterSize, const Twine &instName) {
   auto waveSize = getInt32(getShaderWaveSize());
   Value *clusterSize = CreateSelect(CreateICmpUGT(inClusterSize, waveSize), waveSize, inClusterSize);
 
@@ -629,6 +721,19 @@ Value *BuilderImpl::CreateSubgroupClusteredReduction(GroupArithOp groupArithOp,
 // @param instName : Name to give final instruction.
 Value *BuilderImpl::CreateSubgroupClusteredInclusive(GroupArithOp groupArithOp, Value *const value,
                                                      Value *const inClusterSize, const Twine &instName) {
+  return createSubgroupHelperCall("inclusive", &BuilderImpl::expandSubgroupClusteredInclusive, groupArithOp, value,
+                                  inClusterSize, instName);
+}
+
+// =====================================================================================================================
+// Expand a subgroup clustered inclusive scan inline at the current insert point.
+//
+// @param groupArithOp : The group arithmetic operation.
+// @param value : An LLVM value.
+// @param inClusterSize : The expected cluster size.
+// @param instName : Name to give final instruction.
+Value *BuilderImpl::expandSubgroupClusteredInclusive(GroupArithOp groupArithOp, Value *const value,
+                                                     Value *const inClusterSize, const Twine &instName) {
   auto waveSize = getInt32(getShaderWaveSize());
   Value *clusterSize = CreateSelect(CreateICmpUGT(inClusterSize, waveSize), waveSize, inClusterSize);
 
@@ -721,6 +826,19 @@ Value *BuilderImpl::CreateSubgroupClusteredInclusive(GroupArithOp groupArithOp,
 // @param instName : Name to give final instruction.
 Value *BuilderImpl::CreateSubgroupClusteredExclusive(GroupArithOp groupArithOp, Value *const value,
                                                      Value *const inClusterSize, const Twine &instName) {
+  return createSubgroupHelperCall("exclusive", &BuilderImpl::expandSubgroupClusteredExclusive, groupArithOp, value,
+                                  inClusterSize, instName);
+}
+
+// =====================================================================================================================
+// Expand a subgroup clustered exclusive scan inline at the current insert point.
+//
+// @param groupArithOp : The group arithmetic operation.
+// @param value : An LLVM value.
+// @param inClusterSize : The expected cluster size.
+// @param instName : Name to give final instruction.
+Value *BuilderImpl::expandSubgroupClusteredExclusive(GroupArithOp groupArithOp, Value *const value,
+                                                     Value *const inClusterSize, const Twine &instName) {
   auto waveSize = getInt32(getShaderWaveSize());
   Value *clusterSize = CreateSelect(CreateICmpUGT(inClusterSize, waveSize), waveSize, inClusterSize);
 
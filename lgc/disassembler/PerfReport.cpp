@@ -0,0 +1,441 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PerfReport.cpp
+ * @brief LGC disassembler library: static performance report of a pipeline ELF
+ *
+ * For each hardware stage in the PAL metadata, the report gives the register, LDS and scratch usage from the metadata,
+ * an occupancy estimate derived from them, and an instruction mix, waterfall loop count and scratch access count
+ * obtained by disassembling the stage's entry point.
+ ***********************************************************************************************************************
+ */
+#include "lgc/Disassembler.h"
+#include "llvm/BinaryFormat/MsgPackDocument.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCDisassembler/MCDisassembler.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstPrinter.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/MCTargetOptions.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/TargetSelect.h"
+#include <optional>
+
+using namespace llvm;
+using namespace object;
+
+namespace {
+
+// Instruction counts of one hardware stage.
+struct InstructionMix {
+  unsigned total = 0;
+  unsigned valu = 0;
+  unsigned salu = 0;
+  unsigned vmem = 0;
+  unsigned smem = 0;
+  unsigned lds = 0;
+  unsigned exports = 0;
+  unsigned branch = 0;
+  unsigned other = 0;
+  unsigned waterfallLoops = 0;
+  unsigned scratchLoads = 0;
+  unsigned scratchStores = 0;
+  unsigned sgprSpillLanes = 0;
+};
+
+// Class producing the performance report of an object.
+class PerfReporter {
+  MemoryBufferRef m_data;
+  std::unique_ptr<ELFObjectFileBase> m_objFile;
+  unsigned m_gfxMajor = 0;
+  std::unique_ptr<MCRegisterInfo> m_regInfo;
+  std::unique_ptr<MCAsmInfo> m_asmInfo;
+  std::unique_ptr<MCSubtargetInfo> m_subtargetInfo;
+  std::unique_ptr<MCInstrInfo> m_instrInfo;
+  std::unique_ptr<MCContext> m_context;
+  std::unique_ptr<MCObjectFileInfo> m_objFileInfo;
+  std::unique_ptr<MCDisassembler> m_instDisassembler;
+  std::unique_ptr<MCInstPrinter> m_instPrinter;
+
+public:
+  PerfReporter(MemoryBufferRef data) : m_data(data) {}
+
+  Error run(raw_ostream &ostream);
+
+private:
+  Error makeError(const Twine &message) const {
+    return make_error<StringError>((m_data.getBufferIdentifier() + ": " + message).str(), inconvertibleErrorCode());
+  }
+  Error setUpTarget();
+  std::optional<StringRef> getSymbolCode(StringRef name);
+  InstructionMix countInstructions(StringRef code);
+};
+
+} // anonymous namespace
+
+// =====================================================================================================================
+// Write a JSON performance report of a pipeline ELF into ostream. Nothing is written if the ELF cannot be decoded or
+// has no usable PAL metadata; an error is returned instead.
+//
+// @param data : The object file contents
+// @param ostream : The stream to write the report to
+Error lgc::reportObjectPerformance(MemoryBufferRef data, raw_ostream &ostream) {
+  InitializeAllTargetInfos();
+  InitializeAllTargetMCs();
+  InitializeAllDisassemblers();
+
+  return PerfReporter(data).run(ostream);
+}
+
+// =====================================================================================================================
+// Estimate the number of waves per SIMD that can be resident, limited by VGPRs, SGPRs (before GFX10) and LDS.
+//
+// @param gfxMajor : Major GFX IP version of the target
+// @param waveSize : Wave size of the stage
+// @param vgprCount : VGPRs used per lane
+// @param sgprCount : SGPRs used per wave
+// @param ldsSize : LDS bytes used per workgroup
+// @param threadsPerGroup : Threads per workgroup, or 0 if unknown
+unsigned lgc::estimateWaveOccupancy(unsigned gfxMajor, uint64_t waveSize, uint64_t vgprCount, uint64_t sgprCount,
+                                    uint64_t ldsSize, uint64_t threadsPerGroup) {
+  // Per-SIMD register file and wave slots. GFX10+ SIMDs have 1024 VGPRs per lane in wave32, half of that in wave64,
+  // and SGPRs do not limit occupancy. GFX9 SIMDs have 256 VGPRs and 800 SGPRs per wave64 lane.
+  const bool isGfx10Plus = gfxMajor >= 10;
+  const uint64_t maxWaves = isGfx10Plus ? 16 : 10;
+  const uint64_t vgprFile = isGfx10Plus ? (waveSize == 32 ? 1024 : 512) : 256;
+  const uint64_t vgprGranularity = isGfx10Plus ? 8 : 4;
+
+  uint64_t occupancy = std::min(maxWaves, vgprFile / alignTo(std::max<uint64_t>(vgprCount, 1), vgprGranularity));
+  if (!isGfx10Plus && sgprCount != 0)
+    occupancy = std::min(occupancy, uint64_t(800) / alignTo(sgprCount + 6, 16));
+  if (ldsSize != 0 && threadsPerGroup != 0) {
+    const uint64_t simdsPerCu = isGfx10Plus ? 2 : 4;
+    const uint64_t groupsPerCu = (64 * 1024) / ldsSize;
+    occupancy = std::min(occupancy, groupsPerCu * divideCeil(threadsPerGroup, waveSize) / simdsPerCu);
+  }
+  return std::max<uint64_t>(occupancy, 1);
+}
+
+// =====================================================================================================================
+// Decode the object file and set up the MC objects needed to disassemble it.
+Error PerfReporter::setUpTarget() {
+  Expected<std::unique_ptr<ObjectFile>> expectedObjFile = ObjectFile::createELFObjectFile(m_data);
+  if (!expectedObjFile) {
+    consumeError(expectedObjFile.takeError());
+    return makeError("Cannot decode ELF object file");
+  }
+  if (!isa<ELFObjectFileBase>(&*expectedObjFile.get()))
+    return makeError("Is not ELF object file");
+  m_objFile.reset(cast<ELFObjectFileBase>(expectedObjFile.get().release()));
+
+  Triple triple = m_objFile->makeTriple();
+  Expected<SubtargetFeatures> expectedFeatures = m_objFile->getFeatures();
+  if (!expectedFeatures)
+    return expectedFeatures.takeError();
+  std::string tripleName = triple.getTriple();
+  std::string error;
+  const Target *target = TargetRegistry::lookupTarget(tripleName, error);
+  if (!target)
+    return makeError("'" + tripleName + "': " + error);
+#if LLVM_MAIN_REVISION && LLVM_MAIN_REVISION < 444152
+  Optional<StringRef> mcpu = m_objFile->tryGetCPUName();
+#else
+  // New version of the code (also handles unknown version, which we treat as latest)
+  std::optional<StringRef> mcpu = m_objFile->tryGetCPUName();
+#endif
+  if (!mcpu)
+    return makeError("Cannot get CPU name");
+
+  // "gfx90a" is GFX9, "gfx1030" is GFX10, "gfx1100" is GFX11.
+  StringRef gfxName = *mcpu;
+  if (gfxName.consume_front("gfx"))
+    gfxName.take_front(gfxName.size() >= 4 ? 2 : 1).getAsInteger(10, m_gfxMajor);
+
+  m_regInfo.reset(target->createMCRegInfo(tripleName));
+  if (!m_regInfo)
+    return makeError("No register info for target");
+  m_asmInfo.reset(target->createMCAsmInfo(*m_regInfo, tripleName, MCTargetOptions()));
+  if (!m_asmInfo)
+    return makeError("No assembly info for target");
+  m_subtargetInfo.reset(target->createMCSubtargetInfo(tripleName, *mcpu, expectedFeatures->getString()));
+  if (!m_subtargetInfo)
+    return makeError("No subtarget info for target");
+  m_instrInfo.reset(target->createMCInstrInfo());
+  if (!m_instrInfo)
+    return makeError("No instruction info for target");
+  m_context = std::make_unique<MCContext>(triple, m_asmInfo.get(), m_regInfo.get(), m_subtargetInfo.get());
+  m_objFileInfo.reset(target->createMCObjectFileInfo(*m_context, /*PIC=*/false));
+  if (!m_objFileInfo)
+    return makeError("No MC object file info");
+  m_context->setObjectFileInfo(m_objFileInfo.get());
+  m_instDisassembler.reset(target->createMCDisassembler(*m_subtargetInfo, *m_context));
+  if (!m_instDisassembler)
+    return makeError("No disassembler for target");
+  m_instPrinter.reset(
+      target->createMCInstPrinter(triple, m_asmInfo->getAssemblerDialect(), *m_asmInfo, *m_instrInfo, *m_regInfo));
+  if (!m_instPrinter)
+    return makeError("No instruction printer for target");
+  return Error::success();
+}
+
+// =====================================================================================================================
+// Get the code of the function symbol with the given name, or std::nullopt if there is no such symbol. A symbol
+// without size extends to the end of its section.
+//
+// @param name : Symbol name
+std::optional<StringRef> PerfReporter::getSymbolCode(StringRef name) {
+  for (ELFSymbolRef symbol : m_objFile->symbols()) {
+    Expected<StringRef> symbolName = symbol.getName();
+    if (!symbolName) {
+      consumeError(symbolName.takeError());
+      continue;
+    }
+    if (*symbolName != name)
+      continue;
+    Expected<section_iterator> section = symbol.getSection();
+    if (!section) {
+      consumeError(section.takeError());
+      return std::nullopt;
+    }
+    if (*section == m_objFile->section_end())
+      return std::nullopt;
+    Expected<StringRef> sectionContents = (*section)->getContents();
+    Expected<uint64_t> value = symbol.getValue();
+    if (!sectionContents || !value) {
+      consumeError(sectionContents.takeError());
+      consumeError(value.takeError());
+      return std::nullopt;
+    }
+    StringRef contents = *sectionContents;
+    uint64_t offset = *value - (*section)->getAddress();
+    if (offset > contents.size())
+      return std::nullopt;
+    contents = contents.drop_front(offset);
+    if (symbol.getSize() != 0)
+      contents = contents.take_front(symbol.getSize());
+    return contents;
+  }
+  return std::nullopt;
+}
+
+// =====================================================================================================================
+// Disassemble the code of a hardware stage and count its instructions by class.
+//
+// A waterfall loop is a backward s_cbranch_execnz whose loop body contains a v_readfirstlane. Scratch accesses are
+// scratch_* instructions, so on targets that address scratch through buffer instructions spills only show up in the
+// scratch size. SGPR spills to VGPR lanes are counted as v_writelane instructions.
+//
+// @param code : Machine code of the stage
+InstructionMix PerfReporter::countInstructions(StringRef code) {
+  InstructionMix mix;
+  ArrayRef<uint8_t> bytes(reinterpret_cast<const uint8_t *>(code.data()), code.size());
+  SmallVector<uint64_t, 8> readFirstLaneOffsets;
+
+  for (uint64_t offset = 0; offset < bytes.size();) {
+    MCInst inst;
+    uint64_t size = 0;
+    MCDisassembler::DecodeStatus status =
+        m_instDisassembler->getInstruction(inst, size, bytes.slice(offset), offset, nulls());
+    if (status != MCDisassembler::Success || size == 0) {
+      offset += 4;
+      continue;
+    }
+
+    std::string instStr;
+    raw_string_ostream os(instStr);
+    m_instPrinter->printInst(&inst, /* Address= */ 0, /* Annot= */ "", *m_subtargetInfo, os);
+    StringRef mnemonic = StringRef(os.str()).ltrim().split(' ').first;
+
+    ++mix.total;
+    if (mnemonic.starts_with("v_")) {
+      ++mix.valu;
+      if (mnemonic.starts_with("v_readfirstlane"))
+        readFirstLaneOffsets.push_back(offset);
+      else if (mnemonic.starts_with("v_writelane"))
+        ++mix.sgprSpillLanes;
+    } else if (mnemonic.starts_with("s_load") || mnemonic.starts_with("s_buffer_") || mnemonic.starts_with("s_store") ||
+               mnemonic.starts_with("s_dcache") || mnemonic.starts_with("s_scratch_")) {
+      ++mix.smem;
+    } else if (mnemonic.starts_with("s_cbranch") || mnemonic.starts_with("s_branch") ||
+               mnemonic.starts_with("s_setpc") || mnemonic.starts_with("s_swappc")) {
+      ++mix.branch;
+      if (mnemonic == "s_cbranch_execnz" && inst.getNumOperands() != 0 && inst.getOperand(0).isImm()) {
+        int64_t target = int64_t(offset + 4) + int64_t(int16_t(inst.getOperand(0).getImm())) * 4;
+        if (target <= int64_t(offset) && any_of(readFirstLaneOffsets, [&](uint64_t readFirstLaneOffset) {
+              return int64_t(readFirstLaneOffset) >= target && readFirstLaneOffset < offset;
+            }))
+          ++mix.waterfallLoops;
+      }
+    } else if (mnemonic.starts_with("s_")) {
+      ++mix.salu;
+    } else if (mnemonic.starts_with("scratch_")) {
+      ++mix.vmem;
+      if (mnemonic.starts_with("scratch_store"))
+        ++mix.scratchStores;
+      else
+        ++mix.scratchLoads;
+    } else if (mnemonic.starts_with("buffer_") || mnemonic.starts_with("tbuffer_") ||
+               mnemonic.starts_with("global_") || mnemonic.starts_with("flat_") || mnemonic.starts_with("image_")) {
+      ++mix.vmem;
+    } else if (mnemonic.starts_with("ds_")) {
+      ++mix.lds;
+    } else if (mnemonic == "exp") {
+      ++mix.exports;
+    } else {
+      ++mix.other;
+    }
+    offset += size;
+  }
+  return mix;
+}
+
+// =====================================================================================================================
+// Produce the report. The PAL metadata is checked before anything is written.
+//
+// @param ostream : The stream to write the report to
+Error PerfReporter::run(raw_ostream &ostream) {
+  if (Error err = setUpTarget())
+    return err;
+
+  // Find the PAL metadata note.
+  msgpack::Document document;
+  bool haveMetadata = false;
+  for (ELFSectionRef section : m_objFile->sections()) {
+    if (section.getType() != ELF::SHT_NOTE)
+      continue;
+    Expected<StringRef> contents = section.getContents();
+    if (!contents)
+      return contents.takeError();
+    StringRef data = *contents;
+    while (data.size() >= 12 && !haveMetadata) {
+      unsigned nameSize = support::endian::read32le(data.data());
+      unsigned descSize = support::endian::read32le(data.data() + 4);
+      unsigned type = support::endian::read32le(data.data() + 8);
+      unsigned descOffset = 12 + alignTo<4>(nameSize);
+      unsigned totalSize = descOffset + alignTo<4>(descSize);
+      if (totalSize > data.size())
+        break;
+      if (type == ELF::NT_AMDGPU_METADATA && data.slice(12, 12 + nameSize).starts_with("AMDGPU"))
+        haveMetadata = document.readFromBlob(data.slice(descOffset, descOffset + descSize), false);
+      data = data.drop_front(totalSize);
+    }
+  }
+  if (!haveMetadata)
+    return makeError("No PAL metadata");
+
+  // Check the shape of the metadata rather than letting the msgpack accessors create missing nodes.
+  if (!document.getRoot().isMap())
+    return makeError("Malformed PAL metadata");
+  auto root = document.getRoot().getMap();
+  auto pipelines = root.find(StringRef("amdpal.pipelines"));
+  if (pipelines == root.end() || !pipelines->second.isArray() || pipelines->second.getArray().size() == 0 ||
+      !pipelines->second.getArray()[0].isMap())
+    return makeError("No pipeline in PAL metadata");
+  auto pipeline = pipelines->second.getArray()[0].getMap();
+  auto hwStagesNode = pipeline.find(StringRef(".hardware_stages"));
+  if (hwStagesNode == pipeline.end() || !hwStagesNode->second.isMap())
+    return makeError("No hardware stages in PAL metadata");
+  auto hwStages = hwStagesNode->second.getMap();
+
+  json::OStream json(ostream, /*IndentSize=*/2);
+  json.object([&] {
+    json.attribute("target", m_subtargetInfo->getCPU());
+    auto name = pipeline.find(StringRef(".name"));
+    if (name != pipeline.end() && name->second.getKind() == msgpack::Type::String)
+      json.attribute("name", name->second.getString());
+    json.attributeObject("stages", [&] {
+      for (auto &entry : hwStages) {
+        if (entry.first.getKind() != msgpack::Type::String || !entry.second.isMap())
+          continue;
+        StringRef stageName = entry.first.getString();
+        auto stage = entry.second.getMap();
+        auto getUInt = [&](StringRef key) -> uint64_t {
+          auto it = stage.find(key);
+          return it != stage.end() && it->second.getKind() == msgpack::Type::UInt ? it->second.getUInt() : 0;
+        };
+
+        const uint64_t waveSize = getUInt(".wavefront_size") ? getUInt(".wavefront_size") : 64;
+        const uint64_t vgprCount = getUInt(".vgpr_count");
+        const uint64_t sgprCount = getUInt(".sgpr_count");
+        const uint64_t ldsSize = getUInt(".lds_size");
+        uint64_t threadsPerGroup = 0;
+        auto dims = stage.find(StringRef(".threadgroup_dimensions"));
+        if (dims != stage.end() && dims->second.isArray()) {
+          threadsPerGroup = 1;
+          for (auto &dim : dims->second.getArray())
+            threadsPerGroup *= dim.getKind() == msgpack::Type::UInt ? std::max<uint64_t>(dim.getUInt(), 1) : 1;
+        }
+
+        std::string entryPoint = ("_amdgpu_" + stageName.drop_front() + "_main").str();
+        auto entryPointNode = stage.find(StringRef(".entry_point"));
+        if (entryPointNode != stage.end() && entryPointNode->second.getKind() == msgpack::Type::String)
+          entryPoint = entryPointNode->second.getString().str();
+        std::optional<StringRef> code = getSymbolCode(entryPoint);
+
+        json.attributeObject(stageName.drop_front(), [&] {
+          json.attribute("entryPoint", entryPoint);
+          json.attribute("waveSize", waveSize);
+          json.attribute("vgprs", vgprCount);
+          json.attribute("sgprs", sgprCount);
+          json.attribute("ldsBytes", ldsSize);
+          json.attribute("scratchBytes", getUInt(".scratch_memory_size"));
+          json.attribute("occupancy", lgc::estimateWaveOccupancy(m_gfxMajor, waveSize, vgprCount, sgprCount, ldsSize,
+                                                                 threadsPerGroup));
+          if (!code)
+            return;
+          InstructionMix mix = countInstructions(*code);
+          json.attribute("codeBytes", uint64_t(code->size()));
+          json.attributeObject("instructions", [&] {
+            json.attribute("total", mix.total);
+            json.attribute("valu", mix.valu);
+            json.attribute("salu", mix.salu);
+            json.attribute("vmem", mix.vmem);
+            json.attribute("smem", mix.smem);
+            json.attribute("lds", mix.lds);
+            json.attribute("export", mix.exports);
+            json.attribute("branch", mix.branch);
+            json.attribute("other", mix.other);
+          });
+          json.attribute("waterfallLoops", mix.waterfallLoops);
+          json.attributeObject("spills", [&] {
+            json.attribute("scratchStores", mix.scratchStores);
+            json.attribute("scratchLoads", mix.scratchLoads);
+            json.attribute("sgprToVgprLanes", mix.sgprSpillLanes);
+          });
+        });
+      }
+    });
+  });
+  ostream << "\n";
+  return Error::success();
+}
@@ -35,6 +35,7 @@
 #include "lgc/state/PalMetadata.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/BinaryFormat/ELF.h"
 #include "llvm/Object/ELFObjectFile.h"
@@ -190,6 +191,9 @@ public:
   // Get string index in output ELF.  Returns 0 if not found.
   unsigned findStringIndex(StringRef string);
 
+  // Add symbol to output ELF, recording it for findSymbol. Returns its index in the symbol table.
+  unsigned addSymbol(const ELF::Elf64_Sym &sym);
+
   // Find symbol in output ELF. Returns 0 if not found.
   unsigned findSymbol(unsigned nameIndex);
   unsigned findSymbol(StringRef name);
@@ -231,7 +235,7 @@ private:
   SmallVector<ELF::Elf64_Sym, 8> m_symbols;                  // Symbol table
   SmallVector<ELF::Elf64_Rel, 8> m_relocations;              // Relocations
   SmallVector<ELF::Elf64_Rela, 8> m_relocationsA;            // Relocations with explicit addend
-  StringMap<unsigned> m_symbolMap;                           // Map from name to symbol index
+  DenseMap<unsigned, unsigned> m_symbolMap;                  // Map from name string index to symbol index
   std::string m_strings;                                     // Strings for string table
   StringMap<unsigned> m_stringMap;                           // Map from string to string table index
   std::string m_notes;                                       // Notes to go in .note section
@@ -612,17 +616,27 @@ unsigned ElfLinkerImpl::findStringIndex(StringRef string) {
   return m_stringMap.lookup(string);
 }
 
+// =====================================================================================================================
+// Add symbol to output ELF
+//
+// @param sym : Symbol to add
+// @returns : Index in symbol table
+unsigned ElfLinkerImpl::addSymbol(const ELF::Elf64_Sym &sym) {
+  unsigned symIndex = m_symbols.size();
+  m_symbols.push_back(sym);
+  // Only the first symbol of a given name is found by findSymbol.
+  if (sym.st_name != 0)
+    m_symbolMap.try_emplace(sym.st_name, symIndex);
+  return symIndex;
+}
+
 // =====================================================================================================================
 // Find symbol in output ELF
 //
 // @param nameIndex : Index of symbol name in string table
 // @returns : Index in symbol table, or 0 if not found
 unsigned ElfLinkerImpl::findSymbol(unsigned nameIndex) {
-  for (auto &sym : getSymbols()) {
-    if (sym.st_name == nameIndex)
-      return &sym - getSymbols().data();
-  }
-  return 0;
+  return m_symbolMap.lookup(nameIndex);
 }
 
 // =====================================================================================================================
@@ -951,7 +965,7 @@ void OutputSection::addSymbol(const object::ELFSymbolRef &elfSymRef, unsigned in
   newSym.st_size = elfSymRef.getSize();
   if (m_linker->findSymbol(newSym.st_name) != 0)
     report_fatal_error("Duplicate symbol '" + name + "'");
-  m_linker->getSymbols().push_back(newSym);
+  m_linker->addSymbol(newSym);
 }
 
 // Add a relocation to the output elf
@@ -971,8 +985,7 @@ void OutputSection::addRelocation(object::ELFRelocationRef relocRef, StringRef i
     newSym.st_shndx = getIndex();
     newSym.st_value = relocSectionOffset + cantFail(relocSymRef.getValue());
     newSym.st_size = relocSymRef.getSize();
-    rodataSymIdx = m_linker->getSymbols().size();
-    m_linker->getSymbols().push_back(newSym);
+    rodataSymIdx = m_linker->addSymbol(newSym);
   }
   if (sectType == ELF::SHT_REL) {
     ELF::Elf64_Rel newReloc = {};
@@ -762,6 +762,19 @@ public:
   llvm::Value *CreateQuadAny(llvm::Value *const value, bool requireFullQuads, const llvm::Twine &instName = "");
 
 private:
+  // Method that expands a subgroup clustered reduction or scan inline.
+  typedef llvm::Value *(BuilderImpl::*SubgroupExpandFunc)(GroupArithOp, llvm::Value *const, llvm::Value *const,
+                                                          const llvm::Twine &);
+
+  llvm::Value *createSubgroupHelperCall(llvm::StringRef opName, SubgroupExpandFunc expand, GroupArithOp groupArithOp,
+                                        llvm::Value *const value, llvm::Value *const inClusterSize,
+                                        const llvm::Twine &instName);
+  llvm::Value *expandSubgroupClusteredReduction(GroupArithOp groupArithOp, llvm::Value *const value,
+                                                llvm::Value *const inClusterSize, const llvm::Twine &instName);
+  llvm::Value *expandSubgroupClusteredInclusive(GroupArithOp groupArithOp, llvm::Value *const value,
+                                                llvm::Value *const inClusterSize, const llvm::Twine &instName);
+  llvm::Value *expandSubgroupClusteredExclusive(GroupArithOp groupArithOp, llvm::Value *const value,
+                                                llvm::Value *const inClusterSize, const llvm::Twine &instName);
   unsigned getShaderSubgroupSize();
   unsigned getShaderWaveSize();
   llvm::Value *createGroupArithmeticIdentity(GroupArithOp groupArithOp, llvm::Type *const type);
@@ -42,6 +42,7 @@
 
 namespace lgc {
 
+class CallSiteIndexResult;
 class PipelineState;
 struct WorkaroundFlags;
 
@@ -125,8 +126,10 @@ public:
 private:
   void updateFragColors(llvm::CallInst *callInst, llvm::MutableArrayRef<ColorOutputValueInfo> outFragColors,
                         BuilderBase &builder);
-  void collectExportInfoForGenericOutputs(llvm::Function *fragEntryPoint, BuilderBase &builder);
-  void collectExportInfoForBuiltinOutput(llvm::Function *module, BuilderBase &builder);
+  void collectExportInfoForGenericOutputs(llvm::Function *fragEntryPoint, const CallSiteIndexResult &callSiteIndex,
+                                          BuilderBase &builder);
+  void collectExportInfoForBuiltinOutput(llvm::Function *module, const CallSiteIndexResult &callSiteIndex,
+                                         BuilderBase &builder);
   llvm::Value *generateValueForOutput(llvm::Value *value, llvm::Type *outputTy, BuilderBase &builder);
   void createTailJump(llvm::Function *fragEntryPoint, BuilderBase &builder, llvm::Value *isDualSource);
 
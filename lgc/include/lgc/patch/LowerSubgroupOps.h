@@ -55,6 +55,7 @@ public:
   static llvm::StringRef name() { return "Lower subgroup ops"; }
 
 private:
+  void decideSubgroupHelperInlining(llvm::Module &module);
   void replace(llvm::CallInst &old, llvm::Value *op);
 
   void visitElect(SubgroupElectOp &op);
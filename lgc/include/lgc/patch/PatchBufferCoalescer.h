@@ -0,0 +1,75 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchBufferCoalescer.h
+ * @brief LLPC header file: contains declaration of class lgc::PatchBufferCoalescer.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/PassManager.h"
+
+namespace lgc {
+
+// =====================================================================================================================
+// Represents the pass that merges adjacent dword buffer loads and stores on the same descriptor, as produced by
+// PatchBufferOp, into dwordx2, dwordx3 and dwordx4 operations.
+class PatchBufferCoalescer : public llvm::PassInfoMixin<PatchBufferCoalescer> {
+public:
+  llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &analysisManager);
+
+  static llvm::StringRef name() { return "Coalesce adjacent buffer loads and stores"; }
+
+  // A raw.buffer.load, s.buffer.load or raw.buffer.store call, with its offset split into a base and a constant
+  struct BufferAccess {
+    llvm::CallInst *call;
+    unsigned intrinsicId;
+    llvm::Value *desc;
+    llvm::Value *base;    // Variable part of the offset, or null
+    llvm::Value *soffset; // Null for s.buffer.load
+    unsigned aux;
+    bool isInvariant;
+    int64_t offset;  // Constant part of the offset in bytes
+    unsigned dwords; // Size of the access in dwords
+  };
+
+private:
+  void flushLoads(bool keepInvariant);
+  void flushStores();
+  void coalesce(llvm::SmallVectorImpl<BufferAccess> &accesses);
+  void mergeLoads(llvm::ArrayRef<BufferAccess> loads);
+  void mergeStores(llvm::ArrayRef<BufferAccess> stores);
+
+  std::unique_ptr<llvm::IRBuilder<>> m_builder;      // The IRBuilder
+  llvm::SmallVector<BufferAccess, 8> m_pendingLoads;  // Loads since the last instruction that may write memory
+  llvm::SmallVector<BufferAccess, 8> m_pendingStores; // Stores since the last instruction that may access memory
+  unsigned m_scalarThreshold = 0;                     // Merged loads of up to this many dwords are not created
+  bool m_changed = false;                             // Whether anything was merged
+};
+
+} // namespace lgc
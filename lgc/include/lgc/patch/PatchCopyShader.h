@@ -32,6 +32,7 @@
 
 #include "lgc/patch/Patch.h"
 #include "lgc/patch/SystemValues.h"
+#include "lgc/state/CallSiteIndex.h"
 #include "lgc/state/PipelineShaders.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/util/BuilderBase.h"
@@ -48,7 +49,7 @@ public:
 
 private:
   void exportOutput(unsigned streamId, BuilderBase &builder);
-  void collectGsGenericOutputInfo(llvm::Function *gsEntryPoint);
+  void collectGsGenericOutputInfo(llvm::Function *gsEntryPoint, const CallSiteIndexResult &callSiteIndex);
 
   llvm::Value *calcGsVsRingOffsetForInput(unsigned location, unsigned compIdx, unsigned streamId, BuilderBase &builder);
 
@@ -44,6 +44,7 @@
 
 namespace lgc {
 
+class CallSiteIndexResult;
 class UserDataOp;
 
 // =====================================================================================================================
@@ -82,6 +83,8 @@ private:
     llvm::Instruction *load = nullptr;
     unsigned dwordOffset = 0;
     unsigned dwordSize = 0;
+    // Static execution frequency of the load relative to the function entry, at least 1
+    double weight = 1.0;
   };
 
   // Per-merged-shader-stage gathered user data usage information.
@@ -93,6 +96,8 @@ private:
     unsigned spillTableEntryArgIdx = 0;
     // Whether there is any dynamic indexing into lgc.user.data pointers.
     bool haveDynamicUserDataLoads = false;
+    // Whether spillColdUserData moved user data to the spill table to keep more frequently used user data in SGPRs.
+    bool haveSpilledColdUserData = false;
     llvm::SmallVector<UserDataOp *> userDataOps;
     llvm::SmallVector<UserDataLoad> loads;
     // Minimum number of consecutive dwords for a statically known load *starting* at a given offset into user data
@@ -110,7 +115,10 @@ private:
   void setupComputeWithCalls(llvm::Module *module);
 
   // Gather user data usage in all shaders.
-  void gatherUserDataUsage(llvm::Module *module);
+  void gatherUserDataUsage(llvm::Module *module, const CallSiteIndexResult &callSiteIndex);
+
+  // Weight user data loads by the static execution frequency of their blocks.
+  void computeUserDataLoadWeights(llvm::FunctionAnalysisManager &funcAnalysisManager);
 
   llvm::Value *loadUserData(const UserDataUsage &userDataUsage, llvm::Value *spillTable, llvm::Type *type,
                             unsigned dwordOffset, BuilderBase &builder);
@@ -138,6 +146,8 @@ private:
   void finalizeUserDataArgs(llvm::SmallVectorImpl<UserDataArg> &userDataArgs,
                             llvm::ArrayRef<UserDataArg> specialUserDataArgs, llvm::IRBuilder<> &builder);
 
+  bool spillColdUserData(UserDataUsage &userDataUsage, unsigned sgprsAvailable, bool haveSpillTable);
+
   uint64_t pushFixedShaderArgTys(llvm::SmallVectorImpl<llvm::Type *> &argTys) const;
 
   // Information about each cps exit (return or cps.jump) used for exit unification.
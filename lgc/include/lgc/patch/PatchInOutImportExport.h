@@ -32,6 +32,7 @@
 
 #include "SystemValues.h"
 #include "lgc/patch/Patch.h"
+#include "lgc/state/CallSiteIndex.h"
 #include "lgc/state/PipelineShaders.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
@@ -230,6 +231,7 @@ private:
   llvm::SmallDenseMap<unsigned, std::array<llvm::Value *, 4>>
       m_attribExports;                      // Export info of vertex attributes: <attrib loc, attrib values>
   PipelineState *m_pipelineState = nullptr; // Pipeline state from PipelineStateWrapper pass
+  const CallSiteIndexResult *m_callSiteIndex = nullptr; // lgc.* call sites from CallSiteIndex pass
 
   std::set<unsigned> m_expLocs; // The locations that already have an export instruction for the vertex shader.
   const std::array<unsigned char, 4> *m_buffFormats; // The format of MTBUF instructions for specified GFX
@@ -34,6 +34,7 @@
 #include "lgc/state/PipelineShaders.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/util/BuilderBase.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 namespace lgc {
 
@@ -46,7 +47,9 @@ public:
   static llvm::StringRef name() { return "Patch for initialize workgroup memory"; }
 
 private:
-  void initializeWithZero(llvm::GlobalVariable *lds, BuilderBase &builder);
+  void collectOverwrittenGlobals(llvm::ArrayRef<llvm::GlobalVariable *> workgroupGlobals,
+                                 llvm::SmallPtrSetImpl<llvm::GlobalVariable *> &overwrittenGlobals);
+  void initializeWithZero(llvm::GlobalVariable *lds, unsigned clearSize, BuilderBase &builder);
   unsigned getTypeSizeInDwords(llvm::Type *inputTy);
 
   llvm::DenseMap<llvm::GlobalVariable *, llvm::Value *> m_globalLdsOffsetMap;
@@ -77,11 +77,13 @@ private:
   void clearInactiveBuiltInOutput();
   void clearUnusedOutput();
   void clearUndefinedOutput();
+  void clearDeadOutputExports();
 
   void matchGenericInOut();
   void mapBuiltInToGenericInOut();
 
   void mapGsBuiltInOutput(unsigned builtInId, unsigned elemCount);
+  void compactMeshOutputs();
 
   void updateInputLocInfoMapWithUnpack();
   void updateOutputLocInfoMapWithUnpack();
@@ -56,6 +56,7 @@ class Value;
 namespace lgc {
 
 class BuilderBase;
+class CallSiteIndexResult;
 class PipelineState;
 
 // =====================================================================================================================
@@ -195,7 +196,7 @@ public:
   // Object methods called during PatchEntryPointMutate
 
   // Gather usage of shader inputs from before PatchEntryPointMutate
-  void gatherUsage(llvm::Module &module);
+  void gatherUsage(const CallSiteIndexResult &callSiteIndex);
 
   // Fix up uses of shader inputs to use entry args directly
   void fixupUses(llvm::Module &module, PipelineState *pipelineState, bool computeWithIndirectCall);
@@ -0,0 +1,91 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  CallSiteIndex.h
+ * @brief LLPC header file: contains declaration of class lgc::CallSiteIndex
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "lgc/CommonDefs.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class CallInst;
+class Function;
+} // namespace llvm
+
+namespace lgc {
+
+// =====================================================================================================================
+// Result of the CallSiteIndex analysis: the lgc.* function declarations in the module, sorted by name, each with its
+// call sites grouped by the shader stage of the calling function. A lookup by name prefix is a binary search plus a
+// walk over the matching declarations, so it costs O(log(declarations) + results) instead of a whole-module scan.
+//
+// The index is a snapshot of the module at the time the analysis ran. A pass that creates or erases lgc.* calls must
+// not preserve the analysis. Declarations and calls are held by weak value handles, so ones erased since the analysis
+// ran, even by a pass that wrongly preserved it, are skipped instead of being returned as dangling pointers.
+class CallSiteIndexResult {
+  friend class CallSiteIndex;
+
+public:
+  void getDeclarations(llvm::StringRef prefix, llvm::SmallVectorImpl<llvm::Function *> &decls) const;
+  void getCalls(llvm::StringRef prefix, ShaderStageEnum stage, llvm::SmallVectorImpl<llvm::CallInst *> &calls) const;
+  void getCalls(llvm::StringRef prefix, llvm::SmallVectorImpl<llvm::CallInst *> &calls) const;
+
+private:
+  struct CallSite {
+    ShaderStageEnum stage; // Shader stage of the calling function, ShaderStage::Invalid if it has none
+    llvm::WeakVH call;     // The call instruction, null once erased
+  };
+
+  struct Declaration {
+    std::string name;                     // Name of the declaration
+    llvm::WeakVH decl;                    // The declaration itself, null once erased
+    unsigned order;                       // Position of the declaration in the module
+    llvm::SmallVector<CallSite, 4> calls; // Call sites, sorted by shader stage
+  };
+
+  template <typename Callback> void forEachDeclaration(llvm::StringRef prefix, Callback callback) const;
+
+  std::vector<Declaration> m_declarations; // lgc.* declarations, sorted by name
+};
+
+// =====================================================================================================================
+// Analysis pass that indexes the call sites of lgc.* functions in the pipeline module
+class CallSiteIndex : public llvm::AnalysisInfoMixin<CallSiteIndex> {
+public:
+  using Result = CallSiteIndexResult;
+  CallSiteIndexResult run(llvm::Module &module, llvm::ModuleAnalysisManager &);
+  static llvm::AnalysisKey Key;
+};
+
+} // namespace lgc
@@ -68,6 +68,9 @@ const static char NggWriteGsOutput[] = "lgc.ngg.write.GS.output.";
 const static char NggReadGsOutput[] = "lgc.ngg.read.GS.output.";
 const static char NggPrimShaderEntryPoint[] = "lgc.shader.PRIM.main";
 
+// Prefix of internal helper functions shared by identical subgroup reductions and scans
+const static char SubgroupHelperPrefix[] = "lgc.subgroup.helper.";
+
 const static char EntryPointPrefix[] = "lgc.shader.";
 const static char CopyShaderEntryPoint[] = "lgc.shader.COPY.main";
 const static char NullFsEntryPoint[] = "lgc.shader.FS.null.main";
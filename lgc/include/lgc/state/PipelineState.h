@@ -36,6 +36,7 @@
 #include "lgc/state/ResourceUsage.h"
 #include "lgc/state/ShaderModes.h"
 #include "lgc/state/ShaderStage.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/PassManager.h"
@@ -269,6 +270,9 @@ public:
   // Set up the pipeline state from the pipeline module.
   void readState(llvm::Module *module);
 
+  // Set up the parts of the pipeline state that come from the shader modules rather than from recorded state.
+  void readModuleDerivedState(llvm::Module *module);
+
   // Get user data nodes
   llvm::ArrayRef<ResourceNode> getUserDataNodes() const { return m_userDataNodes; }
 
@@ -560,6 +564,7 @@ private:
   llvm::MDString *getResourceTypeName(ResourceNodeType type);
   ResourceNodeType getResourceTypeFromName(llvm::MDString *typeName);
   bool matchResourceNode(const ResourceNode &node, ResourceNodeType nodeType, uint64_t descSet, unsigned binding) const;
+  void buildResourceNodeIndex() const;
 
   // Device index handling
   void recordDeviceIndex(llvm::Module *module);
@@ -581,6 +586,7 @@ private:
   bool m_emitLgc = false;  // Whether -emit-lgc is on
   // Whether generating pipeline or unlinked part-pipeline
   PipelineLink m_pipelineLink = PipelineLink::WholePipeline;
+  bool m_stateInMemory = false;                         // Whether irLink() left the state in memory, not in IR
   ShaderStageMask m_stageMask;                          // Mask of active shader stages
   bool m_preRasterHasGs = false;                        // Whether pre-rasterization part has a geometry shader
   bool m_computeLibrary = false;                        // Whether pipeline is in fact a compute library
@@ -589,6 +595,21 @@ private:
   std::vector<ShaderOptions> m_shaderOptions;           // Per-shader options
   std::unique_ptr<ResourceNode[]> m_allocUserDataNodes; // Allocated buffer for user data
   llvm::ArrayRef<ResourceNode> m_userDataNodes;         // Top-level user data node table
+
+  // Entry in the index of descriptor nodes searched by findResourceNode
+  struct ResourceNodeIndexEntry {
+    unsigned order;              // Position of the node in findResourceNode's search order
+    unsigned visibility;         // Visibility of the node combined with that of its containing table
+    const ResourceNode *topNode; // Top-level user data node that contains (or is equal to) the node
+    const ResourceNode *node;    // The indexed node
+  };
+  // Descriptor nodes keyed by {set,binding}, in search order. Built on first use by findResourceNode.
+  mutable llvm::DenseMap<std::pair<uint64_t, unsigned>, llvm::SmallVector<ResourceNodeIndexEntry, 1>>
+      m_resourceNodeIndex;
+  // Descriptor nodes that can match a range of bindings when useResourceBindingRange is set, keyed by set, in search
+  // order
+  mutable llvm::DenseMap<uint64_t, llvm::SmallVector<ResourceNodeIndexEntry, 4>> m_rangedResourceNodes;
+  mutable bool m_resourceNodeIndexValid = false; // Whether the two members above are up to date
   // Cached MDString for each resource node type
   llvm::MDString *m_resourceNodeTypeNames[unsigned(ResourceNodeType::Count)] = {};
   // Allocated buffers for immutable sampler data
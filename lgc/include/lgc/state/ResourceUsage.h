@@ -470,6 +470,18 @@ struct ResourceUsage {
       // are mapped)
       unsigned genericOutputMapLocCount = 0;
       unsigned perPrimitiveGenericOutputMapLocCount = 0;
+
+      // Dword offsets of mapped locations of per-vertex/per-primitive outputs within the LDS space of a vertex or a
+      // primitive, with an extra trailing entry that gives the stride. Empty if each location occupies 4 dwords.
+      std::vector<unsigned> vertexOutputLocOffsets;
+      std::vector<unsigned> primitiveOutputLocOffsets;
+
+      // Get the dword offset of a mapped output location within the LDS space of a vertex or a primitive. Passing the
+      // mapped location count returns the stride.
+      unsigned getOutputLdsOffset(bool isPerPrimitive, unsigned location) const {
+        const auto &locOffsets = isPerPrimitive ? primitiveOutputLocOffsets : vertexOutputLocOffsets;
+        return locOffsets.empty() ? 4 * location : locOffsets[location];
+      }
     } mesh;
 
     struct {
@@ -30,6 +30,7 @@
  */
 #pragma once
 
+#include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 
 namespace lgc {
@@ -40,4 +41,24 @@ namespace lgc {
 // @param ostream : The stream to disassemble into
 void disassembleObject(llvm::MemoryBufferRef data, llvm::raw_ostream &ostream);
 
+// Write a JSON static performance report of a pipeline ELF into ostream: per hardware stage register, LDS and scratch
+// usage, estimated occupancy, instruction mix, waterfall loops and spills. Returns an error, and writes nothing, if
+// the object cannot be decoded or has no usable PAL metadata.
+//
+// @param data : The object file contents
+// @param ostream : The stream to write the report to
+llvm::Error reportObjectPerformance(llvm::MemoryBufferRef data, llvm::raw_ostream &ostream);
+
+// Estimate the number of waves per SIMD that can be resident for a hardware stage with the given resource usage. This
+// is the occupancy model shared by the performance report and the compute pipeline auto-tuner.
+//
+// @param gfxMajor : Major GFX IP version of the target
+// @param waveSize : Wave size of the stage
+// @param vgprCount : VGPRs used per lane
+// @param sgprCount : SGPRs used per wave
+// @param ldsSize : LDS bytes used per workgroup
+// @param threadsPerGroup : Threads per workgroup, or 0 if unknown
+unsigned estimateWaveOccupancy(unsigned gfxMajor, uint64_t waveSize, uint64_t vgprCount, uint64_t sgprCount,
+                               uint64_t ldsSize, uint64_t threadsPerGroup);
+
 } // namespace lgc
@@ -29,7 +29,9 @@
  *
  * This pass is the place for combining / optimizing high-level cooperative matrix ops (@lgc.cooperative.matrix.*).
  *
- * In particular, this pass reduces the number of transpose and convert operations.
+ * In particular, this pass reduces the number of transpose and convert operations. Optionally, it also
+ * software-pipelines cooperative matrix loads that feed muladds in a loop, so that the load for the next iteration is
+ * in flight while the muladds of the current iteration execute.
  ***********************************************************************************************************************
  */
 #include "lgc/patch/CombineCooperativeMatrix.h"
@@ -38,6 +40,12 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include <optional>
 
 #define DEBUG_TYPE "lgc-combine-cooperative-matrix"
@@ -45,6 +53,12 @@
 using namespace llvm;
 using namespace lgc;
 
+// -coop-matrix-pipeline-loads: issue cooperative matrix loads in loops one iteration ahead of their muladds
+static cl::opt<bool> PipelineLoads("coop-matrix-pipeline-loads",
+                                   cl::desc("Issue cooperative matrix loads in loops one iteration ahead of the "
+                                            "muladds that use them"),
+                                   cl::init(false));
+
 namespace {
 
 struct Shape {
@@ -94,6 +108,28 @@ private:
   std::vector<Instruction *> m_eraseList;
 };
 
+// Software pipelining of cooperative matrix loads in loops. A load whose only users are muladds is replaced by a phi of
+// a load for the first iteration, issued in the preheader, and a load for the next iteration, issued in the loop body.
+class CooperativeMatrixLoadPipeliner {
+public:
+  CooperativeMatrixLoadPipeliner(Function &function, LoopInfo &loopInfo, DominatorTree &domTree)
+      : m_function(function), m_loopInfo(loopInfo), m_domTree(domTree), b(function.getContext()) {}
+
+  bool run();
+
+private:
+  bool isCandidate(CallInst *load, Loop *loop, SmallVectorImpl<PHINode *> &headerPhis) const;
+  bool canRematerialize(Value *value, Loop *loop, SmallVectorImpl<PHINode *> &headerPhis) const;
+  Value *rematerialize(Value *value, Loop *loop, BasicBlock *incomingBlock, DenseMap<Value *, Value *> &clones);
+  Instruction *getPrefetchPos(CallInst *load, Loop *loop, ArrayRef<PHINode *> headerPhis) const;
+  void pipelineLoad(CallInst *load, Loop *loop, ArrayRef<PHINode *> headerPhis);
+
+  Function &m_function;
+  LoopInfo &m_loopInfo;
+  DominatorTree &m_domTree;
+  IRBuilder<> b;
+};
+
 } // anonymous namespace
 
 // =====================================================================================================================
@@ -925,6 +961,205 @@ Value *CooperativeMatrixCombiner::tryFoldTimesScalar(CallInst *timesScalarLo, Ca
   return timesScalarPacked;
 }
 
+// =====================================================================================================================
+// Run the load pipeliner.
+//
+// @returns : True if the function was modified by the transformation and false otherwise
+bool CooperativeMatrixLoadPipeliner::run() {
+  SmallVector<CallInst *> loads;
+  for (Function &fn : m_function.getParent()->functions()) {
+    if (!fn.isDeclaration() || !fn.getName().starts_with(lgcName::CooperativeMatrixLoad))
+      continue;
+    for (User *user : fn.users()) {
+      if (auto *call = dyn_cast<CallInst>(user)) {
+        if (call->getFunction() == &m_function)
+          loads.push_back(call);
+      }
+    }
+  }
+
+  bool changed = false;
+  for (CallInst *load : loads) {
+    Loop *loop = m_loopInfo.getLoopFor(load->getParent());
+    SmallVector<PHINode *, 2> headerPhis;
+    if (!loop || !isCandidate(load, loop, headerPhis))
+      continue;
+    pipelineLoad(load, loop, headerPhis);
+    changed = true;
+  }
+  return changed;
+}
+
+// =====================================================================================================================
+// Check whether a cooperative matrix load can be issued one iteration ahead.
+//
+// @param load : The cooperative matrix load
+// @param loop : The innermost loop containing the load
+// @param [out] headerPhis : The loop header phis that the address of the load depends on
+// @returns : True if the load can be pipelined
+bool CooperativeMatrixLoadPipeliner::isCandidate(CallInst *load, Loop *loop,
+                                                 SmallVectorImpl<PHINode *> &headerPhis) const {
+  // The load must be executed on every iteration, and the loop must be in simplified form.
+  BasicBlock *latch = loop->getLoopLatch();
+  if (!loop->getLoopPreheader() || !latch || !m_domTree.dominates(load->getParent(), latch))
+    return false;
+
+  // The load for the iteration after the last one is executed speculatively. That is only safe for memory where an out
+  // of bounds access does not fault: buffers are range checked, and so is LDS.
+  unsigned addrSpace = load->getArgOperand(0)->getType()->getPointerAddressSpace();
+  if (addrSpace != ADDR_SPACE_BUFFER_FAT_POINTER && addrSpace != ADDR_SPACE_LOCAL)
+    return false;
+  unsigned memoryAccess = cast<ConstantInt>(load->getArgOperand(5))->getZExtValue();
+  if (memoryAccess & Builder::MemoryAccessVolatileMask)
+    return false;
+
+  if (load->use_empty())
+    return false;
+  for (User *user : load->users()) {
+    auto *call = dyn_cast<CallInst>(user);
+    Function *callee = call ? call->getCalledFunction() : nullptr;
+    if (!callee || !callee->getName().starts_with(lgcName::CooperativeMatrixMulAdd) || !loop->contains(call))
+      return false;
+  }
+
+  // Moving the load across iterations is only valid if nothing in the loop can change the memory it reads, including
+  // other invocations writing LDS on the other side of a barrier.
+  for (BasicBlock *block : loop->blocks()) {
+    for (Instruction &inst : *block) {
+      if (inst.mayWriteToMemory())
+        return false;
+      if (auto *call = dyn_cast<CallBase>(&inst); call && call->isConvergent())
+        return false;
+    }
+  }
+
+  // Loads from a loop-invariant address are left to LICM.
+  return canRematerialize(load->getArgOperand(0), loop, headerPhis) &&
+         canRematerialize(load->getArgOperand(1), loop, headerPhis) && !headerPhis.empty();
+}
+
+// =====================================================================================================================
+// Check whether a value computed in the loop can be recomputed for another iteration, that is, whether it is a pure
+// function of loop invariants and loop header phis.
+//
+// @param value : The value
+// @param loop : The loop
+// @param [in/out] headerPhis : The loop header phis that the value depends on
+// @returns : True if the value can be recomputed
+bool CooperativeMatrixLoadPipeliner::canRematerialize(Value *value, Loop *loop,
+                                                      SmallVectorImpl<PHINode *> &headerPhis) const {
+  auto *inst = dyn_cast<Instruction>(value);
+  if (!inst || !loop->contains(inst))
+    return true;
+  if (auto *phi = dyn_cast<PHINode>(inst)) {
+    if (phi->getParent() != loop->getHeader())
+      return false;
+    if (!is_contained(headerPhis, phi))
+      headerPhis.push_back(phi);
+    return true;
+  }
+  if (inst->mayReadFromMemory() || !isSafeToSpeculativelyExecute(inst))
+    return false;
+  return all_of(inst->operands(), [&](Value *operand) { return canRematerialize(operand, loop, headerPhis); });
+}
+
+// =====================================================================================================================
+// Recompute a value for the iteration entered from the given block, at the current insert point. Loop header phis are
+// replaced by their incoming value from that block.
+//
+// @param value : The value, for which canRematerialize returned true
+// @param loop : The loop
+// @param incomingBlock : The preheader for the first iteration, or the latch for the next iteration
+// @param [in/out] clones : Instructions already recomputed
+// @returns : The recomputed value
+Value *CooperativeMatrixLoadPipeliner::rematerialize(Value *value, Loop *loop, BasicBlock *incomingBlock,
+                                                     DenseMap<Value *, Value *> &clones) {
+  auto *inst = dyn_cast<Instruction>(value);
+  if (!inst || !loop->contains(inst))
+    return value;
+  if (auto *phi = dyn_cast<PHINode>(inst))
+    return phi->getIncomingValueForBlock(incomingBlock);
+  if (Value *clone = clones.lookup(inst))
+    return clone;
+
+  Instruction *clone = inst->clone();
+  for (Use &operand : clone->operands())
+    operand.set(rematerialize(operand.get(), loop, incomingBlock, clones));
+  b.Insert(clone, inst->getName());
+
+  // Fold the clone where the incoming phi values make it trivial, e.g. the offset of the first iteration.
+  Value *result = clone;
+  if (Value *simplified = simplifyInstruction(clone, SimplifyQuery(m_function.getParent()->getDataLayout(), clone))) {
+    clone->eraseFromParent();
+    result = simplified;
+  }
+  clones[inst] = result;
+  return result;
+}
+
+// =====================================================================================================================
+// Get the position for the load of the next iteration: the position of the original load if the address for the next
+// iteration is available there, otherwise the earliest position after that in the same block, otherwise the end of
+// the latch.
+//
+// @param load : The cooperative matrix load
+// @param loop : The loop
+// @param headerPhis : The loop header phis that the address of the load depends on
+// @returns : The instruction to insert the next load before
+Instruction *CooperativeMatrixLoadPipeliner::getPrefetchPos(CallInst *load, Loop *loop,
+                                                            ArrayRef<PHINode *> headerPhis) const {
+  BasicBlock *latch = loop->getLoopLatch();
+  Instruction *pos = load;
+  for (PHINode *phi : headerPhis) {
+    auto *next = dyn_cast<Instruction>(phi->getIncomingValueForBlock(latch));
+    if (!next || !loop->contains(next) || m_domTree.dominates(next, pos))
+      continue;
+    if (next->getParent() == pos->getParent() && !isa<PHINode>(next)) {
+      pos = next->getNextNode();
+      continue;
+    }
+    return latch->getTerminator();
+  }
+  return pos;
+}
+
+// =====================================================================================================================
+// Replace a cooperative matrix load in a loop by a phi of the load for the first iteration and the load for the next
+// iteration.
+//
+// @param load : The cooperative matrix load, for which isCandidate returned true
+// @param loop : The loop
+// @param headerPhis : The loop header phis that the address of the load depends on
+void CooperativeMatrixLoadPipeliner::pipelineLoad(CallInst *load, Loop *loop, ArrayRef<PHINode *> headerPhis) {
+  LLVM_DEBUG(dbgs() << "Pipelining cooperative matrix load " << *load << '\n');
+  BasicBlock *preheader = loop->getLoopPreheader();
+  BasicBlock *latch = loop->getLoopLatch();
+
+  auto createLoad = [&](BasicBlock *incomingBlock, Instruction *insertPos, const Twine &name) {
+    DenseMap<Value *, Value *> clones;
+    b.SetInsertPoint(insertPos);
+    auto *newLoad = cast<CallInst>(load->clone());
+    for (unsigned argIdx : {0, 1})
+      newLoad->setArgOperand(argIdx, rematerialize(load->getArgOperand(argIdx), loop, incomingBlock, clones));
+    b.Insert(newLoad, name);
+    return newLoad;
+  };
+  CallInst *firstLoad = createLoad(preheader, preheader->getTerminator(), load->getName() + ".first");
+  CallInst *nextLoad = createLoad(latch, getPrefetchPos(load, loop, headerPhis), load->getName() + ".next");
+
+  BasicBlock *header = loop->getHeader();
+  b.SetInsertPoint(header, header->begin());
+  PHINode *phi = b.CreatePHI(load->getType(), 2);
+  phi->addIncoming(firstLoad, preheader);
+  phi->addIncoming(nextLoad, latch);
+  phi->takeName(load);
+  load->replaceAllUsesWith(phi);
+
+  SmallVector<WeakTrackingVH, 2> addressOperands{load->getArgOperand(0), load->getArgOperand(1)};
+  load->eraseFromParent();
+  RecursivelyDeleteTriviallyDeadInstructionsPermissive(addressOperands);
+}
+
 // =====================================================================================================================
 // Run the pass on a function.
 //
@@ -937,7 +1172,15 @@ PreservedAnalyses CombineCooperativeMatrix::run(Function &function, FunctionAnal
       moduleAnalysisManager.getCachedResult<PipelineStateWrapper>(*function.getParent())->getPipelineState();
   CooperativeMatrixCombiner combiner{function, pipelineState->getTargetInfo().getGfxIpVersion()};
 
-  if (combiner.run()) {
+  bool changed = combiner.run();
+  if (PipelineLoads) {
+    // The combiner does not change the CFG, so loop and dominator info are still valid.
+    CooperativeMatrixLoadPipeliner pipeliner{function, analysisManager.getResult<LoopAnalysis>(function),
+                                             analysisManager.getResult<DominatorTreeAnalysis>(function)};
+    changed |= pipeliner.run();
+  }
+
+  if (changed) {
     PreservedAnalyses PA;
     PA.preserveSet<CFGAnalyses>();
     return PA;
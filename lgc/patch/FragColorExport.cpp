@@ -32,6 +32,7 @@
 #include "lgc/LgcContext.h"
 #include "lgc/patch/Patch.h"
 #include "lgc/patch/ShaderInputs.h"
+#include "lgc/state/CallSiteIndex.h"
 #include "lgc/state/IntrinsDefs.h"
 #include "lgc/state/PalMetadata.h"
 #include "lgc/state/PipelineShaders.h"
@@ -422,6 +423,7 @@ Value *FragColorExport::convertToInt(Value *value, bool signedness, BuilderBase
 PreservedAnalyses LowerFragColorExport::run(Module &module, ModuleAnalysisManager &analysisManager) {
   PipelineState *pipelineState = analysisManager.getResult<PipelineStateWrapper>(module).getPipelineState();
   PipelineShadersResult &pipelineShaders = analysisManager.getResult<PipelineShaders>(module);
+  CallSiteIndexResult &callSiteIndex = analysisManager.getResult<CallSiteIndex>(module);
 
   m_context = &module.getContext();
   m_pipelineState = pipelineState;
@@ -447,8 +449,8 @@ PreservedAnalyses LowerFragColorExport::run(Module &module, ModuleAnalysisManage
   BuilderBase builder(module.getContext());
   builder.SetInsertPoint(retInst);
 
-  collectExportInfoForBuiltinOutput(fragEntryPoint, builder);
-  collectExportInfoForGenericOutputs(fragEntryPoint, builder);
+  collectExportInfoForBuiltinOutput(fragEntryPoint, callSiteIndex, builder);
+  collectExportInfoForGenericOutputs(fragEntryPoint, callSiteIndex, builder);
 
   // Now do color exports by color buffer.
   // Read the dynamicDualSourceBlend value from user data and jump to different branch basing on the value
@@ -458,8 +460,11 @@ PreservedAnalyses LowerFragColorExport::run(Module &module, ModuleAnalysisManage
   // 2. For static pipeline which will not use the usedata and identify whether do dualSourceBlend
   // Just according to the dualSourceBlendEnable flag.
   Value *dynamicIsDualSource = builder.getInt32(0);
+  // Creating or erasing an lgc.* call invalidates CallSiteIndex, so track whether we did either.
+  bool changed = !m_info.empty();
   if (m_pipelineState->getTargetInfo().getGfxIpVersion().major >= 11) {
     dynamicIsDualSource = ShaderInputs::getSpecialUserData(UserDataMapping::DynamicDualSrcBlendInfo, builder);
+    changed = true;
   }
 
   bool willGenerateColorExportShader = m_pipelineState->isUnlinked() && !m_pipelineState->hasColorExportFormats();
@@ -473,7 +478,7 @@ PreservedAnalyses LowerFragColorExport::run(Module &module, ModuleAnalysisManage
   FragColorExport::Key key = FragColorExport::computeKey(m_info, m_pipelineState);
   fragColorExport.generateExportInstructions(m_info, m_exportValues, dummyExport, m_pipelineState->getPalMetadata(),
                                              builder, dynamicIsDualSource, key);
-  return (!m_info.empty() || dummyExport) ? PreservedAnalyses::none() : PreservedAnalyses::all();
+  return (changed || dummyExport) ? PreservedAnalyses::none() : PreservedAnalyses::all();
 }
 
 // =====================================================================================================================
@@ -515,20 +520,20 @@ void LowerFragColorExport::updateFragColors(CallInst *callInst, MutableArrayRef<
 // shader fragEntryPoint.  This information is stored in m_info and m_exportValues.
 //
 // @param fragEntryPoint : The fragment shader to which we should add the export instructions.
+// @param callSiteIndex : Index of lgc.* call sites in the module
 // @param builder : The builder object that will be used to create new instructions.
-void LowerFragColorExport::collectExportInfoForGenericOutputs(Function *fragEntryPoint, BuilderBase &builder) {
+void LowerFragColorExport::collectExportInfoForGenericOutputs(Function *fragEntryPoint,
+                                                              const CallSiteIndexResult &callSiteIndex,
+                                                              BuilderBase &builder) {
   std::unique_ptr<FragColorExport> fragColorExport(new FragColorExport(m_pipelineState->getLgcContext()));
   SmallVector<CallInst *, 8> colorExports;
 
   // Collect all of the exports in the fragment shader
-  for (auto &func : *fragEntryPoint->getParent()) {
-    if (!func.isDeclaration() || !func.getName().starts_with(lgcName::OutputExportGeneric))
-      continue;
-    for (auto user : func.users()) {
-      auto callInst = cast<CallInst>(user);
-      if (callInst->getFunction() == fragEntryPoint)
-        colorExports.push_back(callInst);
-    }
+  SmallVector<CallInst *, 8> fragmentExports;
+  callSiteIndex.getCalls(lgcName::OutputExportGeneric, ShaderStage::Fragment, fragmentExports);
+  for (CallInst *callInst : fragmentExports) {
+    if (callInst->getFunction() == fragEntryPoint)
+      colorExports.push_back(callInst);
   }
 
   if (colorExports.empty())
@@ -647,46 +652,45 @@ void LowerFragColorExport::createTailJump(Function *fragEntryPoint, BuilderBase
 // and sample mask.  This information is added to m_info and m_exportValues.
 //
 // @param fragEntryPoint : The fragment shader to which we should add the export instructions.
+// @param callSiteIndex : Index of lgc.* call sites in the module
 // @param builder : The builder object that will be used to create new instructions.
-void LowerFragColorExport::collectExportInfoForBuiltinOutput(Function *module, BuilderBase &builder) {
+void LowerFragColorExport::collectExportInfoForBuiltinOutput(Function *module, const CallSiteIndexResult &callSiteIndex,
+                                                             BuilderBase &builder) {
   // Collect calls to the builtins
   Value *m_fragDepth = nullptr;
   Value *m_fragStencilRef = nullptr;
   Value *m_sampleMask = nullptr;
-  for (auto &func : *module->getParent()) {
-    if (!func.isDeclaration() || !func.getName().starts_with(lgcName::OutputExportBuiltIn))
+  SmallVector<CallInst *, 4> builtInExports;
+  callSiteIndex.getCalls(lgcName::OutputExportBuiltIn, ShaderStage::Fragment, builtInExports);
+  for (CallInst *callInst : builtInExports) {
+    if (callInst->getFunction() != module)
       continue;
-    for (auto user : func.users()) {
-      auto callInst = cast<CallInst>(user);
-      if (callInst->getFunction() != module)
-        continue;
 
-      Value *output = callInst->getOperand(callInst->arg_size() - 1); // Last argument
-      unsigned builtInId = cast<ConstantInt>(callInst->getOperand(0))->getZExtValue();
-      switch (builtInId) {
-      case BuiltInFragDepth: {
-        m_fragDepth = output;
-        break;
+    Value *output = callInst->getOperand(callInst->arg_size() - 1); // Last argument
+    unsigned builtInId = cast<ConstantInt>(callInst->getOperand(0))->getZExtValue();
+    switch (builtInId) {
+    case BuiltInFragDepth: {
+      m_fragDepth = output;
+      break;
+    }
+    case BuiltInSampleMask: {
+      assert(output->getType()->isArrayTy());
+      if (!m_pipelineState->getOptions().disableSampleMask) {
+        // NOTE: Only gl_SampleMask[0] is valid for us.
+        m_sampleMask = builder.CreateExtractValue(output, {0});
+        m_sampleMask = builder.CreateBitCast(m_sampleMask, builder.getFloatTy());
       }
-      case BuiltInSampleMask: {
-        assert(output->getType()->isArrayTy());
-        if (!m_pipelineState->getOptions().disableSampleMask) {
-          // NOTE: Only gl_SampleMask[0] is valid for us.
-          m_sampleMask = builder.CreateExtractValue(output, {0});
-          m_sampleMask = builder.CreateBitCast(m_sampleMask, builder.getFloatTy());
-        }
 
-        break;
-      }
-      case BuiltInFragStencilRef: {
-        m_fragStencilRef = builder.CreateBitCast(output, builder.getFloatTy());
-        break;
-      }
-      default: {
-        llvm_unreachable("Unexpected builtin output in fragment shader.");
-        break;
-      }
-      }
+      break;
+    }
+    case BuiltInFragStencilRef: {
+      m_fragStencilRef = builder.CreateBitCast(output, builder.getFloatTy());
+      break;
+    }
+    default: {
+      llvm_unreachable("Unexpected builtin output in fragment shader.");
+      break;
+    }
     }
   }
 
@@ -58,6 +58,12 @@
 using namespace llvm;
 using namespace lgc;
 
+// -subgroup-helper-inline-threshold: instruction count above which a shared subgroup helper is kept as a call
+static cl::opt<unsigned> SubgroupHelperInlineThreshold(
+    "subgroup-helper-inline-threshold",
+    cl::desc("Keep shared subgroup helper functions with more instructions than this and several callers as calls"),
+    cl::init(UINT_MAX));
+
 namespace lgc {
 
 class SubgroupLoweringBuilder : public BuilderImpl {
@@ -127,9 +133,29 @@ PreservedAnalyses LowerSubgroupOps::run(Module &module, ModuleAnalysisManager &a
   visitor.visit(*this, module);
   m_builder = nullptr;
 
+  decideSubgroupHelperInlining(module);
+
   return PreservedAnalyses::none();
 }
 
+// =====================================================================================================================
+// Decide whether each shared subgroup helper function created by the builder is inlined late or kept as a call. Helpers
+// are created always-inline; a helper is kept as a call only if its body exceeds the size threshold and it has more
+// than one caller, since inlining it then multiplies the code size.
+//
+// @param [in/out] module : LLVM module
+void LowerSubgroupOps::decideSubgroupHelperInlining(Module &module) {
+  for (Function &func : module) {
+    if (func.isDeclaration() || !func.getName().starts_with(lgcName::SubgroupHelperPrefix))
+      continue;
+    if (func.hasOneUse() || func.getInstructionCount() <= SubgroupHelperInlineThreshold)
+      continue;
+    LLVM_DEBUG(dbgs() << "Keep subgroup helper " << func.getName() << " as a call\n");
+    func.removeFnAttr(Attribute::AlwaysInline);
+    func.addFnAttr(Attribute::NoInline);
+  }
+}
+
 void LowerSubgroupOps::replace(CallInst &old, Value *op) {
   old.replaceAllUsesWith(op);
   old.dropAllReferences();
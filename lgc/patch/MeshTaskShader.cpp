@@ -170,7 +170,8 @@ unsigned MeshTaskShader::layoutMeshShaderLds(PipelineState *pipelineState, Funct
   meshLdsSizeInDwords += ldsRegionSize;
 
   // Per-vertex outputs
-  const unsigned vertexStride = 4 * resUsage->inOutUsage.outputMapLocCount; // Corresponds to vec4 output
+  const unsigned vertexStride =
+      resUsage->inOutUsage.mesh.getOutputLdsOffset(false, resUsage->inOutUsage.outputMapLocCount);
   ldsRegionSize = vertexStride * meshMode.outputVertices;
   if (ldsLayout) {
     printLdsRegionInfo("Per-vertex Output", ldsOffsetInDwords, ldsRegionSize);
@@ -180,7 +181,8 @@ unsigned MeshTaskShader::layoutMeshShaderLds(PipelineState *pipelineState, Funct
   meshLdsSizeInDwords += ldsRegionSize;
 
   // Per-primitive outputs
-  const unsigned primitiveStride = 4 * resUsage->inOutUsage.perPrimitiveOutputMapLocCount; // Corresponds to vec4 output
+  const unsigned primitiveStride =
+      resUsage->inOutUsage.mesh.getOutputLdsOffset(true, resUsage->inOutUsage.perPrimitiveOutputMapLocCount);
   ldsRegionSize = primitiveStride * meshMode.outputPrimitives;
   if (ldsLayout) {
     printLdsRegionInfo("Per-primitive Output", ldsOffsetInDwords, ldsRegionSize);
@@ -236,6 +238,10 @@ unsigned MeshTaskShader::layoutMeshShaderLds(PipelineState *pipelineState, Funct
     printLdsRegionInfo("Shared Variable LDS", 0, sharedVarLdsSizeInDwords);
     printLdsRegionInfo("Total LDS", 0, meshLdsSizeInDwords + sharedVarLdsSizeInDwords);
     LLPC_OUTS("\n");
+    LLPC_OUTS("Vertex Output Stride = " << vertexStride << " (Fixed Layout = "
+                                        << 4 * resUsage->inOutUsage.outputMapLocCount << ")\n");
+    LLPC_OUTS("Primitive Output Stride = " << primitiveStride << " (Fixed Layout = "
+                                           << 4 * resUsage->inOutUsage.perPrimitiveOutputMapLocCount << ")\n");
     LLPC_OUTS("Workgroup Size (X, Y, Z) = (" << meshMode.workgroupSizeX << ", " << meshMode.workgroupSizeY << ", "
                                              << meshMode.workgroupSizeZ << ")\n");
     LLPC_OUTS("NumMeshThreads = " << meshMode.workgroupSizeX * meshMode.workgroupSizeY * meshMode.workgroupSizeZ
@@ -1355,7 +1361,8 @@ void MeshTaskShader::lowerWriteMeshVertexOutput(WriteMeshVertexOutputOp &writeMe
   auto outputValue = writeMeshVertexOutputOp.getOutputValue();
 
   const auto resUsage = m_pipelineState->getShaderResourceUsage(ShaderStage::Mesh);
-  const unsigned vertexStride = 4 * resUsage->inOutUsage.outputMapLocCount; // Corresponds to vec4 output
+  const unsigned vertexStride =
+      resUsage->inOutUsage.mesh.getOutputLdsOffset(false, resUsage->inOutUsage.outputMapLocCount);
 
   Value *ldsStart = m_builder.getInt32(getMeshShaderLdsRegionStart(MeshLdsRegion::VertexOutput));
   Value *ldsOffset = m_builder.CreateMul(vertexIndex, m_builder.getInt32(vertexStride));
@@ -1381,7 +1388,8 @@ void MeshTaskShader::lowerWriteMeshPrimitiveOutput(WriteMeshPrimitiveOutputOp &w
   auto outputValue = writeMeshPrimitiveOutputOp.getOutputValue();
 
   const auto resUsage = m_pipelineState->getShaderResourceUsage(ShaderStage::Mesh);
-  const unsigned primitiveStride = 4 * resUsage->inOutUsage.perPrimitiveOutputMapLocCount; // Corresponds to vec4 output
+  const unsigned primitiveStride =
+      resUsage->inOutUsage.mesh.getOutputLdsOffset(true, resUsage->inOutUsage.perPrimitiveOutputMapLocCount);
 
   Value *ldsStart = m_builder.getInt32(getMeshShaderLdsRegionStart(MeshLdsRegion::PrimitiveOutput));
   Value *ldsOffset = m_builder.CreateMul(primitiveIndex, m_builder.getInt32(primitiveStride));
@@ -1843,19 +1851,12 @@ void MeshTaskShader::exportPrimitive() {
 
   // Export primitive attributes (from generic outputs)
   ldsStart = m_builder.getInt32(getMeshShaderLdsRegionStart(MeshLdsRegion::PrimitiveOutput));
-  auto primitiveStride = 4 * inOutUsage.perPrimitiveOutputMapLocCount;
+  auto primitiveStride = inOutUsage.mesh.getOutputLdsOffset(true, inOutUsage.perPrimitiveOutputMapLocCount);
   auto ldsOffsetBase = m_builder.CreateMul(m_waveThreadInfo.primOrVertexIndex, m_builder.getInt32(primitiveStride));
   ldsOffsetBase = m_builder.CreateAdd(ldsStart, ldsOffsetBase);
 
   for (unsigned loc = 0; loc < inOutUsage.mesh.perPrimitiveGenericOutputMapLocCount; ++loc) {
-    auto ldsOffset = m_builder.CreateAdd(ldsOffsetBase, m_builder.getInt32(4 * loc));
-    auto exportValue = readValueFromLds(FixedVectorType::get(m_builder.getFloatTy(), 4), ldsOffset);
-
-    std::array<Value *, 4> exportValues;
-    for (unsigned j = 0; j < 4; ++j)
-      exportValues[j] = m_builder.CreateExtractElement(exportValue, j);
-
-    primAttrExports.push_back({startLoc + loc, exportValues});
+    primAttrExports.push_back({startLoc + loc, readGenericOutputFromLds(ldsOffsetBase, loc, true)});
     ++inOutUsage.primExpCount;
   }
 
@@ -2002,20 +2003,12 @@ void MeshTaskShader::exportVertex() {
 
   // Export vertex attributes (from generic outputs)
   Value *ldsStart = m_builder.getInt32(getMeshShaderLdsRegionStart(MeshLdsRegion::VertexOutput));
-  auto vertexStride = 4 * inOutUsage.outputMapLocCount;
+  auto vertexStride = inOutUsage.mesh.getOutputLdsOffset(false, inOutUsage.outputMapLocCount);
   auto ldsOffsetBase = m_builder.CreateMul(m_waveThreadInfo.primOrVertexIndex, m_builder.getInt32(vertexStride));
   ldsOffsetBase = m_builder.CreateAdd(ldsStart, ldsOffsetBase);
 
   for (unsigned i = 0; i < inOutUsage.mesh.genericOutputMapLocCount; ++i) {
-    auto ldsOffset = m_builder.CreateAdd(ldsOffsetBase, m_builder.getInt32(4 * i));
-    auto exportValue = readValueFromLds(FixedVectorType::get(m_builder.getFloatTy(), 4), ldsOffset);
-
-    std::array<Value *, 4> exportValues = {m_builder.CreateExtractElement(exportValue, static_cast<uint64_t>(0)),
-                                           m_builder.CreateExtractElement(exportValue, 1),
-                                           m_builder.CreateExtractElement(exportValue, 2),
-                                           m_builder.CreateExtractElement(exportValue, 3)};
-
-    vertAttrExports.push_back({i, exportValues});
+    vertAttrExports.push_back({i, readGenericOutputFromLds(ldsOffsetBase, i, false)});
     ++inOutUsage.expCount;
   }
 
@@ -2570,14 +2563,15 @@ Value *MeshTaskShader::readMeshBuiltInFromLds(BuiltInKind builtIn) {
 
   Value *ldsOffset = nullptr;
   if (region == MeshLdsRegion::VertexOutput) {
-    auto vertexStride = 4 * inOutUsage.outputMapLocCount;
+    auto vertexStride = inOutUsage.mesh.getOutputLdsOffset(false, inOutUsage.outputMapLocCount);
     ldsOffset = m_builder.CreateMul(m_waveThreadInfo.primOrVertexIndex, m_builder.getInt32(vertexStride));
   } else {
     assert(region == MeshLdsRegion::PrimitiveOutput);
-    auto primitiveStride = 4 * inOutUsage.perPrimitiveOutputMapLocCount;
+    auto primitiveStride = inOutUsage.mesh.getOutputLdsOffset(true, inOutUsage.perPrimitiveOutputMapLocCount);
     ldsOffset = m_builder.CreateMul(m_waveThreadInfo.primOrVertexIndex, m_builder.getInt32(primitiveStride));
   }
-  ldsOffset = m_builder.CreateAdd(ldsOffset, m_builder.getInt32(4 * location));
+  const unsigned locationOffset = inOutUsage.mesh.getOutputLdsOffset(isPerPrimitive, location);
+  ldsOffset = m_builder.CreateAdd(ldsOffset, m_builder.getInt32(locationOffset));
 
   Value *ldsStart = m_builder.getInt32(getMeshShaderLdsRegionStart(region));
   ldsOffset = m_builder.CreateAdd(ldsStart, ldsOffset);
@@ -2585,6 +2579,38 @@ Value *MeshTaskShader::readMeshBuiltInFromLds(BuiltInKind builtIn) {
   return readValueFromLds(readTy, ldsOffset);
 }
 
+// =====================================================================================================================
+// Read a generic output of mesh shader from LDS for attribute export. Only the dwords that are reserved for the
+// location are read; the remaining components are poison.
+//
+// @param ldsOffsetBase : LDS offset of the outputs of current vertex or primitive (in dwords)
+// @param location : Mapped location of the output
+// @param isPerPrimitive : Whether the output is per-primitive
+// @returns : The four components to export
+std::array<Value *, 4> MeshTaskShader::readGenericOutputFromLds(Value *ldsOffsetBase, unsigned location,
+                                                                bool isPerPrimitive) {
+  const auto &inOutUsage = m_pipelineState->getShaderResourceUsage(ShaderStage::Mesh)->inOutUsage;
+  const unsigned locationOffset = inOutUsage.mesh.getOutputLdsOffset(isPerPrimitive, location);
+  const unsigned dwordCount =
+      std::min(inOutUsage.mesh.getOutputLdsOffset(isPerPrimitive, location + 1) - locationOffset, 4U);
+
+  auto poison = PoisonValue::get(m_builder.getFloatTy());
+  std::array<Value *, 4> exportValues = {poison, poison, poison, poison};
+  if (dwordCount == 0)
+    return exportValues;
+
+  auto ldsOffset = m_builder.CreateAdd(ldsOffsetBase, m_builder.getInt32(locationOffset));
+  if (dwordCount == 1) {
+    exportValues[0] = readValueFromLds(m_builder.getFloatTy(), ldsOffset);
+    return exportValues;
+  }
+
+  auto exportValue = readValueFromLds(FixedVectorType::get(m_builder.getFloatTy(), dwordCount), ldsOffset);
+  for (unsigned i = 0; i < dwordCount; ++i)
+    exportValues[i] = m_builder.CreateExtractElement(exportValue, i);
+  return exportValues;
+}
+
 // =====================================================================================================================
 // Change primitive shading rate from API to HW-specific shading rate.
 //
@@ -129,6 +129,8 @@ private:
   llvm::Value *getMeshGlobalInvocationId();
 
   llvm::Value *readMeshBuiltInFromLds(BuiltInKind builtIn);
+  std::array<llvm::Value *, 4> readGenericOutputFromLds(llvm::Value *ldsOffsetBase, unsigned location,
+                                                        bool isPerPrimitive);
   llvm::Value *convertToHwShadingRate(llvm::Value *primitiveShadingRate);
 
   bool checkNeedBarrierFlag(llvm::Function *entryPoint);
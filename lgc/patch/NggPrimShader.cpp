@@ -34,13 +34,17 @@
 #include "lgc/patch/Patch.h"
 #include "lgc/state/PalMetadata.h"
 #include "lgc/util/Debug.h"
+#include "llvm-dialects/Dialect/ContextExtension.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
 
 #define DEBUG_TYPE "lgc-ngg-prim-shader"
 
@@ -75,6 +79,22 @@ static const char NggCullerRegFetcher[] = "lgc.ngg.culler.reg.fetcher";
 
 static const char NggXfbFetcher[] = "lgc.ngg.xfb.fetcher";
 
+// =====================================================================================================================
+// LLVMContext extension that holds the NGG culler library: a module with one finished definition of each culler
+// variant. A variant is keyed on the GFX IP version and the NGG culling options (see NggPrimShader::getCuller). It is
+// built and folded once per context, and every later pipeline module that uses it gets a clone of that finished body
+// without any rebuilding or pass run.
+class NggCullerLibrary : public llvm_dialects::ContextExtensionImpl<NggCullerLibrary> {
+public:
+  explicit NggCullerLibrary(LLVMContext &) {}
+
+  static Key theKey;
+
+  std::unique_ptr<Module> theModule;
+};
+
+NggCullerLibrary::Key NggCullerLibrary::theKey;
+
 // Represents GDS GRBM register for SW-emulated stream-out
 enum {
   // For 4 stream-out buffers
@@ -4357,7 +4377,7 @@ Value *NggPrimShader::runBackfaceCuller(Value *primitiveAlreadyCulled, Value *ve
   assert(m_nggControl->enableBackfaceCulling);
 
   if (!m_cullers.backface)
-    m_cullers.backface = createBackfaceCuller();
+    m_cullers.backface = getCuller(NggCullerBackface, &NggPrimShader::createBackfaceCuller);
 
   // Get register PA_SU_SC_MODE_CNTL
   Value *paSuScModeCntl = fetchCullingControlRegister(m_cbLayoutTable.paSuScModeCntl);
@@ -4385,7 +4405,7 @@ Value *NggPrimShader::runFrustumCuller(Value *primitiveAlreadyCulled, Value *ver
   assert(m_nggControl->enableFrustumCulling);
 
   if (!m_cullers.frustum)
-    m_cullers.frustum = createFrustumCuller();
+    m_cullers.frustum = getCuller(NggCullerFrustum, &NggPrimShader::createFrustumCuller);
 
   // Get register PA_CL_CLIP_CNTL
   Value *paClClipCntl = fetchCullingControlRegister(m_cbLayoutTable.paClClipCntl);
@@ -4413,7 +4433,7 @@ Value *NggPrimShader::runBoxFilterCuller(Value *primitiveAlreadyCulled, Value *v
   assert(m_nggControl->enableBoxFilterCulling);
 
   if (!m_cullers.boxFilter)
-    m_cullers.boxFilter = createBoxFilterCuller();
+    m_cullers.boxFilter = getCuller(NggCullerBoxFilter, &NggPrimShader::createBoxFilterCuller);
 
   // Get register PA_CL_VTE_CNTL
   Value *paClVteCntl = fetchCullingControlRegister(m_cbLayoutTable.paClVteCntl);
@@ -4443,7 +4463,7 @@ Value *NggPrimShader::runSphereCuller(Value *primitiveAlreadyCulled, Value *vert
   assert(m_nggControl->enableSphereCulling);
 
   if (!m_cullers.sphere)
-    m_cullers.sphere = createSphereCuller();
+    m_cullers.sphere = getCuller(NggCullerSphere, &NggPrimShader::createSphereCuller);
 
   // Get register PA_CL_VTE_CNTL
   Value *paClVteCntl = fetchCullingControlRegister(m_cbLayoutTable.paClVteCntl);
@@ -4474,7 +4494,7 @@ Value *NggPrimShader::runSmallPrimFilterCuller(Value *primitiveAlreadyCulled, Va
   assert(m_nggControl->enableSmallPrimFilter);
 
   if (!m_cullers.smallPrimFilter)
-    m_cullers.smallPrimFilter = createSmallPrimFilterCuller();
+    m_cullers.smallPrimFilter = getCuller(NggCullerSmallPrimFilter, &NggPrimShader::createSmallPrimFilterCuller);
 
   // Get register PA_CL_VTE_CNTL
   Value *paClVteCntl = fetchCullingControlRegister(m_cbLayoutTable.paClVteCntl);
@@ -4513,7 +4533,7 @@ Value *NggPrimShader::runCullDistanceCuller(Value *primitiveAlreadyCulled, Value
   assert(m_nggControl->enableCullDistanceCulling);
 
   if (!m_cullers.cullDistance)
-    m_cullers.cullDistance = createCullDistanceCuller();
+    m_cullers.cullDistance = getCuller(NggCullerCullDistance, &NggPrimShader::createCullDistanceCuller);
 
   // Run cull distance culler
   return m_builder.CreateCall(m_cullers.cullDistance, {primitiveAlreadyCulled, signMask0, signMask1, signMask2});
@@ -4532,9 +4552,103 @@ Value *NggPrimShader::fetchCullingControlRegister(unsigned regOffset) {
       {m_nggInputs.primShaderTableAddr.first, m_nggInputs.primShaderTableAddr.second, m_builder.getInt32(regOffset)});
 }
 
+// =====================================================================================================================
+// Gets the specified culler in the current module. The culler is cloned from the culler library of this context,
+// building and folding it there first if this is the first use of this culler variant. A variant is keyed on the
+// GFX IP version, as the culler is built for the target of the pipeline, and on all NGG culling options, since the
+// culler code may test them (the small primitive filter depends on frustum culling).
+//
+// @param name : Name of the culler function
+// @param createCuller : Member function that creates the culler in a given module
+// @returns : The culler function in the current module
+Function *NggPrimShader::getCuller(StringRef name, CullerCreator createCuller) {
+  Module *module = m_builder.GetInsertBlock()->getModule();
+
+  // Create (or re-create if the target has changed) the library module
+  auto &library = NggCullerLibrary::get(module->getContext());
+  if (!library.theModule || library.theModule->getTargetTriple() != module->getTargetTriple() ||
+      library.theModule->getDataLayout() != module->getDataLayout()) {
+    library.theModule = std::make_unique<Module>("lgc.ngg.culler.library", module->getContext());
+    library.theModule->setTargetTriple(module->getTargetTriple());
+    library.theModule->setDataLayout(module->getDataLayout());
+  }
+  Module *libModule = library.theModule.get();
+
+  const unsigned cullingOptions =
+      m_nggControl->enableBackfaceCulling | m_nggControl->enableFrustumCulling << 1 |
+      m_nggControl->enableBoxFilterCulling << 2 | m_nggControl->enableSphereCulling << 3 |
+      m_nggControl->enableSmallPrimFilter << 4 | m_nggControl->enableCullDistanceCulling << 5;
+  std::string libName;
+  raw_string_ostream(libName) << name << ".gfx" << m_gfxIp.major << "." << m_gfxIp.minor << "." << m_gfxIp.stepping
+                              << ".cull" << cullingOptions;
+  Function *libCuller = libModule->getFunction(libName);
+  if (!libCuller) {
+    libCuller = (this->*createCuller)(libModule);
+    libCuller->setName(libName);
+    simplifyCuller(*libCuller);
+  }
+
+  // Clone the culler into the current module. Declarations it calls (intrinsics) are mapped to the current module.
+  Function *culler = Function::Create(libCuller->getFunctionType(), GlobalValue::InternalLinkage, name, module);
+  ValueToValueMapTy valueMap;
+  for (auto [libArg, arg] : zip(libCuller->args(), culler->args())) {
+    arg.setName(libArg.getName());
+    valueMap[&libArg] = &arg;
+  }
+
+  for (Instruction &inst : instructions(libCuller)) {
+    auto call = dyn_cast<CallInst>(&inst);
+    Function *callee = call ? call->getCalledFunction() : nullptr;
+    if (!callee || valueMap.count(callee))
+      continue;
+    assert(callee->isDeclaration());
+    Function *targetCallee = module->getFunction(callee->getName());
+    if (!targetCallee) {
+      targetCallee = Function::Create(callee->getFunctionType(), callee->getLinkage(), callee->getName(), module);
+      targetCallee->copyAttributesFrom(callee);
+    }
+    valueMap[callee] = targetCallee;
+  }
+
+  SmallVector<ReturnInst *, 4> returns;
+  CloneFunctionInto(culler, libCuller, valueMap, CloneFunctionChangeType::DifferentModule, returns);
+
+  return culler;
+}
+
+// =====================================================================================================================
+// Folds a newly built culler in the culler library, so that each pipeline that clones it starts from the folded form.
+// This uses local simplification utilities rather than a pass pipeline, so no analysis managers are set up.
+//
+// @param culler : Culler function to fold
+void NggPrimShader::simplifyCuller(Function &culler) {
+  const DataLayout &dataLayout = culler.getParent()->getDataLayout();
+  for (BasicBlock &block : culler) {
+    for (Instruction &inst : make_early_inc_range(block)) {
+      Value *simplified = simplifyInstruction(&inst, SimplifyQuery(dataLayout, &inst));
+      if (simplified && simplified != &inst) {
+        inst.replaceAllUsesWith(simplified);
+        if (isInstructionTriviallyDead(&inst))
+          inst.eraseFromParent();
+      }
+    }
+    ConstantFoldTerminator(&block, /*DeleteDeadConditions=*/true);
+  }
+  removeUnreachableBlocks(culler);
+
+  for (BasicBlock &block : culler) {
+    for (Instruction &inst : make_early_inc_range(reverse(block))) {
+      if (isInstructionTriviallyDead(&inst))
+        inst.eraseFromParent();
+    }
+  }
+}
+
 // =====================================================================================================================
 // Creates the function that does backface culling.
-Function *NggPrimShader::createBackfaceCuller() {
+//
+// @param module : Module in which to create the function
+Function *NggPrimShader::createBackfaceCuller(Module *module) {
   auto funcTy = FunctionType::get(m_builder.getInt1Ty(),
                                   {
                                       m_builder.getInt1Ty(),                           // %primitiveAlreadyCulled
@@ -4547,8 +4661,7 @@ Function *NggPrimShader::createBackfaceCuller() {
                                       m_builder.getInt32Ty()                           // %paClVportYscale
                                   },
                                   false);
-  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerBackface,
-                               m_builder.GetInsertBlock()->getModule());
+  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerBackface, module);
 
   func->setCallingConv(CallingConv::C);
   func->setDoesNotAccessMemory();
@@ -4755,7 +4868,9 @@ Function *NggPrimShader::createBackfaceCuller() {
 
 // =====================================================================================================================
 // Creates the function that does frustum culling.
-Function *NggPrimShader::createFrustumCuller() {
+//
+// @param module : Module in which to create the function
+Function *NggPrimShader::createFrustumCuller(Module *module) {
   auto funcTy = FunctionType::get(m_builder.getInt1Ty(),
                                   {
                                       m_builder.getInt1Ty(),                           // %primitiveAlreadyCulled
@@ -4767,8 +4882,7 @@ Function *NggPrimShader::createFrustumCuller() {
                                       m_builder.getInt32Ty()                           // %paClGbVertDiscAdj
                                   },
                                   false);
-  auto func =
-      Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerFrustum, m_builder.GetInsertBlock()->getModule());
+  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerFrustum, module);
 
   func->setCallingConv(CallingConv::C);
   func->setDoesNotAccessMemory();
@@ -5007,7 +5121,9 @@ Function *NggPrimShader::createFrustumCuller() {
 
 // =====================================================================================================================
 // Creates the function that does box filter culling.
-Function *NggPrimShader::createBoxFilterCuller() {
+//
+// @param module : Module in which to create the function
+Function *NggPrimShader::createBoxFilterCuller(Module *module) {
   auto funcTy = FunctionType::get(m_builder.getInt1Ty(),
                                   {
                                       m_builder.getInt1Ty(),                           // %primitiveAlreadyCulled
@@ -5020,8 +5136,7 @@ Function *NggPrimShader::createBoxFilterCuller() {
                                       m_builder.getInt32Ty()                           // %paClGbVertDiscAdj
                                   },
                                   false);
-  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerBoxFilter,
-                               m_builder.GetInsertBlock()->getModule());
+  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerBoxFilter, module);
 
   func->setCallingConv(CallingConv::C);
   func->setDoesNotAccessMemory();
@@ -5227,7 +5342,9 @@ Function *NggPrimShader::createBoxFilterCuller() {
 
 // =====================================================================================================================
 // Creates the function that does sphere culling.
-Function *NggPrimShader::createSphereCuller() {
+//
+// @param module : Module in which to create the function
+Function *NggPrimShader::createSphereCuller(Module *module) {
   auto funcTy = FunctionType::get(m_builder.getInt1Ty(),
                                   {
                                       m_builder.getInt1Ty(),                           // %primitiveAlreadyCulled
@@ -5240,8 +5357,7 @@ Function *NggPrimShader::createSphereCuller() {
                                       m_builder.getInt32Ty()                           // %paClGbVertDiscAdj
                                   },
                                   false);
-  auto func =
-      Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerSphere, m_builder.GetInsertBlock()->getModule());
+  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerSphere, module);
 
   func->setCallingConv(CallingConv::C);
   func->setDoesNotAccessMemory();
@@ -5585,7 +5701,9 @@ Function *NggPrimShader::createSphereCuller() {
 
 // =====================================================================================================================
 // Creates the function that does small primitive filter culling.
-Function *NggPrimShader::createSmallPrimFilterCuller() {
+//
+// @param module : Module in which to create the function
+Function *NggPrimShader::createSmallPrimFilterCuller(Module *module) {
   auto funcTy = FunctionType::get(m_builder.getInt1Ty(),
                                   {
                                       m_builder.getInt1Ty(),                           // %primitiveAlreadyCulled
@@ -5600,8 +5718,7 @@ Function *NggPrimShader::createSmallPrimFilterCuller() {
                                       m_builder.getInt1Ty()                            // %conservativeRaster
                                   },
                                   false);
-  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerSmallPrimFilter,
-                               m_builder.GetInsertBlock()->getModule());
+  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerSmallPrimFilter, module);
 
   func->setCallingConv(CallingConv::C);
   func->setDoesNotAccessMemory();
@@ -5872,7 +5989,9 @@ Function *NggPrimShader::createSmallPrimFilterCuller() {
 
 // =====================================================================================================================
 // Creates the function that does frustum culling.
-Function *NggPrimShader::createCullDistanceCuller() {
+//
+// @param module : Module in which to create the function
+Function *NggPrimShader::createCullDistanceCuller(Module *module) {
   auto funcTy = FunctionType::get(m_builder.getInt1Ty(),
                                   {
                                       m_builder.getInt1Ty(),  // %primitiveAlreadyCulled
@@ -5881,8 +6000,7 @@ Function *NggPrimShader::createCullDistanceCuller() {
                                       m_builder.getInt32Ty()  // %signMask2
                                   },
                                   false);
-  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerCullDistance,
-                               m_builder.GetInsertBlock()->getModule());
+  auto func = Function::Create(funcTy, GlobalValue::InternalLinkage, NggCullerCullDistance, module);
 
   func->setCallingConv(CallingConv::C);
   func->setDoesNotAccessMemory();
@@ -279,12 +279,16 @@ private:
                                      llvm::Value *signMask1, llvm::Value *signMask2);
   llvm::Value *fetchCullingControlRegister(unsigned regOffset);
 
-  llvm::Function *createBackfaceCuller();
-  llvm::Function *createFrustumCuller();
-  llvm::Function *createBoxFilterCuller();
-  llvm::Function *createSphereCuller();
-  llvm::Function *createSmallPrimFilterCuller();
-  llvm::Function *createCullDistanceCuller();
+  typedef llvm::Function *(NggPrimShader::*CullerCreator)(llvm::Module *);
+  llvm::Function *getCuller(llvm::StringRef name, CullerCreator createCuller);
+  void simplifyCuller(llvm::Function &culler);
+
+  llvm::Function *createBackfaceCuller(llvm::Module *module);
+  llvm::Function *createFrustumCuller(llvm::Module *module);
+  llvm::Function *createBoxFilterCuller(llvm::Module *module);
+  llvm::Function *createSphereCuller(llvm::Module *module);
+  llvm::Function *createSmallPrimFilterCuller(llvm::Module *module);
+  llvm::Function *createCullDistanceCuller(llvm::Module *module);
   llvm::Function *createFetchCullingRegister();
 
   llvm::Value *ballot(llvm::Value *value);
@@ -43,6 +43,7 @@
 #include "lgc/patch/LowerDesc.h"
 #include "lgc/patch/LowerGpuRt.h"
 #include "lgc/patch/LowerSubgroupOps.h"
+#include "lgc/patch/PatchBufferCoalescer.h"
 #include "lgc/patch/PatchBufferOp.h"
 #include "lgc/patch/PatchCheckShaderCache.h"
 #include "lgc/patch/PatchCopyShader.h"
@@ -60,6 +61,7 @@
 #include "lgc/patch/PatchReadFirstLane.h"
 #include "lgc/patch/PatchResourceCollect.h"
 #include "lgc/patch/PatchSetupTargetFeatures.h"
+#include "lgc/patch/PatchWaterfallFusion.h"
 #include "lgc/patch/PatchWorkarounds.h"
 #include "lgc/patch/TcsPassthroughShader.h"
 #include "lgc/patch/VertexFetch.h"
@@ -207,6 +209,9 @@ void Patch::addPasses(PipelineState *pipelineState, lgc::PassManager &passMgr, T
     LgcContext::createAndAddStartStopTimer(passMgr, patchTimer, true);
   }
 
+  // Fuse waterfall loops on the same non-uniform index, now that CSE has merged identical index computations.
+  passMgr.addPass(createModuleToFunctionPassAdaptor(PatchWaterfallFusion()));
+
   // Collect image operations
   if (pipelineState->getTargetInfo().getGfxIpVersion().major >= 11)
     passMgr.addPass(PatchImageOpCollect());
@@ -234,6 +239,7 @@ void Patch::addPasses(PipelineState *pipelineState, lgc::PassManager &passMgr, T
     fpm.addPass(ADCEPass());
     fpm.addPass(PatchBufferOp());
     fpm.addPass(InstCombinePass());
+    fpm.addPass(PatchBufferCoalescer());
     fpm.addPass(SimplifyCFGPass());
     passMgr.addPass(createModuleToFunctionPassAdaptor(std::move(fpm)));
 
@@ -245,6 +251,7 @@ void Patch::addPasses(PipelineState *pipelineState, lgc::PassManager &passMgr, T
     FunctionPassManager fpm;
     fpm.addPass(PatchBufferOp());
     fpm.addPass(InstCombinePass());
+    fpm.addPass(PatchBufferCoalescer());
     passMgr.addPass(createModuleToFunctionPassAdaptor(std::move(fpm)));
   }
 
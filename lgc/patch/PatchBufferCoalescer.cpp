@@ -0,0 +1,419 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchBufferCoalescer.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PatchBufferCoalescer.
+ ***********************************************************************************************************************
+ */
+#include "lgc/patch/PatchBufferCoalescer.h"
+#include "lgc/state/PipelineState.h"
+#include "lgc/state/ShaderStage.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <numeric>
+#include <optional>
+#include <tuple>
+
+#define DEBUG_TYPE "lgc-patch-buffer-coalescer"
+
+using namespace llvm;
+using namespace lgc;
+
+// -coalesce-buffer-ops: merge adjacent dword buffer loads and stores on the same descriptor
+static cl::opt<bool> CoalesceBufferOps("coalesce-buffer-ops",
+                                       cl::desc("Merge adjacent dword buffer loads and stores on the same descriptor"),
+                                       cl::init(true));
+
+// The widest merged access, dwordx4
+static constexpr unsigned MaxCoalescedDwords = 4;
+
+using BufferAccess = PatchBufferCoalescer::BufferAccess;
+
+// =====================================================================================================================
+// Gets the buffer access made by an instruction, if it is a candidate for coalescing: a dword-granular raw.buffer.load,
+// s.buffer.load or raw.buffer.store at a dword-aligned constant distance from its base offset.
+//
+// @param inst : Instruction to check
+static std::optional<BufferAccess> getBufferAccess(Instruction &inst) {
+  auto intrinsic = dyn_cast<IntrinsicInst>(&inst);
+  if (!intrinsic)
+    return std::nullopt;
+
+  BufferAccess access = {};
+  access.call = intrinsic;
+  access.intrinsicId = intrinsic->getIntrinsicID();
+  Type *valueTy = intrinsic->getType();
+  Value *offset = nullptr;
+  Value *aux = nullptr;
+  switch (access.intrinsicId) {
+  case Intrinsic::amdgcn_raw_buffer_load:
+    access.desc = intrinsic->getArgOperand(0);
+    offset = intrinsic->getArgOperand(1);
+    access.soffset = intrinsic->getArgOperand(2);
+    aux = intrinsic->getArgOperand(3);
+    access.isInvariant = intrinsic->hasMetadata(LLVMContext::MD_invariant_load);
+    break;
+  case Intrinsic::amdgcn_s_buffer_load:
+    access.desc = intrinsic->getArgOperand(0);
+    offset = intrinsic->getArgOperand(1);
+    aux = intrinsic->getArgOperand(2);
+    access.isInvariant = true;
+    break;
+  case Intrinsic::amdgcn_raw_buffer_store:
+    valueTy = intrinsic->getArgOperand(0)->getType();
+    access.desc = intrinsic->getArgOperand(1);
+    offset = intrinsic->getArgOperand(2);
+    access.soffset = intrinsic->getArgOperand(3);
+    aux = intrinsic->getArgOperand(4);
+    break;
+  default:
+    return std::nullopt;
+  }
+
+  if (!isa<ConstantInt>(aux) || valueTy->isPtrOrPtrVectorTy() || valueTy->getScalarSizeInBits() != 32)
+    return std::nullopt;
+  access.aux = cast<ConstantInt>(aux)->getZExtValue();
+  access.dwords = isa<FixedVectorType>(valueTy) ? cast<FixedVectorType>(valueTy)->getNumElements() : 1;
+  if (access.dwords >= MaxCoalescedDwords)
+    return std::nullopt;
+
+  // PatchBufferOp forms the offset of each part of an access as the base plus a constant.
+  if (auto constOffset = dyn_cast<ConstantInt>(offset)) {
+    access.offset = constOffset->getSExtValue();
+  } else if (auto add = dyn_cast<BinaryOperator>(offset);
+             add && add->getOpcode() == Instruction::Add && isa<ConstantInt>(add->getOperand(1))) {
+    access.base = add->getOperand(0);
+    access.offset = cast<ConstantInt>(add->getOperand(1))->getSExtValue();
+  } else {
+    access.base = offset;
+  }
+  if (access.offset % 4 != 0)
+    return std::nullopt;
+  return access;
+}
+
+// =====================================================================================================================
+// Checks whether two stores address the same buffer range through the same descriptor, base offset, soffset and cache
+// policy, so that their relative order only matters if their constant offsets overlap.
+//
+// @param lhs : First store
+// @param rhs : Second store
+static bool haveSameStoreKey(const BufferAccess &lhs, const BufferAccess &rhs) {
+  return lhs.desc == rhs.desc && lhs.base == rhs.base && lhs.soffset == rhs.soffset && lhs.aux == rhs.aux;
+}
+
+namespace lgc {
+
+// =====================================================================================================================
+// Executes this LLVM pass on the specified LLVM function.
+//
+// @param [in/out] function : Function that we will patch.
+// @param [in/out] analysisManager : Analysis manager to use for this transformation
+// @returns : The preserved analyses (The analyses that are still valid after this pass)
+PreservedAnalyses PatchBufferCoalescer::run(Function &function, FunctionAnalysisManager &analysisManager) {
+  const auto &moduleAnalysisManager = analysisManager.getResult<ModuleAnalysisManagerFunctionProxy>(function);
+  PipelineState *pipelineState =
+      moduleAnalysisManager.getCachedResult<PipelineStateWrapper>(*function.getParent())->getPipelineState();
+
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Buffer-Coalescer\n");
+
+  // Extended robustness bounds-checks each access on its own, so a merged access could fail where a part would not.
+  if (!CoalesceBufferOps || pipelineState->getOptions().enableExtendedRobustBufferAccess)
+    return PreservedAnalyses::all();
+
+  // The load scalarizer threshold asks for loads up to that many dwords to stay scalar. PatchLoadScalarizer only splits
+  // LLVM loads and has already run, so honor the threshold here by not creating merged loads that small.
+  auto shaderStage = getShaderStage(&function);
+  m_scalarThreshold = 0;
+  if (shaderStage)
+    m_scalarThreshold = pipelineState->getShaderOptions(shaderStage.value()).loadScalarizerThreshold;
+
+  m_builder = std::make_unique<IRBuilder<>>(function.getContext());
+  m_changed = false;
+
+  for (BasicBlock &block : function) {
+    for (Instruction &inst : make_early_inc_range(block)) {
+      if (std::optional<BufferAccess> access = getBufferAccess(inst)) {
+        if (access->intrinsicId == Intrinsic::amdgcn_raw_buffer_store) {
+          flushLoads(/*keepInvariant=*/true);
+          // Merging sinks stores to the last of them. A store with another descriptor or base may alias the pending
+          // ones, so it must not be passed: end the window instead.
+          if (!m_pendingStores.empty() && !haveSameStoreKey(m_pendingStores.front(), *access))
+            flushStores();
+          m_pendingStores.push_back(*access);
+        } else {
+          if (!access->isInvariant)
+            flushStores();
+          m_pendingLoads.push_back(*access);
+        }
+        continue;
+      }
+
+      // A write ends the run of loads that can be moved up together, and any access ends the run of stores that can
+      // be moved down together.
+      if (inst.mayWriteToMemory() || inst.mayHaveSideEffects()) {
+        flushLoads(/*keepInvariant=*/true);
+        flushStores();
+      } else if (inst.mayReadFromMemory()) {
+        flushStores();
+      }
+    }
+    flushLoads(/*keepInvariant=*/false);
+    flushStores();
+  }
+
+  if (!m_changed)
+    return PreservedAnalyses::all();
+
+  PreservedAnalyses preserved;
+  preserved.preserveSet<CFGAnalyses>();
+  return preserved;
+}
+
+// =====================================================================================================================
+// Coalesces the pending loads.
+//
+// @param keepInvariant : Keep the invariant loads pending, as they can still be merged with loads after a write
+void PatchBufferCoalescer::flushLoads(bool keepInvariant) {
+  SmallVector<BufferAccess, 8> loads;
+  SmallVector<BufferAccess, 8> keptLoads;
+  for (const BufferAccess &load : m_pendingLoads)
+    (keepInvariant && load.isInvariant ? keptLoads : loads).push_back(load);
+  m_pendingLoads = std::move(keptLoads);
+  coalesce(loads);
+}
+
+// =====================================================================================================================
+// Coalesces the pending stores.
+void PatchBufferCoalescer::flushStores() {
+  SmallVector<BufferAccess, 8> stores = std::move(m_pendingStores);
+  m_pendingStores.clear();
+  coalesce(stores);
+}
+
+// =====================================================================================================================
+// Merges runs of contiguous accesses with the same descriptor, base offset and cache policy.
+//
+// @param accesses : Loads or stores, in program order, that may be reordered among themselves
+void PatchBufferCoalescer::coalesce(SmallVectorImpl<BufferAccess> &accesses) {
+  if (accesses.size() < 2)
+    return;
+
+  using AccessKey = std::tuple<unsigned, Value *, Value *, Value *, unsigned, unsigned>;
+  MapVector<AccessKey, SmallVector<BufferAccess, 4>> groups;
+  for (const BufferAccess &access : accesses) {
+    AccessKey key(access.intrinsicId, access.desc, access.base, access.soffset, access.aux, access.isInvariant);
+    groups[key].push_back(access);
+  }
+
+  for (auto &entry : groups) {
+    SmallVectorImpl<BufferAccess> &group = entry.second;
+    if (group.size() < 2)
+      continue;
+    const unsigned intrinsicId = group.front().intrinsicId;
+    const bool isStore = intrinsicId == Intrinsic::amdgcn_raw_buffer_store;
+
+    llvm::stable_sort(group, [](const BufferAccess &lhs, const BufferAccess &rhs) { return lhs.offset < rhs.offset; });
+
+    // Merging stores moves them past each other, which is only safe if none of them overlap.
+    if (isStore && any_of(seq<size_t>(1, group.size()), [&group](size_t idx) {
+          return group[idx].offset < group[idx - 1].offset + group[idx - 1].dwords * 4;
+        }))
+      continue;
+
+    auto mergeChunk = [&](ArrayRef<BufferAccess> chunk) {
+      unsigned dwords = 0;
+      for (const BufferAccess &access : chunk)
+        dwords += access.dwords;
+      // s.buffer.load has no dwordx3 form.
+      while (intrinsicId == Intrinsic::amdgcn_s_buffer_load && dwords == 3 && chunk.size() > 1) {
+        dwords -= chunk.back().dwords;
+        chunk = chunk.drop_back();
+      }
+      if (chunk.size() < 2 || (!isStore && dwords <= m_scalarThreshold))
+        return;
+      if (isStore)
+        mergeStores(chunk);
+      else
+        mergeLoads(chunk);
+      m_changed = true;
+    };
+
+    size_t chunkStart = 0;
+    unsigned chunkDwords = group.front().dwords;
+    for (size_t idx = 1; idx != group.size(); ++idx) {
+      const BufferAccess &prev = group[idx - 1];
+      const BufferAccess &access = group[idx];
+      if (access.offset == prev.offset + prev.dwords * 4 && chunkDwords + access.dwords <= MaxCoalescedDwords) {
+        chunkDwords += access.dwords;
+        continue;
+      }
+      mergeChunk(ArrayRef<BufferAccess>(group).slice(chunkStart, idx - chunkStart));
+      chunkStart = idx;
+      chunkDwords = access.dwords;
+    }
+    mergeChunk(ArrayRef<BufferAccess>(group).slice(chunkStart));
+  }
+}
+
+// =====================================================================================================================
+// Gets the offset operand for a merged access, for the builder's insert point.
+//
+// @param builder : IRBuilder
+// @param first : The access with the lowest offset
+static Value *getMergedOffset(IRBuilder<> &builder, const BufferAccess &first) {
+  if (!first.base)
+    return builder.getInt32(first.offset);
+  if (first.offset == 0)
+    return first.base;
+  return builder.CreateAdd(first.base, builder.getInt32(first.offset));
+}
+
+// =====================================================================================================================
+// Copies the metadata that all the merged accesses agree on.
+//
+// @param merged : The merged access
+// @param accesses : The accesses it replaces
+static void copyCommonMetadata(Instruction *merged, ArrayRef<BufferAccess> accesses) {
+  SmallVector<std::pair<unsigned, MDNode *>, 4> allMetadata;
+  accesses.front().call->getAllMetadataOtherThanDebugLoc(allMetadata);
+  for (const auto &[kind, node] : allMetadata) {
+    if (all_of(accesses, [kind = kind, node = node](const BufferAccess &access) {
+          return access.call->getMetadata(kind) == node;
+        }))
+      merged->setMetadata(kind, node);
+  }
+}
+
+// =====================================================================================================================
+// Erases merged accesses, along with offset computations that are no longer used.
+//
+// @param accesses : The accesses that were merged
+static void eraseAccesses(ArrayRef<PatchBufferCoalescer::BufferAccess> accesses) {
+  SmallVector<WeakTrackingVH, 4> offsets;
+  for (const PatchBufferCoalescer::BufferAccess &access : accesses) {
+    unsigned offsetIdx = access.intrinsicId == Intrinsic::amdgcn_raw_buffer_store ? 2 : 1;
+    offsets.push_back(access.call->getArgOperand(offsetIdx));
+    access.call->eraseFromParent();
+  }
+  RecursivelyDeleteTriviallyDeadInstructionsPermissive(offsets);
+}
+
+// =====================================================================================================================
+// Replaces contiguous loads, sorted by offset, with one load at the position of the first of them in program order.
+//
+// @param loads : Loads to merge
+void PatchBufferCoalescer::mergeLoads(ArrayRef<BufferAccess> loads) {
+  const BufferAccess &first = loads.front();
+  Instruction *insertPos = first.call;
+  unsigned dwords = 0;
+  for (const BufferAccess &load : loads) {
+    if (load.call->comesBefore(insertPos))
+      insertPos = load.call;
+    dwords += load.dwords;
+  }
+
+  m_builder->SetInsertPoint(insertPos);
+  m_builder->SetCurrentDebugLocation(insertPos->getDebugLoc());
+  Type *mergedTy = FixedVectorType::get(m_builder->getInt32Ty(), dwords);
+  Value *offset = getMergedOffset(*m_builder, first);
+  CallInst *merged = nullptr;
+  if (first.intrinsicId == Intrinsic::amdgcn_s_buffer_load) {
+    merged = m_builder->CreateIntrinsic(Intrinsic::amdgcn_s_buffer_load, mergedTy,
+                                        {first.desc, offset, m_builder->getInt32(first.aux)});
+  } else {
+    merged = m_builder->CreateIntrinsic(Intrinsic::amdgcn_raw_buffer_load, mergedTy,
+                                        {first.desc, offset, first.soffset, m_builder->getInt32(first.aux)});
+  }
+  copyCommonMetadata(merged, loads);
+  LLVM_DEBUG(dbgs() << "Merged " << loads.size() << " loads into " << *merged << "\n");
+
+  unsigned dwordIdx = 0;
+  for (const BufferAccess &load : loads) {
+    Value *part = nullptr;
+    if (load.dwords == 1) {
+      part = m_builder->CreateExtractElement(merged, dwordIdx);
+    } else {
+      SmallVector<int, 4> mask(load.dwords);
+      std::iota(mask.begin(), mask.end(), dwordIdx);
+      part = m_builder->CreateShuffleVector(merged, mask);
+    }
+    part = m_builder->CreateBitCast(part, load.call->getType());
+    part->takeName(load.call);
+    load.call->replaceAllUsesWith(part);
+    dwordIdx += load.dwords;
+  }
+  eraseAccesses(loads);
+}
+
+// =====================================================================================================================
+// Replaces contiguous stores, sorted by offset, with one store at the position of the last of them in program order.
+//
+// @param stores : Stores to merge
+void PatchBufferCoalescer::mergeStores(ArrayRef<BufferAccess> stores) {
+  const BufferAccess &first = stores.front();
+  Instruction *insertPos = first.call;
+  unsigned dwords = 0;
+  for (const BufferAccess &store : stores) {
+    if (insertPos->comesBefore(store.call))
+      insertPos = store.call;
+    dwords += store.dwords;
+  }
+
+  m_builder->SetInsertPoint(insertPos);
+  m_builder->SetCurrentDebugLocation(insertPos->getDebugLoc());
+  Type *mergedTy = FixedVectorType::get(m_builder->getInt32Ty(), dwords);
+  Value *mergedValue = PoisonValue::get(mergedTy);
+  unsigned dwordIdx = 0;
+  for (const BufferAccess &store : stores) {
+    Value *value = store.call->getArgOperand(0);
+    if (store.dwords == 1) {
+      value = m_builder->CreateBitCast(value, m_builder->getInt32Ty());
+      mergedValue = m_builder->CreateInsertElement(mergedValue, value, dwordIdx++);
+      continue;
+    }
+    value = m_builder->CreateBitCast(value, FixedVectorType::get(m_builder->getInt32Ty(), store.dwords));
+    for (unsigned idx = 0; idx != store.dwords; ++idx) {
+      Value *elem = m_builder->CreateExtractElement(value, idx);
+      mergedValue = m_builder->CreateInsertElement(mergedValue, elem, dwordIdx++);
+    }
+  }
+
+  Value *offset = getMergedOffset(*m_builder, first);
+  CallInst *merged = m_builder->CreateIntrinsic(
+      Intrinsic::amdgcn_raw_buffer_store, mergedTy,
+      {mergedValue, first.desc, offset, first.soffset, m_builder->getInt32(first.aux)});
+  copyCommonMetadata(merged, stores);
+  LLVM_DEBUG(dbgs() << "Merged " << stores.size() << " stores into " << *merged << "\n");
+
+  eraseAccesses(stores);
+}
+
+} // namespace lgc
@@ -75,7 +75,7 @@ PreservedAnalyses PatchCopyShader::run(Module &module, ModuleAnalysisManager &an
   m_pipelineState->setShaderStageMask(m_pipelineState->getShaderStageMask() | ShaderStageMask(ShaderStage::CopyShader));
 
   // Gather GS generic export details.
-  collectGsGenericOutputInfo(gsEntryPoint);
+  collectGsGenericOutputInfo(gsEntryPoint, analysisManager.getResult<CallSiteIndex>(module));
 
   BuilderBase builder(*m_context);
 
@@ -292,65 +292,63 @@ PreservedAnalyses PatchCopyShader::run(Module &module, ModuleAnalysisManager &an
 // Collects info for GS generic outputs.
 //
 // @param gsEntryPoint : Geometry shader entrypoint
-void PatchCopyShader::collectGsGenericOutputInfo(Function *gsEntryPoint) {
+// @param callSiteIndex : Index of lgc.* call sites in the module
+void PatchCopyShader::collectGsGenericOutputInfo(Function *gsEntryPoint, const CallSiteIndexResult &callSiteIndex) {
   auto resUsage = m_pipelineState->getShaderResourceUsage(ShaderStage::CopyShader);
   const auto &outputLocInfoMap = resUsage->inOutUsage.outputLocInfoMap;
   std::set<InOutLocationInfo> visitedLocInfos;
 
   // Collect the byte sizes of the output value at each mapped location
-  for (auto &func : *gsEntryPoint->getParent()) {
-    if (func.getName().starts_with(lgcName::OutputExportGeneric)) {
-      for (auto user : func.users()) {
-        auto callInst = dyn_cast<CallInst>(user);
-        if (!callInst || callInst->getParent()->getParent() != gsEntryPoint)
-          continue;
-
-        assert(callInst->arg_size() == 4);
-        Value *output = callInst->getOperand(callInst->arg_size() - 1); // Last argument
-        auto outputTy = output->getType();
-
-        InOutLocationInfo origLocInfo;
-        origLocInfo.setLocation(cast<ConstantInt>(callInst->getOperand(0))->getZExtValue());
-        unsigned component = cast<ConstantInt>(callInst->getOperand(1))->getZExtValue();
-        if (outputTy->getScalarSizeInBits() == 64)
-          component *= 2; // Component in location info is dword-based
-        origLocInfo.setComponent(component);
-        origLocInfo.setStreamId(cast<ConstantInt>(callInst->getOperand(2))->getZExtValue());
-
-        const auto locInfoMapIt = outputLocInfoMap.find(origLocInfo);
-        if (locInfoMapIt == outputLocInfoMap.end() || visitedLocInfos.count(origLocInfo) > 0)
-          continue;
-        visitedLocInfos.insert(origLocInfo);
-
-        unsigned dwordSize = 1; // Each output call is scalarized and exports 1 dword for packing
-        if (!m_pipelineState->canPackOutput(ShaderStage::Geometry)) {
-          unsigned compCount = 1;
-          auto compTy = outputTy;
-          auto outputVecTy = dyn_cast<FixedVectorType>(outputTy);
-          if (outputVecTy) {
-            compCount = outputVecTy->getNumElements();
-            compTy = outputVecTy->getElementType();
-          }
-
-          unsigned bitWidth = compTy->getScalarSizeInBits();
-          // NOTE: Currently, to simplify the design of load/store data from GS-VS ring, we always extend
-          // byte/word to dword and store dword to GS-VS ring. So for 8-bit/16-bit data type, the actual byte size
-          // is based on number of dwords.
-          bitWidth = std::max(32u, bitWidth);
-          dwordSize = bitWidth / 32 * compCount;
-        }
-
-        const unsigned streamId = origLocInfo.getStreamId();
-        const unsigned newLoc = locInfoMapIt->second.getLocation();
-        const unsigned newComp = locInfoMapIt->second.getComponent();
-        if (dwordSize > 4) {
-          assert(dwordSize <= 8); // <8 x dword> at most
-          m_outputLocCompSizeMap[streamId][newLoc][newComp] = 4;
-          m_outputLocCompSizeMap[streamId][newLoc + 1][newComp] = dwordSize - 4;
-        } else {
-          m_outputLocCompSizeMap[streamId][newLoc][newComp] = dwordSize;
-        }
+  SmallVector<CallInst *, 16> gsOutputExports;
+  callSiteIndex.getCalls(lgcName::OutputExportGeneric, ShaderStage::Geometry, gsOutputExports);
+  for (CallInst *callInst : gsOutputExports) {
+    if (callInst->getFunction() != gsEntryPoint)
+      continue;
+
+    assert(callInst->arg_size() == 4);
+    Value *output = callInst->getOperand(callInst->arg_size() - 1); // Last argument
+    auto outputTy = output->getType();
+
+    InOutLocationInfo origLocInfo;
+    origLocInfo.setLocation(cast<ConstantInt>(callInst->getOperand(0))->getZExtValue());
+    unsigned component = cast<ConstantInt>(callInst->getOperand(1))->getZExtValue();
+    if (outputTy->getScalarSizeInBits() == 64)
+      component *= 2; // Component in location info is dword-based
+    origLocInfo.setComponent(component);
+    origLocInfo.setStreamId(cast<ConstantInt>(callInst->getOperand(2))->getZExtValue());
+
+    const auto locInfoMapIt = outputLocInfoMap.find(origLocInfo);
+    if (locInfoMapIt == outputLocInfoMap.end() || visitedLocInfos.count(origLocInfo) > 0)
+      continue;
+    visitedLocInfos.insert(origLocInfo);
+
+    unsigned dwordSize = 1; // Each output call is scalarized and exports 1 dword for packing
+    if (!m_pipelineState->canPackOutput(ShaderStage::Geometry)) {
+      unsigned compCount = 1;
+      auto compTy = outputTy;
+      auto outputVecTy = dyn_cast<FixedVectorType>(outputTy);
+      if (outputVecTy) {
+        compCount = outputVecTy->getNumElements();
+        compTy = outputVecTy->getElementType();
       }
+
+      unsigned bitWidth = compTy->getScalarSizeInBits();
+      // NOTE: Currently, to simplify the design of load/store data from GS-VS ring, we always extend
+      // byte/word to dword and store dword to GS-VS ring. So for 8-bit/16-bit data type, the actual byte size
+      // is based on number of dwords.
+      bitWidth = std::max(32u, bitWidth);
+      dwordSize = bitWidth / 32 * compCount;
+    }
+
+    const unsigned streamId = origLocInfo.getStreamId();
+    const unsigned newLoc = locInfoMapIt->second.getLocation();
+    const unsigned newComp = locInfoMapIt->second.getComponent();
+    if (dwordSize > 4) {
+      assert(dwordSize <= 8); // <8 x dword> at most
+      m_outputLocCompSizeMap[streamId][newLoc][newComp] = 4;
+      m_outputLocCompSizeMap[streamId][newLoc + 1][newComp] = dwordSize - 4;
+    } else {
+      m_outputLocCompSizeMap[streamId][newLoc][newComp] = dwordSize;
     }
   }
 }
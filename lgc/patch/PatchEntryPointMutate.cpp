@@ -61,6 +61,7 @@
 #include "lgc/patch/ShaderInputs.h"
 #include "lgc/state/AbiMetadata.h"
 #include "lgc/state/AbiUnlinked.h"
+#include "lgc/state/CallSiteIndex.h"
 #include "lgc/state/IntrinsDefs.h"
 #include "lgc/state/PalMetadata.h"
 #include "lgc/state/PipelineShaders.h"
@@ -69,7 +70,10 @@
 #include "lgc/util/AddressExtender.h"
 #include "lgc/util/BuilderBase.h"
 #include "llvm-dialects/Dialect/Visitor.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/Analysis/AliasAnalysis.h" // for MemoryEffects
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -113,6 +117,7 @@ PatchEntryPointMutate::UserDataArg::UserDataArg(llvm::Type *argTy, const llvm::T
 PreservedAnalyses PatchEntryPointMutate::run(Module &module, ModuleAnalysisManager &analysisManager) {
   PipelineState *pipelineState = analysisManager.getResult<PipelineStateWrapper>(module).getPipelineState();
   PipelineShadersResult &pipelineShaders = analysisManager.getResult<PipelineShaders>(module);
+  CallSiteIndexResult &callSiteIndex = analysisManager.getResult<CallSiteIndex>(module);
 
   LLVM_DEBUG(dbgs() << "Run the pass Patch-Entry-Point-Mutate\n");
 
@@ -127,11 +132,12 @@ PreservedAnalyses PatchEntryPointMutate::run(Module &module, ModuleAnalysisManag
   m_hasGs = stageMask.contains(ShaderStage::Geometry);
 
   // Gather user data usage.
-  gatherUserDataUsage(&module);
+  gatherUserDataUsage(&module, callSiteIndex);
+  computeUserDataLoadWeights(analysisManager.getResult<FunctionAnalysisManagerModuleProxy>(module).getManager());
 
   // Create ShaderInputs object and gather shader input usage.
   ShaderInputs shaderInputs;
-  shaderInputs.gatherUsage(module);
+  shaderInputs.gatherUsage(callSiteIndex);
   setupComputeWithCalls(&module);
 
   if (m_pipelineState->isGraphics()) {
@@ -885,7 +891,8 @@ void PatchEntryPointMutate::setupComputeWithCalls(Module *module) {
 // Gather user data usage in all shaders
 //
 // @param module : IR module
-void PatchEntryPointMutate::gatherUserDataUsage(Module *module) {
+// @param callSiteIndex : Index of lgc.* call sites in the module
+void PatchEntryPointMutate::gatherUserDataUsage(Module *module, const CallSiteIndexResult &callSiteIndex) {
   // Gather special ops requiring user data.
   static const auto visitor =
       llvm_dialects::VisitorBuilder<PatchEntryPointMutate>()
@@ -966,30 +973,53 @@ void PatchEntryPointMutate::gatherUserDataUsage(Module *module) {
 
   visitor.visit(*this, *module);
 
-  for (Function &func : *module) {
-    if (!func.isDeclaration())
-      continue;
+  SmallVector<CallInst *, 8> specialUserDataCalls;
+  callSiteIndex.getCalls(lgcName::SpecialUserData, specialUserDataCalls);
+  for (CallInst *call : specialUserDataCalls) {
+    auto stage = getShaderStage(call->getFunction());
+    assert(stage != ShaderStage::CopyShader);
+    auto &specialUserData = getUserDataUsage(stage.value())->specialUserData;
+    unsigned index = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue() -
+                     static_cast<unsigned>(UserDataMapping::GlobalTable);
+    specialUserData.resize(std::max(specialUserData.size(), size_t(index + 1)));
+    specialUserData[index].users.push_back(call);
+  }
 
-    if (func.getName().starts_with(lgcName::SpecialUserData)) {
-      for (User *user : func.users()) {
-        CallInst *call = cast<CallInst>(user);
-        auto stage = getShaderStage(call->getFunction());
-        assert(stage != ShaderStage::CopyShader);
-        auto &specialUserData = getUserDataUsage(stage.value())->specialUserData;
-        unsigned index = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue() -
-                         static_cast<unsigned>(UserDataMapping::GlobalTable);
-        specialUserData.resize(std::max(specialUserData.size(), size_t(index + 1)));
-        specialUserData[index].users.push_back(call);
-      }
+  SmallVector<CallInst *, 4> xfbExportCalls;
+  callSiteIndex.getCalls(lgcName::OutputExportXfb, xfbExportCalls);
+  if (!xfbExportCalls.empty() || m_pipelineState->enableSwXfb()) {
+    // NOTE: For GFX11+, SW emulated stream-out will always use stream-out buffer descriptors and stream-out buffer
+    // offsets to calculate numbers of written primitives/dwords and update the counters.
+    auto lastVertexStage = m_pipelineState->getLastVertexProcessingStage();
+    lastVertexStage = lastVertexStage == ShaderStage::CopyShader ? ShaderStage::Geometry : lastVertexStage;
+    getUserDataUsage(lastVertexStage)->usesStreamOutTable = true;
+  }
+}
+
+// =====================================================================================================================
+// Weight each fixed-offset user data load by the static execution frequency of its block relative to the function
+// entry, so that user data used in loops can be preferred when allocating user data SGPRs.
+//
+// @param [in/out] funcAnalysisManager : Function analysis manager providing loop info and block frequencies
+void PatchEntryPointMutate::computeUserDataLoadWeights(FunctionAnalysisManager &funcAnalysisManager) {
+  MapVector<Function *, SmallVector<UserDataLoad *, 8>> loadsByFunc;
+  for (auto &userDataUsage : m_userDataUsage) {
+    if (!userDataUsage)
       continue;
-    }
+    for (UserDataLoad &load : userDataUsage->loads)
+      loadsByFunc[load.load->getFunction()].push_back(&load);
+  }
 
-    if ((func.getName().starts_with(lgcName::OutputExportXfb) && !func.use_empty()) || m_pipelineState->enableSwXfb()) {
-      // NOTE: For GFX11+, SW emulated stream-out will always use stream-out buffer descriptors and stream-out buffer
-      // offsets to calculate numbers of written primitives/dwords and update the counters.  auto lastVertexStage =
-      auto lastVertexStage = m_pipelineState->getLastVertexProcessingStage();
-      lastVertexStage = lastVertexStage == ShaderStage::CopyShader ? ShaderStage::Geometry : lastVertexStage;
-      getUserDataUsage(lastVertexStage)->usesStreamOutTable = true;
+  for (auto &[func, loads] : loadsByFunc) {
+    LoopInfo &loopInfo = funcAnalysisManager.getResult<LoopAnalysis>(*func);
+    if (loopInfo.empty())
+      continue; // Nothing is executed more often than the entry.
+
+    BlockFrequencyInfo &blockFreqInfo = funcAnalysisManager.getResult<BlockFrequencyAnalysis>(*func);
+    double entryFreq = blockFreqInfo.getBlockFreq(&func->getEntryBlock()).getFrequency();
+    for (UserDataLoad *load : loads) {
+      double freq = blockFreqInfo.getBlockFreq(load->load->getParent()).getFrequency();
+      load->weight = std::max(freq / entryFreq, 1.0);
     }
   }
 }
@@ -1092,14 +1122,31 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
       op->eraseFromParent();
     }
 
-    // Handle generic fixed-offset user data loads.
+    // Handle generic fixed-offset user data loads. A load from the spill table that is executed more often than the
+    // function entry is hoisted to just after the spill table pointer, and shared by all such loads of the same type
+    // from the same offset.
+    Instruction *hoistPos = spillTable ? spillTable->getNextNode() : nullptr;
+    DenseMap<std::pair<unsigned, Type *>, Value *> hoistedLoads;
     for (auto &load : userDataUsage->loads) {
       if (!load.load || load.load->getFunction() != &func)
         continue;
 
-      builder.SetInsertPoint(load.load);
-      load.load->replaceAllUsesWith(
-          loadUserData(*userDataUsage, spillTable, load.load->getType(), load.dwordOffset, builder));
+      bool inSgprs = load.dwordOffset + load.dwordSize <= userDataUsage->entryArgIdxs.size() &&
+                     all_of(ArrayRef<unsigned>(userDataUsage->entryArgIdxs).slice(load.dwordOffset, load.dwordSize),
+                            [](unsigned entryArgIdx) { return entryArgIdx != 0; });
+      Value *replacement = nullptr;
+      if (hoistPos && !inSgprs && load.weight > 1.0) {
+        Value *&hoisted = hoistedLoads[{load.dwordOffset, load.load->getType()}];
+        if (!hoisted) {
+          builder.SetInsertPoint(hoistPos);
+          hoisted = loadUserData(*userDataUsage, spillTable, load.load->getType(), load.dwordOffset, builder);
+        }
+        replacement = hoisted;
+      } else {
+        builder.SetInsertPoint(load.load);
+        replacement = loadUserData(*userDataUsage, spillTable, load.load->getType(), load.dwordOffset, builder);
+      }
+      load.load->replaceAllUsesWith(replacement);
       load.load->eraseFromParent();
       load.load = nullptr;
     }
@@ -1211,7 +1258,8 @@ void PatchEntryPointMutate::processComputeFuncs(ShaderInputs *shaderInputs, Modu
         // This is the declaration of a callable function that is defined in a different module.
         func.setCallingConv(CallingConv::AMDGPU_Gfx);
       }
-    } else {
+    } else if (!func.getName().starts_with(lgcName::SubgroupHelperPrefix)) {
+      // Shared subgroup helpers do not use shader inputs, so they are left as plain internal functions.
       origFuncs.push_back(&func);
     }
   }
@@ -1935,6 +1983,12 @@ void PatchEntryPointMutate::finalizeUserDataArgs(SmallVectorImpl<UserDataArg> &u
     if (node)
       m_pipelineState->getPalMetadata()->setUserDataSpillUsage(node->offsetInDwords);
   } else {
+    // If not everything fits, first decide which user data goes to the spill table based on execution frequency.
+    if (spillColdUserData(*userDataUsage, userDataAvailable - userDataEnd, spill) && !spill) {
+      --userDataAvailable;
+      spill = true;
+    }
+
     // Greedily fit as many generic user data arguments as possible.
     // Pre-allocate entryArgIdxs since we rely on stable pointers.
     userDataUsage->entryArgIdxs.resize(userDataUsage->loadSizes.size());
@@ -2004,6 +2058,74 @@ void PatchEntryPointMutate::finalizeUserDataArgs(SmallVectorImpl<UserDataArg> &u
   }
 }
 
+// =====================================================================================================================
+// If the statically known user data loads do not all fit into the available SGPRs and some of them are in loops, choose
+// the ones to spill by execution frequency rather than by offset. Each run of overlapping loads is kept or spilled as a
+// whole; spilled runs are removed from loadSizes so that the greedy allocation in finalizeUserDataArgs keeps the rest.
+//
+// @param userDataUsage : User data usage of the current merged shader stage
+// @param sgprsAvailable : Number of SGPRs left for generic user data, not counting a spill table pointer to be added
+// @param haveSpillTable : Whether a spill table pointer has already been accounted for
+// @returns : True if some user data was spilled, so a spill table pointer is needed
+bool PatchEntryPointMutate::spillColdUserData(UserDataUsage &userDataUsage, unsigned sgprsAvailable,
+                                              bool haveSpillTable) {
+  // With merged shaders, this is called once per stage; the decision from the first call stands.
+  if (userDataUsage.haveSpilledColdUserData)
+    return true;
+  if (none_of(userDataUsage.loads, [](const UserDataLoad &load) { return load.weight > 1.0; }))
+    return false; // Keep the allocation in offset order.
+
+  struct UserDataRun {
+    unsigned dwordOffset;
+    unsigned dwordSize;
+    double weight;
+  };
+  SmallVector<UserDataRun> runs;
+  MutableArrayRef<unsigned> loadSizes = userDataUsage.loadSizes;
+  unsigned totalSize = 0;
+  for (unsigned i = 0; i != loadSizes.size();) {
+    if (loadSizes[i] == 0) {
+      ++i;
+      continue;
+    }
+    unsigned end = i + loadSizes[i];
+    for (unsigned j = i + 1; j < end; ++j)
+      end = std::max(end, j + loadSizes[j]);
+    runs.push_back({i, end - i, 0.0});
+    totalSize += end - i;
+    i = end;
+  }
+  if (totalSize <= sgprsAvailable)
+    return false;
+
+  for (const UserDataLoad &load : userDataUsage.loads) {
+    auto run = partition_point(
+        runs, [&](const UserDataRun &run) { return run.dwordOffset + run.dwordSize <= load.dwordOffset; });
+    assert(run != runs.end() && run->dwordOffset <= load.dwordOffset);
+    run->weight += load.weight;
+  }
+
+  // Keep the runs with the highest weight per dword.
+  SmallVector<UserDataRun *> order;
+  for (UserDataRun &run : runs)
+    order.push_back(&run);
+  llvm::stable_sort(order, [](const UserDataRun *lhs, const UserDataRun *rhs) {
+    return lhs->weight / lhs->dwordSize > rhs->weight / rhs->dwordSize;
+  });
+
+  unsigned budget = haveSpillTable ? sgprsAvailable : sgprsAvailable - 1;
+  for (UserDataRun *run : order) {
+    if (run->dwordSize <= budget) {
+      budget -= run->dwordSize;
+      continue;
+    }
+    m_pipelineState->getPalMetadata()->setUserDataSpillUsage(run->dwordOffset);
+    std::fill_n(loadSizes.begin() + run->dwordOffset, run->dwordSize, 0);
+  }
+  userDataUsage.haveSpilledColdUserData = true;
+  return true;
+}
+
 // =====================================================================================================================
 // Get UserDataUsage struct for the merged shader stage that contains the given shader stage
 //
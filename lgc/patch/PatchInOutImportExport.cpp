@@ -84,6 +84,7 @@ void PatchInOutImportExport::initPerShader() {
 PreservedAnalyses PatchInOutImportExport::run(Module &module, ModuleAnalysisManager &analysisManager) {
   PipelineState *pipelineState = analysisManager.getResult<PipelineStateWrapper>(module).getPipelineState();
   PipelineShadersResult &pipelineShaders = analysisManager.getResult<PipelineShaders>(module);
+  m_callSiteIndex = &analysisManager.getResult<CallSiteIndex>(module);
   auto getPostDominatorTree = [&](Function &f) -> PostDominatorTree & {
     auto &fam = analysisManager.getResult<FunctionAnalysisManagerModuleProxy>(module).getManager();
     return fam.getResult<PostDominatorTreeAnalysis>(f);
@@ -102,13 +103,10 @@ PreservedAnalyses PatchInOutImportExport::run(Module &module, ModuleAnalysisMana
   m_hasGs = stageMask.contains(ShaderStage::Geometry);
 
   SmallVector<Function *, 16> inputCallees, otherCallees;
-  for (auto &func : module.functions()) {
-    auto name = func.getName();
-    if (name.starts_with("lgc.input"))
-      inputCallees.push_back(&func);
-    else if (name.starts_with("lgc.output") || name == "llvm.amdgcn.s.sendmsg")
-      otherCallees.push_back(&func);
-  }
+  m_callSiteIndex->getDeclarations("lgc.input", inputCallees);
+  m_callSiteIndex->getDeclarations("lgc.output", otherCallees);
+  if (Function *sendMsg = module.getFunction("llvm.amdgcn.s.sendmsg"))
+    otherCallees.push_back(sendMsg);
 
   // Create the global variable that is to model LDS
   // NOTE: ES -> GS ring is always on-chip on GFX9.
@@ -174,6 +172,7 @@ PreservedAnalyses PatchInOutImportExport::run(Module &module, ModuleAnalysisMana
   m_exportCalls.clear();
 
   m_pipelineSysValues.clear();
+  m_callSiteIndex = nullptr;
 
   return PreservedAnalyses::none();
 }
@@ -448,38 +447,39 @@ void PatchInOutImportExport::processShader() {
   if (m_shaderStage == ShaderStage::Compute) {
     // In a compute shader, process lgc.reconfigure.local.invocation.id calls.
     // This does not particularly have to be done here; it could be done anywhere after BuilderImpl.
-    for (Function &func : *m_module) {
+    SmallVector<Function *, 2> reconfigDecls;
+    m_callSiteIndex->getDeclarations(lgcName::ReconfigureLocalInvocationId, reconfigDecls);
+    for (Function *func : reconfigDecls) {
       auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
 
       // Different with above, this will force the threadID swizzle which will rearrange thread ID within a group into
       // blocks of 8*4, not to reconfig workgroup automatically and will support to be swizzled in 8*4 block
       // split.
-      if (func.isDeclaration() && func.getName().starts_with(lgcName::ReconfigureLocalInvocationId)) {
-        unsigned workgroupSizeX = mode.workgroupSizeX;
-        unsigned workgroupSizeY = mode.workgroupSizeY;
-        unsigned workgroupSizeZ = mode.workgroupSizeZ;
-        SwizzleWorkgroupLayout layout = calculateWorkgroupLayout();
-        while (!func.use_empty()) {
-          CallInst *reconfigCall = cast<CallInst>(*func.user_begin());
-          Value *localInvocationId = reconfigCall->getArgOperand(0);
-          if (m_gfxIp.major <= 11) {
-            bool isHwLocalInvocationId = cast<ConstantInt>(reconfigCall->getArgOperand(1))->getZExtValue();
-            if ((layout.microLayout == WorkgroupLayout::Quads) ||
-                (layout.macroLayout == WorkgroupLayout::SexagintiQuads)) {
-              localInvocationId =
-                  reconfigWorkgroupLayout(localInvocationId, layout.macroLayout, layout.microLayout, workgroupSizeX,
-                                          workgroupSizeY, workgroupSizeZ, isHwLocalInvocationId, reconfigCall);
-            }
+      unsigned workgroupSizeX = mode.workgroupSizeX;
+      unsigned workgroupSizeY = mode.workgroupSizeY;
+      unsigned workgroupSizeZ = mode.workgroupSizeZ;
+      SwizzleWorkgroupLayout layout = calculateWorkgroupLayout();
+      while (!func->use_empty()) {
+        CallInst *reconfigCall = cast<CallInst>(*func->user_begin());
+        Value *localInvocationId = reconfigCall->getArgOperand(0);
+        if (m_gfxIp.major <= 11) {
+          bool isHwLocalInvocationId = cast<ConstantInt>(reconfigCall->getArgOperand(1))->getZExtValue();
+          if ((layout.microLayout == WorkgroupLayout::Quads) ||
+              (layout.macroLayout == WorkgroupLayout::SexagintiQuads)) {
+            localInvocationId =
+                reconfigWorkgroupLayout(localInvocationId, layout.macroLayout, layout.microLayout, workgroupSizeX,
+                                        workgroupSizeY, workgroupSizeZ, isHwLocalInvocationId, reconfigCall);
           }
-          reconfigCall->replaceAllUsesWith(localInvocationId);
-          reconfigCall->eraseFromParent();
         }
-      }
-
-      if (func.isDeclaration() && func.getName().starts_with(lgcName::SwizzleWorkgroupId)) {
-        createSwizzleThreadGroupFunction();
+        reconfigCall->replaceAllUsesWith(localInvocationId);
+        reconfigCall->eraseFromParent();
       }
     }
+
+    SmallVector<Function *, 1> swizzleDecls;
+    m_callSiteIndex->getDeclarations(lgcName::SwizzleWorkgroupId, swizzleDecls);
+    if (!swizzleDecls.empty())
+      createSwizzleThreadGroupFunction();
   }
 }
 
@@ -2071,8 +2071,20 @@ void PatchInOutImportExport::patchMeshGenericOutputExport(Value *output, unsigne
                                                           Value *compIdx, Value *vertexOrPrimitiveIdx,
                                                           bool isPerPrimitive, BuilderBase &builder) {
   // outputOffset = (location + locOffset) * 4 + compIdx * (bitWidth == 64 ? 2 : 1)
-  Value *outputOffset = builder.CreateAdd(builder.getInt32(location), locOffset);
-  outputOffset = builder.CreateShl(outputOffset, 2);
+  //
+  // NOTE: If the outputs are compacted in LDS (see PatchResourceCollect::compactMeshOutputs), the location offset is
+  // always constant and the offset of the location is looked up.
+  const auto &meshInOutUsage = m_pipelineState->getShaderResourceUsage(ShaderStage::Mesh)->inOutUsage.mesh;
+  const auto &locOffsets =
+      isPerPrimitive ? meshInOutUsage.primitiveOutputLocOffsets : meshInOutUsage.vertexOutputLocOffsets;
+  Value *outputOffset = nullptr;
+  if (!locOffsets.empty()) {
+    const unsigned mappedLoc = location + cast<ConstantInt>(locOffset)->getZExtValue();
+    outputOffset = builder.getInt32(meshInOutUsage.getOutputLdsOffset(isPerPrimitive, mappedLoc));
+  } else {
+    outputOffset = builder.CreateAdd(builder.getInt32(location), locOffset);
+    outputOffset = builder.CreateShl(outputOffset, 2);
+  }
 
   auto outputTy = output->getType();
   if (outputTy->getScalarSizeInBits() == 64) {
@@ -3414,10 +3426,10 @@ void PatchInOutImportExport::patchMeshBuiltInOutputExport(Value *output, unsigne
 
   (void(builtInUsage)); // Unused
 
-  // outputOffset = location * 4 + elemIdx
-  Value *outputOffset = builder.getInt32(4 * loc);
+  // outputOffset = locationOffset + elemIdx
+  Value *outputOffset = builder.getInt32(resUsage->inOutUsage.mesh.getOutputLdsOffset(isPerPrimitive, loc));
   if (elemIdx)
-    outputOffset = builder.CreateAdd(builder.getInt32(4 * loc), elemIdx);
+    outputOffset = builder.CreateAdd(outputOffset, elemIdx);
 
   if (isPerPrimitive)
     builder.create<WriteMeshPrimitiveOutputOp>(outputOffset, vertexOrPrimitiveIdx, output);
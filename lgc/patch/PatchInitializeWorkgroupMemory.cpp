@@ -36,6 +36,7 @@
 #include "lgc/util/BuilderBase.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/Support/CommandLine.h"
+#include <algorithm>
 
 #define DEBUG_TYPE "lgc-patch-initialize-workgroup-memory"
 
@@ -83,12 +84,22 @@ PreservedAnalyses PatchInitializeWorkgroupMemory::run(Module &module, ModuleAnal
   BuilderBase builder(*m_context);
   builder.SetInsertPointPastAllocas(m_entryPoint);
 
+  // Variables that are completely overwritten before they are accessed otherwise do not need to be cleared. Place them
+  // after the ones that do, so that the cleared part of the LDS is contiguous.
+  SmallPtrSet<GlobalVariable *, 4> overwrittenGlobals;
+  collectOverwrittenGlobals(workgroupGlobals, overwrittenGlobals);
+  std::stable_partition(workgroupGlobals.begin(), workgroupGlobals.end(),
+                        [&](GlobalVariable *global) { return !overwrittenGlobals.contains(global); });
+
   // Fill the map of each variable with zeroinitializer and calculate its corresponding offset on LDS
   unsigned offset = 0;
+  unsigned clearSize = 0;
   for (auto global : workgroupGlobals) {
     unsigned varSize = getTypeSizeInDwords(global->getValueType());
     m_globalLdsOffsetMap.insert({global, builder.getInt32(offset)});
     offset += varSize;
+    if (!overwrittenGlobals.contains(global))
+      clearSize = offset;
   }
 
   // The new LDS is an i32 array
@@ -110,25 +121,72 @@ PreservedAnalyses PatchInitializeWorkgroupMemory::run(Module &module, ModuleAnal
     global->eraseFromParent();
   }
 
-  initializeWithZero(lds, builder);
+  if (clearSize != 0)
+    initializeWithZero(lds, clearSize, builder);
 
   return PreservedAnalyses::none();
 }
 
+// =====================================================================================================================
+// Find the workgroup variables whose first access in the entry-point is an unconditional store of the whole variable.
+// Such a store is executed by every invocation before it can observe the variable, so the zero initialization of the
+// variable is dead. The scan covers the entry block up to the first call that may access memory, as the callee may
+// access the variables.
+//
+// @param workgroupGlobals : The workgroup variables to be initialized
+// @param [out] overwrittenGlobals : The variables that do not need to be initialized
+void PatchInitializeWorkgroupMemory::collectOverwrittenGlobals(ArrayRef<GlobalVariable *> workgroupGlobals,
+                                                               SmallPtrSetImpl<GlobalVariable *> &overwrittenGlobals) {
+  const DataLayout &dataLayout = m_module->getDataLayout();
+  SmallPtrSet<GlobalVariable *, 4> pendingGlobals(workgroupGlobals.begin(), workgroupGlobals.end());
+  for (Instruction &inst : m_entryPoint->getEntryBlock()) {
+    if (pendingGlobals.empty())
+      break;
+    if (auto *call = dyn_cast<CallBase>(&inst)) {
+      if (!call->doesNotAccessMemory())
+        break;
+    }
+
+    if (auto *store = dyn_cast<StoreInst>(&inst)) {
+      auto *global = dyn_cast<GlobalVariable>(store->getPointerOperand()->stripPointerCasts());
+      if (global && store->isSimple() && pendingGlobals.contains(global) &&
+          dataLayout.getTypeStoreSize(store->getValueOperand()->getType()) >=
+              dataLayout.getTypeAllocSize(global->getValueType())) {
+        pendingGlobals.erase(global);
+        overwrittenGlobals.insert(global);
+        continue;
+      }
+    }
+
+    // Any other use of a variable, directly or in a constant expression, is an access that may observe the zero.
+    for (Value *operand : inst.operands()) {
+      SmallVector<Value *, 4> worklist{operand};
+      while (!worklist.empty()) {
+        Value *value = worklist.pop_back_val();
+        if (auto *global = dyn_cast<GlobalVariable>(value))
+          pendingGlobals.erase(global);
+        else if (auto *constExpr = dyn_cast<ConstantExpr>(value))
+          worklist.append(constExpr->op_begin(), constExpr->op_end());
+      }
+    }
+  }
+}
+
 // =====================================================================================================================
 // Initialize the given LDS variable with zero.
 //
 // @param lds : The LDS variable to be initialized
+// @param clearSize : Number of dwords at the start of the LDS variable to be initialized, a multiple of 4
 // @param builder : BuilderBase to use for instruction constructing
-void PatchInitializeWorkgroupMemory::initializeWithZero(GlobalVariable *lds, BuilderBase &builder) {
+void PatchInitializeWorkgroupMemory::initializeWithZero(GlobalVariable *lds, unsigned clearSize,
+                                                        BuilderBase &builder) {
   auto entryInsertPos = &*m_entryPoint->front().getFirstNonPHIOrDbgOrAlloca();
   auto originBlock = entryInsertPos->getParent();
   auto endInitBlock = originBlock->splitBasicBlock(entryInsertPos);
   endInitBlock->setName(".endInit");
 
   auto initBlock = BasicBlock::Create(*m_context, ".init", originBlock->getParent(), endInitBlock);
-  auto bodyBlock = BasicBlock::Create(*m_context, ".body", originBlock->getParent(), initBlock);
-  auto forHeaderBlock = BasicBlock::Create(*m_context, ".for.header", originBlock->getParent(), bodyBlock);
+  auto forHeaderBlock = BasicBlock::Create(*m_context, ".for.header", originBlock->getParent(), initBlock);
 
   builder.SetInsertPoint(originBlock->getTerminator());
   // Get thread info
@@ -175,53 +233,38 @@ void PatchInitializeWorkgroupMemory::initializeWithZero(GlobalVariable *lds, Bui
   }
   originBlock->getTerminator()->replaceUsesOfWith(endInitBlock, forHeaderBlock);
 
-  // Each thread stores a zero to the continues LDS
-  // for (int loopIdx = 0; loopIdx < loopCount; ++loopIdx) {
-  //   if (threadId * loopCount + loopIdx < requiredNumThreads) {
-  //      unsigned ldsOffset = (threadId * loopCount) + loopIdx;
-  //      CreateStore(zero, ldsOffset);
-  //   }
-  //  }
-
-  PHINode *loopIdxPhi = nullptr;
-  const unsigned requiredNumThreads = lds->getValueType()->getArrayNumElements();
-  Value *loopCount = builder.getInt32((requiredNumThreads + actualNumThreads - 1) / actualNumThreads);
+  // The threads clear 16-byte chunks strided by the workgroup size, so that adjacent threads write adjacent chunks and
+  // each store can be a ds_write_b128.
+  // for (unsigned chunkIdx = threadId; chunkIdx < chunkCount; chunkIdx += actualNumThreads)
+  //   CreateStore(<4 x i32> zero, chunkIdx * 4);
+  assert(clearSize % 4 == 0);
+  const unsigned chunkCount = clearSize / 4;
+  Type *chunkTy = FixedVectorType::get(builder.getInt32Ty(), 4);
 
-  // Construct ".for.Header" block
+  // Construct ".for.header" block
+  PHINode *chunkIdxPhi = nullptr;
   {
     builder.SetInsertPoint(forHeaderBlock);
 
-    loopIdxPhi = builder.CreatePHI(builder.getInt32Ty(), 2);
-    loopIdxPhi->addIncoming(builder.getInt32(0), originBlock);
+    chunkIdxPhi = builder.CreatePHI(builder.getInt32Ty(), 2);
+    chunkIdxPhi->addIncoming(threadId, originBlock);
 
-    Value *isInLoop = builder.CreateICmpULT(loopIdxPhi, loopCount);
-    builder.CreateCondBr(isInLoop, bodyBlock, endInitBlock);
+    Value *isInLoop = builder.CreateICmpULT(chunkIdxPhi, builder.getInt32(chunkCount));
+    builder.CreateCondBr(isInLoop, initBlock, endInitBlock);
   }
 
-  // Construct ".body" block
+  // Construct ".init" block
   {
-    builder.SetInsertPoint(bodyBlock);
-    // The active thread is : threadId x loopCount + loopIdx < requiredNumThreads
-    Value *index = builder.CreateMul(threadId, loopCount);
-    index = builder.CreateAdd(index, loopIdxPhi);
-    Value *isActiveThread = builder.CreateICmpULT(index, builder.getInt32(requiredNumThreads));
-    builder.CreateCondBr(isActiveThread, initBlock, endInitBlock);
-
-    // Construct ".init" block
-    {
-      builder.SetInsertPoint(initBlock);
-      // ldsOffset = (threadId * loopCount) + loopIdx
-      Value *ldsOffset = builder.CreateMul(threadId, loopCount);
-      ldsOffset = builder.CreateAdd(ldsOffset, loopIdxPhi);
-      Value *writePtr = builder.CreateGEP(lds->getValueType(), lds, {builder.getInt32(0), ldsOffset});
-      builder.CreateAlignedStore(builder.getInt32(0), writePtr, Align(4));
-
-      // Update loop index
-      Value *loopNext = builder.CreateAdd(loopIdxPhi, builder.getInt32(1));
-      loopIdxPhi->addIncoming(loopNext, initBlock);
-
-      builder.CreateBr(forHeaderBlock);
-    }
+    builder.SetInsertPoint(initBlock);
+    Value *ldsOffset = builder.CreateMul(chunkIdxPhi, builder.getInt32(4));
+    Value *writePtr = builder.CreateGEP(lds->getValueType(), lds, {builder.getInt32(0), ldsOffset});
+    builder.CreateAlignedStore(Constant::getNullValue(chunkTy), writePtr, Align(16));
+
+    // Update loop index
+    Value *chunkIdxNext = builder.CreateAdd(chunkIdxPhi, builder.getInt32(actualNumThreads));
+    chunkIdxPhi->addIncoming(chunkIdxNext, initBlock);
+
+    builder.CreateBr(forHeaderBlock);
   }
   {
     // Set barrier after writing LDS
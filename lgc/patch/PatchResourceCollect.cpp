@@ -46,6 +46,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include <algorithm>
 #include <set>
 
@@ -993,6 +994,9 @@ bool PatchResourceCollect::checkGsOnChipValidity() {
 void PatchResourceCollect::processShader() {
   m_resUsage = m_pipelineState->getShaderResourceUsage(m_shaderStage);
 
+  // Drop outputs the next stage does not consume before collecting inputs, so that inputs only feeding them die too
+  clearDeadOutputExports();
+
   // Invoke handling of "call" instruction
   visit(m_entryPoint);
 
@@ -1048,6 +1052,11 @@ void PatchResourceCollect::processShader() {
     call->eraseFromParent();
   }
   m_deadCalls.clear();
+
+  // NOTE: Mesh outputs are compacted once, for the entry-point. The outputs written by non-entry-point functions of the
+  // mesh shader are collected there too.
+  if (m_shaderStage == ShaderStage::Mesh && m_entryPoint == m_pipelineShaders->getEntryPoint(ShaderStage::Mesh))
+    compactMeshOutputs();
 }
 
 // =====================================================================================================================
@@ -2595,6 +2604,152 @@ void PatchResourceCollect::mapGsBuiltInOutput(unsigned builtInId, unsigned elemC
   resUsage->inOutUsage.outputMapLocCount = std::max(resUsage->inOutUsage.outputMapLocCount, assignedLocCount);
 }
 
+// =====================================================================================================================
+// Compact the LDS layout of per-vertex and per-primitive outputs of mesh shader. The outputs are staged in LDS before
+// they are exported, and each mapped location would otherwise reserve 4 dwords for every vertex or primitive no matter
+// how many components are actually written. Here, the dword count of each location is collected from the generic
+// output exports and the built-in usage, and the locations are then laid out back to back. The fixed layout is kept
+// for outputs written with dynamic location offsets.
+void PatchResourceCollect::compactMeshOutputs() {
+  assert(m_shaderStage == ShaderStage::Mesh);
+  auto &inOutUsage = m_resUsage->inOutUsage;
+  const auto &builtInUsage = m_resUsage->builtInUsage.mesh;
+
+  inOutUsage.mesh.vertexOutputLocOffsets.clear();
+  inOutUsage.mesh.primitiveOutputLocOffsets.clear();
+
+  SmallVector<unsigned, 32> vertexLocDwords(inOutUsage.outputMapLocCount, 0);
+  SmallVector<unsigned, 32> primitiveLocDwords(inOutUsage.perPrimitiveOutputMapLocCount, 0);
+  bool compactVertexOutputs = true;
+  bool compactPrimitiveOutputs = true;
+
+  // Record the written dwords [startDword, startDword + dwordCount) relative to the specified location. The write may
+  // run into following locations (e.g. 64-bit vectors), which must then be fully occupied to keep the dwords
+  // contiguous.
+  auto addWrite = [](SmallVectorImpl<unsigned> &locDwords, unsigned location, unsigned startDword,
+                     unsigned dwordCount) {
+    unsigned endDword = startDword + dwordCount;
+    for (; endDword > 4; endDword -= 4) {
+      if (location >= locDwords.size())
+        return false;
+      locDwords[location++] = 4;
+    }
+    if (location >= locDwords.size())
+      return false;
+    locDwords[location] = std::max(locDwords[location], endDword);
+    return true;
+  };
+
+  // Collect generic outputs
+  for (Function &func : *m_entryPoint->getParent()) {
+    if (!func.getName().starts_with(lgcName::OutputExportGeneric))
+      continue;
+
+    for (User *user : func.users()) {
+      auto call = cast<CallInst>(user);
+      if (m_pipelineShaders->getShaderStage(call->getFunction()) != ShaderStage::Mesh)
+        continue;
+
+      const unsigned origLoc = cast<ConstantInt>(call->getOperand(0))->getZExtValue();
+      const bool isPerPrimitive = cast<ConstantInt>(call->getOperand(4))->getZExtValue() != 0;
+      auto &locDwords = isPerPrimitive ? primitiveLocDwords : vertexLocDwords;
+      bool &compactOutputs = isPerPrimitive ? compactPrimitiveOutputs : compactVertexOutputs;
+
+      // Find the mapped location in the same way as PatchInOutImportExport
+      unsigned location = InvalidValue;
+      if (isPerPrimitive) {
+        auto locMapIt = inOutUsage.perPrimitiveOutputLocMap.find(origLoc);
+        if (locMapIt != inOutUsage.perPrimitiveOutputLocMap.end())
+          location = locMapIt->second;
+      } else {
+        InOutLocationInfo origLocInfo;
+        origLocInfo.setLocation(origLoc);
+        auto locInfoMapIt = inOutUsage.outputLocInfoMap.find(origLocInfo);
+        if (locInfoMapIt == inOutUsage.outputLocInfoMap.end() && isa<ConstantInt>(call->getOperand(2))) {
+          origLocInfo.setComponent(cast<ConstantInt>(call->getOperand(2))->getZExtValue());
+          locInfoMapIt = inOutUsage.outputLocInfoMap.find(origLocInfo);
+        }
+        if (locInfoMapIt != inOutUsage.outputLocInfoMap.end())
+          location = locInfoMapIt->second.getLocation();
+      }
+      if (location == InvalidValue)
+        continue; // Unused output, never written to LDS
+
+      auto locOffset = dyn_cast<ConstantInt>(call->getOperand(1));
+      if (!locOffset) {
+        compactOutputs = false;
+        continue;
+      }
+      location += locOffset->getZExtValue();
+
+      // NOTE: 8-bit and 16-bit components are extended to dwords in LDS.
+      Type *outputTy = call->getOperand(5)->getType();
+      const unsigned dwordsPerComp = outputTy->getScalarSizeInBits() == 64 ? 2 : 1;
+      const unsigned compCount = outputTy->isVectorTy() ? cast<FixedVectorType>(outputTy)->getNumElements() : 1;
+
+      bool written = false;
+      if (auto elemIdx = dyn_cast<ConstantInt>(call->getOperand(2)))
+        written = addWrite(locDwords, location, elemIdx->getZExtValue() * dwordsPerComp, compCount * dwordsPerComp);
+      else
+        written = addWrite(locDwords, location, 0, 4 * dwordsPerComp); // Dynamic component indexing
+      if (!written)
+        compactOutputs = false;
+    }
+  }
+
+  // Collect built-in outputs mapped to generic ones
+  auto addBuiltIn = [&](const std::map<unsigned, unsigned> &builtInLocMap, SmallVectorImpl<unsigned> &locDwords,
+                        unsigned builtInId, unsigned dwordCount, bool &compactOutputs) {
+    auto locMapIt = builtInLocMap.find(builtInId);
+    if (locMapIt != builtInLocMap.end() && !addWrite(locDwords, locMapIt->second, 0, dwordCount))
+      compactOutputs = false;
+  };
+
+  if (builtInUsage.position)
+    addBuiltIn(inOutUsage.builtInOutputLocMap, vertexLocDwords, BuiltInPosition, 4, compactVertexOutputs);
+  if (builtInUsage.pointSize)
+    addBuiltIn(inOutUsage.builtInOutputLocMap, vertexLocDwords, BuiltInPointSize, 1, compactVertexOutputs);
+  if (builtInUsage.clipDistance > 0) {
+    addBuiltIn(inOutUsage.builtInOutputLocMap, vertexLocDwords, BuiltInClipDistance, builtInUsage.clipDistance,
+               compactVertexOutputs);
+  }
+  if (builtInUsage.cullDistance > 0) {
+    addBuiltIn(inOutUsage.builtInOutputLocMap, vertexLocDwords, BuiltInCullDistance, builtInUsage.cullDistance,
+               compactVertexOutputs);
+  }
+
+  for (unsigned builtInId : {BuiltInPrimitiveId, BuiltInViewportIndex, BuiltInLayer, BuiltInPrimitiveShadingRate})
+    addBuiltIn(inOutUsage.perPrimitiveBuiltInOutputLocMap, primitiveLocDwords, builtInId, 1, compactPrimitiveOutputs);
+
+  // Lay out the locations back to back, only if this actually saves LDS space
+  auto buildLocOffsets = [](ArrayRef<unsigned> locDwords, std::vector<unsigned> &locOffsets) {
+    unsigned offset = 0;
+    for (unsigned dwordCount : locDwords) {
+      locOffsets.push_back(offset);
+      offset += dwordCount;
+    }
+    locOffsets.push_back(offset); // Stride
+
+    if (offset == 4 * locDwords.size())
+      locOffsets.clear();
+  };
+
+  if (compactVertexOutputs)
+    buildLocOffsets(vertexLocDwords, inOutUsage.mesh.vertexOutputLocOffsets);
+  if (compactPrimitiveOutputs)
+    buildLocOffsets(primitiveLocDwords, inOutUsage.mesh.primitiveOutputLocOffsets);
+
+  // This follows the location count results of the mesh shader
+  LLPC_OUTS("// LLPC output LDS stride results (in dwords)\n\n");
+  LLPC_OUTS("(" << getShaderStageAbbreviation(m_shaderStage) << ") Output: stride = "
+                << inOutUsage.mesh.getOutputLdsOffset(false, inOutUsage.outputMapLocCount)
+                << "  (fixed layout = " << 4 * inOutUsage.outputMapLocCount << ")\n");
+  LLPC_OUTS("(" << getShaderStageAbbreviation(m_shaderStage) << ") Output (per-primitive): stride = "
+                << inOutUsage.mesh.getOutputLdsOffset(true, inOutUsage.perPrimitiveOutputMapLocCount)
+                << "  (fixed layout = " << 4 * inOutUsage.perPrimitiveOutputMapLocCount << ")\n");
+  LLPC_OUTS("\n");
+}
+
 // =====================================================================================================================
 // Update the inputLocInfoutputoMap, perPatchInputLocMap and perPrimitiveInputLocMap
 void PatchResourceCollect::updateInputLocInfoMapWithUnpack() {
@@ -2880,6 +3035,103 @@ void PatchResourceCollect::clearUnusedOutput() {
   }
 }
 
+// =====================================================================================================================
+// Remove generic output exports of the current shader that the next stage does not consume, together with the
+// computations that only feed them.
+//
+// Shaders are processed in reverse pipeline order, so the input maps of the next stage are final by now. Removing the
+// dead exports before the inputs of this shader are collected lets inputs that only fed them be dropped as well, which
+// in turn makes the matching outputs of the previous stage dead. A single reverse walk over VS->TCS->TES->GS->FS thus
+// reaches the fixpoint of the cross-stage output liveness.
+//
+// NOTE: TCS outputs can be read back and dynamically indexed, TES inputs are all kept, and mesh outputs are never
+// packed with FS inputs, so TCS and mesh shader outputs are left to clearUnusedOutput(). Built-in outputs have side
+// effects beyond the next stage and are never removed here.
+void PatchResourceCollect::clearDeadOutputExports() {
+  if (!m_pipelineState->isGraphics() || m_pipelineState->isUnlinked())
+    return;
+  if (m_shaderStage != ShaderStage::Vertex && m_shaderStage != ShaderStage::TessEval &&
+      m_shaderStage != ShaderStage::Geometry)
+    return;
+
+  const ShaderStageEnum nextStage = m_pipelineState->getNextShaderStage(m_shaderStage);
+  if (nextStage == ShaderStage::Invalid || !m_pipelineShaders->getEntryPoint(nextStage))
+    return;
+
+  const auto &inOutUsage = m_resUsage->inOutUsage;
+  const auto &nextInLocInfoMap = m_pipelineState->getShaderResourceUsage(nextStage)->inOutUsage.inputLocInfoMap;
+  const bool packOutput = m_pipelineState->canPackOutput(m_shaderStage);
+  const unsigned rasterStream = m_pipelineState->getRasterizerState().rasterStream;
+
+  DenseSet<unsigned> nextInLocs;
+  for (const auto &locInfoPair : nextInLocInfoMap)
+    nextInLocs.insert(locInfoPair.first.getLocation());
+
+  // Outputs captured by transform feedback stay alive whether or not the next stage reads them
+  DenseSet<unsigned> xfbOutLocs;
+  for (const auto &locInfoPair : inOutUsage.locInfoXfbOutInfoMap)
+    xfbOutLocs.insert(locInfoPair.first.getLocation());
+
+  SmallVector<CallInst *, 8> deadCalls;
+  for (Function &func : *m_module) {
+    if (!func.isDeclaration() || !func.getName().starts_with(lgcName::OutputExportGeneric))
+      continue;
+
+    for (User *user : func.users()) {
+      auto call = dyn_cast<CallInst>(user);
+      if (!call || call->getFunction() != m_entryPoint)
+        continue;
+
+      const unsigned loc = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue();
+      if (xfbOutLocs.count(loc) > 0)
+        continue;
+
+      if (m_shaderStage == ShaderStage::Geometry) {
+        // Only outputs of the rasterization stream are read by FS
+        unsigned streamId = cast<ConstantInt>(call->getArgOperand(2))->getZExtValue();
+        if (streamId == InvalidValue)
+          streamId = 0;
+        if (streamId != rasterStream)
+          continue;
+      }
+
+      bool isActive = false;
+      if (packOutput) {
+        // Packed outputs are scalarized, so match the exact location and component like
+        // updateOutputLocInfoMapWithPack() does
+        auto elemIdx = dyn_cast<ConstantInt>(call->getArgOperand(1));
+        if (!elemIdx)
+          continue;
+        InOutLocationInfo origLocInfo;
+        origLocInfo.setLocation(loc);
+        origLocInfo.setComponent(elemIdx->getZExtValue());
+        isActive = nextInLocInfoMap.count(origLocInfo) > 0;
+      } else {
+        Type *outputTy = call->getArgOperand(call->arg_size() - 1)->getType();
+        const unsigned locCount = (outputTy->getPrimitiveSizeInBits() + 127U) / 128U;
+        for (unsigned i = 0; i < locCount; ++i)
+          isActive |= nextInLocs.count(loc + i) > 0;
+      }
+
+      if (!isActive)
+        deadCalls.push_back(call);
+    }
+  }
+
+  if (deadCalls.empty())
+    return;
+
+  LLPC_OUTS("// LLPC dead output elimination results (" << getShaderStageAbbreviation(m_shaderStage)
+                                                         << "): removed " << deadCalls.size() << " output exports\n\n");
+
+  SmallVector<WeakTrackingVH, 8> deadValues;
+  for (CallInst *call : deadCalls) {
+    deadValues.push_back(call->getArgOperand(call->arg_size() - 1));
+    call->eraseFromParent();
+  }
+  RecursivelyDeleteTriviallyDeadInstructionsPermissive(deadValues);
+}
+
 // =====================================================================================================================
 // Update the outputLocInfoMap, perPatchOutputLocMap, and perPrimitiveOutputLocMap
 void PatchResourceCollect::updateOutputLocInfoMapWithUnpack() {
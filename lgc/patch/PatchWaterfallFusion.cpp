@@ -0,0 +1,376 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchWaterfallFusion.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PatchWaterfallFusion.
+ ***********************************************************************************************************************
+ */
+#include "lgc/patch/PatchWaterfallFusion.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <optional>
+
+#define DEBUG_TYPE "lgc-patch-waterfall-fusion"
+
+using namespace llvm;
+using namespace lgc;
+
+// -fuse-waterfall-loops: fuse adjacent waterfall loops on the same non-uniform index
+static cl::opt<bool> FuseWaterfallLoops("fuse-waterfall-loops",
+                                        cl::desc("Fuse adjacent waterfall loops on the same non-uniform index"),
+                                        cl::init(true));
+
+#if defined(LLVM_HAVE_BRANCH_AMD_GFX)
+namespace {
+
+// A waterfall loop as created by BuilderImpl::createWaterfallLoop: a chain of llvm.amdgcn.waterfall.begin calls, one
+// per non-uniform index, then the readfirstlane, last.use and end calls on the final token. The loop spans from the
+// first begin to the last user of the token, or to the operation that consumes a last.use. The part from the first
+// end onwards is the tail, which only merges the per-lane results.
+struct WaterfallLoop {
+  SmallVector<CallInst *, 2> begins;
+  Instruction *firstEnd = nullptr;
+  Instruction *last = nullptr;
+};
+
+} // anonymous namespace
+
+// =====================================================================================================================
+// Checks whether the instruction is one of the llvm.amdgcn.waterfall intrinsics.
+//
+// @param inst : Instruction to check
+static bool isWaterfallIntrinsic(const Instruction *inst) {
+  auto call = dyn_cast<CallInst>(inst);
+  if (!call || !call->getCalledFunction())
+    return false;
+  return call->getCalledFunction()->getName().starts_with("llvm.amdgcn.waterfall.");
+}
+
+// =====================================================================================================================
+// Checks whether the instruction is an llvm.amdgcn.waterfall.last.use intrinsic, in any of its variants.
+//
+// @param inst : Instruction to check
+static bool isWaterfallLastUse(const Instruction *inst) {
+  return isWaterfallIntrinsic(inst) &&
+         cast<CallInst>(inst)->getCalledFunction()->getName().starts_with("llvm.amdgcn.waterfall.last.use");
+}
+
+// =====================================================================================================================
+// Checks whether the instruction is a call to the given intrinsic.
+//
+// @param inst : Instruction to check
+// @param id : Intrinsic ID
+static bool isIntrinsic(const Instruction *inst, Intrinsic::ID id) {
+  auto intrinsic = dyn_cast<IntrinsicInst>(inst);
+  return intrinsic && intrinsic->getIntrinsicID() == id;
+}
+
+// =====================================================================================================================
+// Gets the waterfall loop that starts at the given instruction, if it is the first begin of a loop that can take part
+// in fusion.
+//
+// @param inst : Instruction that may start a waterfall loop
+static std::optional<WaterfallLoop> getWaterfallLoop(Instruction *inst) {
+  if (!isIntrinsic(inst, Intrinsic::amdgcn_waterfall_begin) || !isa<Constant>(inst->getOperand(0)))
+    return std::nullopt;
+
+  BasicBlock *block = inst->getParent();
+  WaterfallLoop loop;
+  loop.begins.push_back(cast<CallInst>(inst));
+  for (;;) {
+    CallInst *token = loop.begins.back();
+    CallInst *nextBegin = nullptr;
+    for (User *user : token->users()) {
+      auto userInst = cast<Instruction>(user);
+      if (isIntrinsic(userInst, Intrinsic::amdgcn_waterfall_begin))
+        nextBegin = cast<CallInst>(userInst);
+    }
+    if (!nextBegin)
+      break;
+    if (!token->hasOneUse() || nextBegin->getParent() != block)
+      return std::nullopt;
+    loop.begins.push_back(nextBegin);
+  }
+
+  CallInst *token = loop.begins.back();
+  auto extendTo = [&loop](Instruction *userInst) {
+    if (!loop.last || loop.last->comesBefore(userInst))
+      loop.last = userInst;
+  };
+  for (User *user : token->users()) {
+    auto userInst = cast<Instruction>(user);
+    if (userInst->getParent() != block)
+      return std::nullopt;
+    extendTo(userInst);
+    if (isIntrinsic(userInst, Intrinsic::amdgcn_waterfall_end) &&
+        (!loop.firstEnd || userInst->comesBefore(loop.firstEnd)))
+      loop.firstEnd = userInst;
+    if (isWaterfallLastUse(userInst)) {
+      // The operation that takes the last-used descriptor is inside the loop.
+      for (User *lastUseUser : userInst->users()) {
+        auto lastUseUserInst = cast<Instruction>(lastUseUser);
+        if (lastUseUserInst->getParent() != block)
+          return std::nullopt;
+        extendTo(lastUseUserInst);
+      }
+    }
+  }
+  if (!loop.last)
+    return std::nullopt;
+
+  // Give up on loops that overlap another waterfall loop, and on tails that do more than merge the results.
+  bool inTail = false;
+  for (Instruction *spanInst = inst->getNextNode(); spanInst != loop.last->getNextNode();
+       spanInst = spanInst->getNextNode()) {
+    inTail |= spanInst == loop.firstEnd;
+    if (isWaterfallIntrinsic(spanInst)) {
+      Value *spanToken = spanInst->getOperand(0);
+      if (spanToken != token && !is_contained(loop.begins, spanToken))
+        return std::nullopt;
+    } else if (inTail && (spanInst->mayReadOrWriteMemory() || spanInst->mayHaveSideEffects())) {
+      return std::nullopt;
+    }
+  }
+  return loop;
+}
+
+// =====================================================================================================================
+// Checks whether two waterfall loops are keyed on the same non-uniform indices.
+//
+// @param lhs : First loop
+// @param rhs : Second loop
+static bool haveSameIndices(const WaterfallLoop &lhs, const WaterfallLoop &rhs) {
+  if (lhs.begins.size() != rhs.begins.size())
+    return false;
+  for (unsigned idx = 0; idx != lhs.begins.size(); ++idx) {
+    Value *lhsIndex = lhs.begins[idx]->getArgOperand(1);
+    Value *rhsIndex = rhs.begins[idx]->getArgOperand(1);
+    if (lhsIndex == rhsIndex)
+      continue;
+    // Separately computed copies of the same index, such as the truncation of a 64-bit index, also match.
+    auto lhsInst = dyn_cast<Instruction>(lhsIndex);
+    auto rhsInst = dyn_cast<Instruction>(rhsIndex);
+    if (!lhsInst || !rhsInst || !lhsInst->isIdenticalTo(rhsInst) || lhsInst->mayReadOrWriteMemory() ||
+        lhsInst->mayHaveSideEffects())
+      return false;
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Checks whether an instruction between two waterfall loops can be moved above the first loop.
+//
+// @param inst : Instruction to check
+static bool canHoistAboveLoop(const Instruction *inst) {
+  if (isa<PHINode>(inst) || inst->mayReadOrWriteMemory() || inst->mayHaveSideEffects())
+    return false;
+  if (auto call = dyn_cast<CallInst>(inst))
+    return !call->isConvergent();
+  return true;
+}
+
+// =====================================================================================================================
+// Tries to fuse a waterfall loop into an earlier one in the same block with the same indices. The second loop's body
+// moves to the end of the first loop's body, its tail to the end of the first loop's tail, and the instructions in
+// between that it depends on move above the first loop. That is only done for loops that do not write memory, and
+// when neither a true dependency on the first loop's results nor a write in between gets in the way.
+//
+// @param [in/out] group : The earlier loop, updated to the fused loop on success
+// @param loop : The later loop
+// @returns : True if the loops were fused
+static bool fuseWaterfallLoops(WaterfallLoop &group, const WaterfallLoop &loop) {
+  Instruction *groupHead = group.begins.front();
+  Instruction *loopHead = loop.begins.front();
+
+  SmallVector<Instruction *, 8> gap;
+  for (Instruction *inst = group.last->getNextNode(); inst != loopHead; inst = inst->getNextNode())
+    gap.push_back(inst);
+
+  SmallVector<Instruction *, 8> body;
+  SmallVector<Instruction *, 8> tail;
+  bool inTail = false;
+  bool loopReadsMemory = false;
+  bool loopWritesMemory = false;
+  for (Instruction *inst = loopHead->getNextNode(); inst != loop.last->getNextNode(); inst = inst->getNextNode()) {
+    if (is_contained(loop.begins, inst))
+      continue;
+    inTail |= inst == loop.firstEnd;
+    (inTail ? tail : body).push_back(inst);
+    if (!isWaterfallIntrinsic(inst)) {
+      loopReadsMemory |= inst->mayReadFromMemory();
+      loopWritesMemory |= inst->mayWriteToMemory() || inst->mayHaveSideEffects();
+    }
+  }
+
+  // Fusion interleaves the two loops per index value, which reorders memory accesses between lanes with different
+  // indices. Only do that when neither loop writes memory.
+  bool groupWritesMemory = false;
+  for (Instruction *inst = groupHead; inst != group.last->getNextNode(); inst = inst->getNextNode()) {
+    if (!isWaterfallIntrinsic(inst))
+      groupWritesMemory |= inst->mayWriteToMemory() || inst->mayHaveSideEffects();
+  }
+  if (groupWritesMemory || loopWritesMemory)
+    return false;
+
+  // The body of the later loop goes before the tail of the group, so it cannot use the group's results.
+  auto isInGroupTail = [&group](Value *value) {
+    auto inst = dyn_cast<Instruction>(value);
+    return group.firstEnd && inst && inst->getParent() == group.firstEnd->getParent() &&
+           !inst->comesBefore(group.firstEnd) && !group.last->comesBefore(inst);
+  };
+  for (Instruction *inst : body) {
+    if (any_of(inst->operands(), isInGroupTail))
+      return false;
+  }
+
+  // Find the instructions in the gap that the later loop depends on. They must be moved above the group.
+  SmallPtrSet<Instruction *, 8> gapSet(gap.begin(), gap.end());
+  SmallPtrSet<Instruction *, 8> hoisted;
+  SmallVector<Instruction *, 8> worklist;
+  auto addGapOperands = [&](Instruction *inst) {
+    for (Value *operand : inst->operands()) {
+      auto operandInst = dyn_cast<Instruction>(operand);
+      if (operandInst && gapSet.count(operandInst) && hoisted.insert(operandInst).second)
+        worklist.push_back(operandInst);
+    }
+  };
+  for (Instruction *inst : body)
+    addGapOperands(inst);
+  for (Instruction *inst : tail)
+    addGapOperands(inst);
+  while (!worklist.empty()) {
+    Instruction *inst = worklist.pop_back_val();
+    if (!canHoistAboveLoop(inst))
+      return false;
+    for (Value *operand : inst->operands()) {
+      auto operandInst = dyn_cast<Instruction>(operand);
+      if (operandInst && operandInst->getParent() == groupHead->getParent() && !gapSet.count(operandInst) &&
+          !operandInst->comesBefore(groupHead))
+        return false;
+    }
+    addGapOperands(inst);
+  }
+
+  // The later loop moves up across the rest of the gap.
+  for (Instruction *inst : gap) {
+    if (hoisted.count(inst))
+      continue;
+    if (isWaterfallIntrinsic(inst))
+      return false;
+    if (auto call = dyn_cast<CallInst>(inst)) {
+      if (call->isConvergent())
+        return false;
+    }
+    if (loopReadsMemory && (inst->mayWriteToMemory() || inst->mayHaveSideEffects()))
+      return false;
+  }
+
+  LLVM_DEBUG(dbgs() << "Fusing waterfall loop " << *loopHead << " into " << *groupHead << "\n");
+
+  for (Instruction *inst : gap) {
+    if (hoisted.count(inst))
+      inst->moveBefore(groupHead);
+  }
+
+  Instruction *last = group.last;
+  if (group.firstEnd) {
+    for (Instruction *inst : body)
+      inst->moveBefore(group.firstEnd);
+  } else {
+    for (Instruction *inst : body) {
+      inst->moveAfter(last);
+      last = inst;
+    }
+    group.firstEnd = loop.firstEnd;
+  }
+  for (Instruction *inst : tail) {
+    inst->moveAfter(last);
+    last = inst;
+  }
+  group.last = last;
+
+  SmallVector<Value *, 2> loopIndices;
+  loop.begins.back()->replaceAllUsesWith(group.begins.back());
+  for (CallInst *begin : reverse(loop.begins)) {
+    loopIndices.push_back(begin->getArgOperand(1));
+    begin->eraseFromParent();
+  }
+  for (Value *index : loopIndices)
+    RecursivelyDeleteTriviallyDeadInstructions(index);
+  return true;
+}
+#endif
+
+namespace lgc {
+
+// =====================================================================================================================
+// Executes this LLVM pass on the specified LLVM function.
+//
+// @param [in/out] function : Function that we will patch.
+// @param [in/out] analysisManager : Analysis manager to use for this transformation
+// @returns : The preserved analyses (The analyses that are still valid after this pass)
+PreservedAnalyses PatchWaterfallFusion::run(Function &function, FunctionAnalysisManager &analysisManager) {
+#if !defined(LLVM_HAVE_BRANCH_AMD_GFX)
+  return PreservedAnalyses::all();
+#else
+  if (!FuseWaterfallLoops)
+    return PreservedAnalyses::all();
+
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Waterfall-Fusion\n");
+
+  unsigned fusedCount = 0;
+  for (BasicBlock &block : function) {
+    std::optional<WaterfallLoop> group;
+    for (Instruction *inst = &block.front(); inst;) {
+      std::optional<WaterfallLoop> loop = getWaterfallLoop(inst);
+      if (!loop) {
+        inst = inst->getNextNode();
+        continue;
+      }
+      // The instruction after the loop does not move, so it is where scanning continues.
+      inst = loop->last->getNextNode();
+      if (group && haveSameIndices(*group, *loop) && fuseWaterfallLoops(*group, *loop))
+        ++fusedCount;
+      else
+        group = std::move(loop);
+    }
+  }
+
+  LLVM_DEBUG(dbgs() << "Fused " << fusedCount << " waterfall loops\n");
+  if (fusedCount == 0)
+    return PreservedAnalyses::all();
+
+  PreservedAnalyses preserved;
+  preserved.preserveSet<CFGAnalyses>();
+  return preserved;
+#endif
+}
+
+} // namespace lgc
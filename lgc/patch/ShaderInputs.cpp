@@ -30,6 +30,7 @@
  ***********************************************************************************************************************
  */
 #include "lgc/patch/ShaderInputs.h"
+#include "lgc/state/CallSiteIndex.h"
 #include "lgc/state/PalMetadata.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/ResourceUsage.h"
@@ -308,19 +309,16 @@ const char *ShaderInputs::getInputName(ShaderInput inputKind) {
 // =====================================================================================================================
 // Gather usage of shader inputs from before PatchEntryPointMutate
 //
-// @param module : IR module
-void ShaderInputs::gatherUsage(Module &module) {
-  for (auto &func : module) {
-    if (!func.isDeclaration() || !func.getName().starts_with(lgcName::ShaderInput))
-      continue;
-    for (User *user : func.users()) {
-      CallInst *call = cast<CallInst>(user);
-      auto stage = getShaderStage(call->getFunction());
-      assert(stage != ShaderStage::CopyShader);
-      getShaderInputUsage(stage.value(),
-                          static_cast<ShaderInput>(cast<ConstantInt>(call->getArgOperand(0))->getZExtValue()))
-          ->users.push_back(call);
-    }
+// @param callSiteIndex : Index of lgc.* call sites in the module
+void ShaderInputs::gatherUsage(const CallSiteIndexResult &callSiteIndex) {
+  SmallVector<CallInst *, 16> calls;
+  callSiteIndex.getCalls(lgcName::ShaderInput, calls);
+  for (CallInst *call : calls) {
+    auto stage = getShaderStage(call->getFunction());
+    assert(stage != ShaderStage::CopyShader);
+    getShaderInputUsage(stage.value(),
+                        static_cast<ShaderInput>(cast<ConstantInt>(call->getArgOperand(0))->getZExtValue()))
+        ->users.push_back(call);
   }
 }
 
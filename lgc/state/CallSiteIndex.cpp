@@ -0,0 +1,147 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  CallSiteIndex.cpp
+* @brief LLPC source file: contains implementation of class lgc::CallSiteIndex
+***********************************************************************************************************************
+*/
+#include "lgc/state/CallSiteIndex.h"
+#include "lgc/state/Defs.h"
+#include "lgc/state/ShaderStage.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include <algorithm>
+
+#define DEBUG_TYPE "lgc-call-site-index"
+
+using namespace lgc;
+using namespace llvm;
+
+// =====================================================================================================================
+AnalysisKey CallSiteIndex::Key;
+
+// =====================================================================================================================
+// Run the analysis on the specified LLVM module.
+//
+// @param [in/out] module : LLVM module to be run on
+// @param [in/out] analysisManager : Analysis manager to use for this transformation
+// @returns : Result object of the CallSiteIndex pass
+CallSiteIndexResult CallSiteIndex::run(Module &module, ModuleAnalysisManager &analysisManager) {
+  LLVM_DEBUG(dbgs() << "Run the pass Call-Site-Index\n");
+
+  CallSiteIndexResult result;
+  DenseMap<const Function *, ShaderStageEnum> callerStages;
+
+  for (Function &func : module) {
+    if (!func.isDeclaration() || !func.getName().starts_with(lgcName::InternalCallPrefix))
+      continue;
+
+    CallSiteIndexResult::Declaration &entry = result.m_declarations.emplace_back();
+    entry.name = func.getName().str();
+    entry.decl = &func;
+    entry.order = result.m_declarations.size() - 1;
+    for (User *user : func.users()) {
+      auto *call = dyn_cast<CallInst>(user);
+      if (!call || call->getCalledFunction() != &func)
+        continue;
+      const Function *caller = call->getFunction();
+      auto it = callerStages.find(caller);
+      if (it == callerStages.end())
+        it = callerStages.insert({caller, getShaderStage(caller).value_or(ShaderStage::Invalid)}).first;
+      entry.calls.push_back({it->second, call});
+    }
+    std::stable_sort(entry.calls.begin(), entry.calls.end(),
+                     [](const auto &lhs, const auto &rhs) { return lhs.stage < rhs.stage; });
+  }
+
+  std::sort(result.m_declarations.begin(), result.m_declarations.end(),
+            [](const auto &lhs, const auto &rhs) { return lhs.name < rhs.name; });
+  return result;
+}
+
+// =====================================================================================================================
+// Call the callback on each indexed declaration whose name starts with the given prefix. The declarations are visited
+// in module order, so that passes converted to use the index see calls in the same order as a scan of the module.
+//
+// @param prefix : Name prefix, normally one of the lgcName constants
+// @param callback : Callback taking a const Declaration &
+template <typename Callback>
+void CallSiteIndexResult::forEachDeclaration(StringRef prefix, Callback callback) const {
+  auto it = std::lower_bound(m_declarations.begin(), m_declarations.end(), prefix,
+                             [](const Declaration &entry, StringRef prefix) { return StringRef(entry.name) < prefix; });
+  SmallVector<const Declaration *, 8> matches;
+  for (; it != m_declarations.end() && StringRef(it->name).starts_with(prefix); ++it) {
+    if (it->decl)
+      matches.push_back(&*it);
+  }
+  llvm::sort(matches, [](const Declaration *lhs, const Declaration *rhs) { return lhs->order < rhs->order; });
+  for (const Declaration *entry : matches)
+    callback(*entry);
+}
+
+// =====================================================================================================================
+// Get the lgc.* declarations whose name starts with the given prefix.
+//
+// @param prefix : Name prefix
+// @param [out] decls : Vector to append the declarations to
+void CallSiteIndexResult::getDeclarations(StringRef prefix, SmallVectorImpl<Function *> &decls) const {
+  forEachDeclaration(prefix, [&](const Declaration &entry) { decls.push_back(cast<Function>(entry.decl)); });
+}
+
+// =====================================================================================================================
+// Get the calls, from functions of the given shader stage, to lgc.* declarations whose name starts with the given
+// prefix.
+//
+// @param prefix : Name prefix
+// @param stage : Shader stage of the calling function
+// @param [out] calls : Vector to append the calls to
+void CallSiteIndexResult::getCalls(StringRef prefix, ShaderStageEnum stage, SmallVectorImpl<CallInst *> &calls) const {
+  forEachDeclaration(prefix, [&](const Declaration &entry) {
+    auto range = std::equal_range(entry.calls.begin(), entry.calls.end(), CallSite{stage, nullptr},
+                                  [](const CallSite &lhs, const CallSite &rhs) { return lhs.stage < rhs.stage; });
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->call)
+        calls.push_back(cast<CallInst>(it->call));
+    }
+  });
+}
+
+// =====================================================================================================================
+// Get all calls to lgc.* declarations whose name starts with the given prefix.
+//
+// @param prefix : Name prefix
+// @param [out] calls : Vector to append the calls to
+void CallSiteIndexResult::getCalls(StringRef prefix, SmallVectorImpl<CallInst *> &calls) const {
+  forEachDeclaration(prefix, [&](const Declaration &entry) {
+    for (const CallSite &callSite : entry.calls) {
+      if (callSite.call)
+        calls.push_back(cast<CallInst>(callSite.call));
+    }
+  });
+}
@@ -32,6 +32,7 @@
 #include "lgc/LgcContext.h"
 #include "lgc/PassManager.h"
 #include "lgc/patch/Patch.h"
+#include "lgc/state/CallSiteIndex.h"
 #include "lgc/state/PipelineShaders.h"
 #include "lgc/state/PipelineState.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
@@ -43,6 +44,7 @@
 #include "llvm/IRPrinter/IRPrintingPasses.h"
 #endif
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Target/TargetMachine.h"
@@ -52,6 +54,13 @@
 using namespace lgc;
 using namespace llvm;
 
+// -lgc-in-memory-pipeline-state: for a whole-pipeline compile, give the front-end's PipelineState directly to the
+// middle-end passes instead of recording it into IR metadata in irLink() and reading it back
+static cl::opt<bool> InMemoryPipelineState("lgc-in-memory-pipeline-state",
+                                           cl::desc("Hand pipeline state to middle-end passes in memory rather than "
+                                                    "through IR metadata for whole-pipeline compiles"),
+                                           cl::init(false));
+
 namespace lgc {
 
 ElfLinker *createElfLinkerImpl(PipelineState *pipelineState, llvm::ArrayRef<llvm::MemoryBufferRef> elfs);
@@ -139,8 +148,12 @@ std::unique_ptr<Module> PipelineState::irLink(MutableArrayRef<std::unique_ptr<Mo
     attachModule(module.get());
   }
 
-  // The front-end was using a BuilderRecorder; record pipeline state into IR metadata.
-  record(modules[0].get());
+  // The front-end was using a BuilderRecorder; record pipeline state into IR metadata. A whole-pipeline compile can
+  // skip that and keep the state in this PipelineState, which generate() then gives to the passes. The recorded form
+  // is still needed for -emit-lgc output and for unlinked and part-pipeline compiles.
+  m_stateInMemory = InMemoryPipelineState && !m_emitLgc && isWholePipeline();
+  if (!m_stateInMemory)
+    record(modules[0].get());
 
   // If there is only one shader, just change the name on its module and return it.
   std::unique_ptr<Module> pipelineModule;
@@ -212,15 +225,25 @@ bool PipelineState::generate(Module *pipelineModule, raw_pwrite_stream &outStrea
   Patch::registerPasses(*passMgr);
   passMgr->registerFunctionAnalysis([&] { return getLgcContext()->getTargetMachine()->getTargetIRAnalysis(); });
   passMgr->registerModuleAnalysis([&] { return PipelineShaders(); });
+  passMgr->registerModuleAnalysis([&] { return CallSiteIndex(); });
 
   // Ensure m_stageMask is set up in this PipelineState, as Patch::addPasses uses it.
   readShaderStageMask(&*pipelineModule);
 
-  // Manually add a PipelineStateWrapper pass.
-  // We were using BuilderRecorder, so we do not give our PipelineState to it.
-  // (The first time PipelineStateWrapper is used, it allocates its own PipelineState and populates
-  // it by reading IR metadata.)
-  passMgr->registerModuleAnalysis([&] { return PipelineStateWrapper(getLgcContext()); });
+  if (m_stateInMemory) {
+    // irLink() did not record the pipeline state into IR metadata, so give our PipelineState to the passes directly,
+    // once the parts of it that live in the shader modules have been read.
+    getShaderModes()->readModesFromPipeline(&*pipelineModule);
+    readModuleDerivedState(&*pipelineModule);
+    initializeInOutPackState();
+    passMgr->registerModuleAnalysis([&] { return PipelineStateWrapper(this); });
+  } else {
+    // Manually add a PipelineStateWrapper pass.
+    // We were using BuilderRecorder, so we do not give our PipelineState to it.
+    // (The first time PipelineStateWrapper is used, it allocates its own PipelineState and populates
+    // it by reading IR metadata.)
+    passMgr->registerModuleAnalysis([&] { return PipelineStateWrapper(getLgcContext()); });
+  }
 
   // continuation transform require this.
   passMgr->registerModuleAnalysis([&] { return DialectContextAnalysis(false); });
@@ -235,8 +258,10 @@ bool PipelineState::generate(Module *pipelineModule, raw_pwrite_stream &outStrea
     Patch::addPasses(this, *passMgr, patchTimer, optTimer, std::move(checkShaderCacheFunc),
                      static_cast<uint32_t>(getLgcContext()->getOptimizationLevel()));
 
-    // Add pass to clear pipeline state from IR
-    passMgr->addPass(PipelineStateClearer());
+    // Add pass to clear pipeline state from IR. With the state in memory, there is no IR copy to clear, and the
+    // PipelineState being used by the passes is our own, so leave it alone.
+    if (!m_stateInMemory)
+      passMgr->addPass(PipelineStateClearer());
 
     // Run the pipeline passes until codegen.
     passMgr->run(*pipelineModule);
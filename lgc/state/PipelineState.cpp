@@ -425,6 +425,7 @@ void PipelineState::clear(Module *module) {
   getShaderModes()->clear();
   m_options = {};
   m_userDataNodes = {};
+  m_resourceNodeIndexValid = false;
   m_deviceIndex = 0;
   m_vertexInputDescriptions.clear();
   m_colorExportFormats.clear();
@@ -473,6 +474,23 @@ void PipelineState::readState(Module *module) {
   readVertexInputDescriptions(module);
   readColorExportState(module);
   readGraphicsState(module);
+  readModuleDerivedState(module);
+}
+
+// =====================================================================================================================
+// Set up the parts of the pipeline state that come from the shader modules themselves, rather than being recorded
+// from the state the front-end set through the Pipeline interface. Shader modes must already have been read.
+//
+// @param module : LLVM module
+void PipelineState::readModuleDerivedState(Module *module) {
+  if (module->getNamedMetadata(SampleShadingMetaName))
+    m_rasterizerState.perSampleShading |= 1;
+
+  // fragmentMode is updated after ShaderModes::readModesFromPipeline()
+  const auto &fragmentMode = getShaderModes()->getFragmentShaderMode();
+  if (fragmentMode.innerCoverage)
+    m_rasterizerState.innerCoverage = 1;
+
   if (!m_palMetadata)
     m_palMetadata = new PalMetadata(this, module, m_registerFieldFormat);
   setXfbStateMetadata(module);
@@ -687,6 +705,7 @@ void PipelineState::setUserDataNodes(ArrayRef<ResourceNode> nodes) {
   ResourceNode *destTable = m_allocUserDataNodes.get();
   ResourceNode *destInnerTable = destTable + nodeCount;
   m_userDataNodes = ArrayRef<ResourceNode>(destTable, nodes.size());
+  m_resourceNodeIndexValid = false;
   setUserDataNodesTable(nodes, destTable, destInnerTable);
   assert(destInnerTable == destTable + nodes.size());
 }
@@ -887,6 +906,7 @@ void PipelineState::readUserDataNodes(Module *module) {
     }
   }
   m_userDataNodes = ArrayRef<ResourceNode>(m_allocUserDataNodes.get(), nextOuterNode);
+  m_resourceNodeIndexValid = false;
 }
 
 // =====================================================================================================================
@@ -1006,6 +1026,37 @@ bool PipelineState::matchResourceNode(const ResourceNode &node, ResourceNodeType
   return false;
 }
 
+// =====================================================================================================================
+// Build the index of descriptor nodes used by findResourceNode. Nodes are recorded in the order that a scan of the user
+// data nodes would visit them, so that the first match in the index is the node the scan would have returned.
+void PipelineState::buildResourceNodeIndex() const {
+  m_resourceNodeIndex.clear();
+  m_rangedResourceNodes.clear();
+  unsigned order = 0;
+
+  auto addNode = [&](const ResourceNode &topNode, const ResourceNode &node) {
+    // A zero visibility means visible to all stages.
+    unsigned topVisibility = topNode.visibility != 0 ? topNode.visibility : UINT_MAX;
+    unsigned nodeVisibility = node.visibility != 0 ? node.visibility : UINT_MAX;
+    ResourceNodeIndexEntry entry = {order++, topVisibility & nodeVisibility, &topNode, &node};
+    m_resourceNodeIndex[{node.set, node.binding}].push_back(entry);
+    // With useResourceBindingRange, the node also matches later bindings in its range.
+    if (node.stride == 0 || node.sizeInDwords > node.stride)
+      m_rangedResourceNodes[node.set].push_back(entry);
+  };
+
+  for (const ResourceNode &node : getUserDataNodes()) {
+    if (!nodeTypeHasBinding(node.concreteType))
+      continue;
+    if (node.concreteType == ResourceNodeType::DescriptorTableVaPtr) {
+      for (const ResourceNode &innerNode : node.innerTable)
+        addNode(node, innerNode);
+    } else
+      addNode(node, node);
+  }
+  m_resourceNodeIndexValid = true;
+}
+
 // =====================================================================================================================
 // Find the resource node for the given {set,binding} compatible with nodeType.
 //
@@ -1030,31 +1081,56 @@ PipelineState::findResourceNode(ResourceNodeType nodeType, uint64_t descSet, uns
   if (stage)
     visibilityMask = 1 << std::min(unsigned(stage.value()), unsigned(ShaderStage::Compute));
 
-  for (const ResourceNode &node : getUserDataNodes()) {
-    if (!nodeTypeHasBinding(node.concreteType))
-      continue;
-    if (node.visibility != 0 && (node.visibility & visibilityMask) == 0)
-      continue;
+  if (nodeType == ResourceNodeType::DescriptorTableVaPtr) {
+    // Tables are matched on the set of their first inner node. There are only a few top-level nodes, so just scan.
+    for (const ResourceNode &node : getUserDataNodes()) {
+      if (!nodeTypeHasBinding(node.concreteType))
+        continue;
+      if (node.visibility != 0 && (node.visibility & visibilityMask) == 0)
+        continue;
 
-    if (node.concreteType == ResourceNodeType::DescriptorTableVaPtr) {
-      if (nodeType == ResourceNodeType::DescriptorTableVaPtr) {
+      if (node.concreteType == ResourceNodeType::DescriptorTableVaPtr) {
         assert(!node.innerTable.empty());
-
         if (node.innerTable[0].set == descSet)
           return {&node, &node};
-        continue;
-      }
+      } else if (matchResourceNode(node, nodeType, descSet, binding))
+        return {&node, &node};
+    }
+    return {nullptr, nullptr};
+  }
 
-      // Check inner nodes.
-      for (const ResourceNode &innerNode : node.innerTable) {
-        if (innerNode.visibility != 0 && (innerNode.visibility & visibilityMask) == 0)
-          continue;
-        if (matchResourceNode(innerNode, nodeType, descSet, binding))
-          return {&node, &innerNode};
+  if (!m_resourceNodeIndexValid)
+    buildResourceNodeIndex();
+
+  auto isVisible = [&](const ResourceNodeIndexEntry &entry) {
+    return !stage || (entry.visibility & visibilityMask) != 0;
+  };
+
+  // Take the first visible, compatible node with exactly this {set,binding}, then see whether a node earlier in the
+  // search order matches it as part of a binding range.
+  const ResourceNodeIndexEntry *found = nullptr;
+  auto indexIt = m_resourceNodeIndex.find({descSet, binding});
+  if (indexIt != m_resourceNodeIndex.end()) {
+    for (const ResourceNodeIndexEntry &entry : indexIt->second) {
+      if (isVisible(entry) && matchResourceNode(*entry.node, nodeType, descSet, binding)) {
+        found = &entry;
+        break;
       }
-    } else if (matchResourceNode(node, nodeType, descSet, binding))
-      return {&node, &node};
+    }
+  }
+  auto rangedIt = m_rangedResourceNodes.find(descSet);
+  if (getOptions().useResourceBindingRange && rangedIt != m_rangedResourceNodes.end()) {
+    for (const ResourceNodeIndexEntry &entry : rangedIt->second) {
+      if (found && entry.order >= found->order)
+        break;
+      if (isVisible(entry) && matchResourceNode(*entry.node, nodeType, descSet, binding)) {
+        found = &entry;
+        break;
+      }
+    }
   }
+  if (found)
+    return {found->topNode, found->node};
 
   if (nodeType == ResourceNodeType::DescriptorFmask && getOptions().enableFmask) {
 #if defined(__GNUC__) && !defined(__clang__)
@@ -1321,15 +1397,6 @@ void PipelineState::readGraphicsState(Module *module) {
   readNamedMetadataArrayOfInt32(module, IaStateMetadataName, m_inputAssemblyState);
   readNamedMetadataArrayOfInt32(module, RsStateMetadataName, m_rasterizerState);
   readNamedMetadataArrayOfInt32(module, TessLevelMetadataName, m_tessLevel);
-
-  auto nameMeta = module->getNamedMetadata(SampleShadingMetaName);
-  if (nameMeta)
-    m_rasterizerState.perSampleShading |= 1;
-
-  // fragmentMode is updated after ShaderModes::readModesFromPipeline()
-  const auto &fragmentMode = getShaderModes()->getFragmentShaderMode();
-  if (fragmentMode.innerCoverage)
-    m_rasterizerState.innerCoverage = 1;
 }
 
 // =====================================================================================================================
@@ -48,6 +48,10 @@ cl::list<std::string> InFiles(cl::Positional, cl::OneOrMore, cl::ValueRequired,
 // -o: output filename
 cl::opt<std::string> OutFileName("o", cl::cat(LgcDisCategory), cl::desc("Output filename ('-' for stdout)"),
                                  cl::value_desc("filename"));
+
+// -perf-report: output a JSON static performance report instead of the disassembly
+cl::opt<bool> PerfReport("perf-report", cl::cat(LgcDisCategory),
+                         cl::desc("Output a JSON static performance report of each pipeline ELF"), cl::init(false));
 } // anonymous namespace
 
 // =====================================================================================================================
@@ -87,7 +91,16 @@ int main(int argc, char **argv) {
       errs() << "\n";
       return 1;
     }
-    disassembleObject((*fileOrErr)->getMemBufferRef(), ostream);
+    if (PerfReport) {
+      if (Error err = reportObjectPerformance((*fileOrErr)->getMemBufferRef(), ostream)) {
+        auto error = SMDiagnostic(inFileName, SourceMgr::DK_Error, toString(std::move(err)));
+        error.print(progName, errs());
+        errs() << "\n";
+        return 1;
+      }
+    } else {
+      disassembleObject((*fileOrErr)->getMemBufferRef(), ostream);
+    }
   }
 
   return 0;
@@ -0,0 +1,245 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+
+#include "lgc/LgcContext.h"
+#include "lgc/LgcDialect.h"
+#include "lgc/state/PipelineState.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Target/TargetMachine.h"
+#include "gmock/gmock.h"
+#include <memory>
+#include <optional>
+
+using namespace lgc;
+using namespace llvm;
+
+namespace {
+
+using NodePair = std::pair<const ResourceNode *, const ResourceNode *>;
+
+const uint32_t ImmutableSampler[4] = {1, 2, 3, 4};
+
+// Make a descriptor node. A stride smaller than the size makes the node cover a range of bindings when the
+// useResourceBindingRange option is set.
+ResourceNode makeNode(ResourceNodeType type, uint64_t set, unsigned binding, unsigned visibility = 0,
+                      unsigned sizeInDwords = 4, unsigned stride = 4) {
+  ResourceNode node;
+  node.concreteType = type;
+  node.abstractType = type;
+  node.visibility = visibility;
+  node.sizeInDwords = sizeInDwords;
+  node.offsetInDwords = 0;
+  node.set = set;
+  node.binding = binding;
+  node.stride = stride;
+  node.immutableSize = 0;
+  node.immutableValue = nullptr;
+  return node;
+}
+
+ResourceNode makeTable(ArrayRef<ResourceNode> innerTable, unsigned visibility = 0) {
+  ResourceNode node;
+  node.concreteType = ResourceNodeType::DescriptorTableVaPtr;
+  node.abstractType = ResourceNodeType::DescriptorTableVaPtr;
+  node.visibility = visibility;
+  node.sizeInDwords = 1;
+  node.offsetInDwords = 0;
+  node.innerTable = innerTable;
+  return node;
+}
+
+unsigned stageBit(ShaderStageEnum stage) {
+  return 1 << stage;
+}
+
+class FindResourceNodeTest : public testing::Test {
+protected:
+  void SetUp() override {
+    LgcContext::initialize();
+    m_dialectContext = llvm_dialects::DialectContext::make<LgcDialect>(m_context);
+#if LLVM_MAIN_REVISION && LLVM_MAIN_REVISION < 474768
+    // Old version of the code
+    m_targetMachine = LgcContext::createTargetMachine("gfx1010", CodeGenOpt::Level::Default);
+#else
+    // New version of the code (also handles unknown version, which we treat as latest)
+    m_targetMachine = LgcContext::createTargetMachine("gfx1010", CodeGenOptLevel::Default);
+#endif
+    m_lgcContext.reset(LgcContext::create(&*m_targetMachine, m_context, /*palAbiVersion=*/0xFFFFFFFF));
+  }
+
+  std::unique_ptr<PipelineState> createPipelineState(ArrayRef<ResourceNode> nodes) {
+    std::unique_ptr<PipelineState> pipelineState(static_cast<PipelineState *>(m_lgcContext->createPipeline()));
+    pipelineState->setUserDataNodes(nodes);
+    return pipelineState;
+  }
+
+  LLVMContext m_context;
+  std::unique_ptr<llvm_dialects::DialectContext> m_dialectContext;
+  std::unique_ptr<TargetMachine> m_targetMachine;
+  std::unique_ptr<LgcContext> m_lgcContext;
+};
+
+// The search findResourceNode did before it had an index: top-level nodes in order, with the inner nodes of each
+// table in place, skipping nodes not visible to the stage and returning the first match.
+NodePair linearSearch(ArrayRef<ResourceNode> nodes, std::optional<ShaderStageEnum> stage,
+                      function_ref<bool(const ResourceNode &)> matches) {
+  auto isVisible = [&](const ResourceNode &node) {
+    return !stage || node.visibility == 0 || (node.visibility & stageBit(std::min(*stage, ShaderStage::Compute))) != 0;
+  };
+  for (const ResourceNode &node : nodes) {
+    if (node.concreteType == ResourceNodeType::PushConst || !isVisible(node))
+      continue;
+    if (node.concreteType == ResourceNodeType::DescriptorTableVaPtr) {
+      for (const ResourceNode &innerNode : node.innerTable) {
+        if (isVisible(innerNode) && matches(innerNode))
+          return {&node, &innerNode};
+      }
+    } else if (matches(node)) {
+      return {&node, &node};
+    }
+  }
+  return {nullptr, nullptr};
+}
+
+TEST_F(FindResourceNodeTest, IndexMatchesLinearSearch) {
+  ResourceNode immutableSampler = makeNode(ResourceNodeType::DescriptorSampler, 0, 2);
+  immutableSampler.immutableSize = 1;
+  immutableSampler.immutableValue = ImmutableSampler;
+
+  const ResourceNode set0[] = {
+      makeNode(ResourceNodeType::DescriptorResource, 0, 0),
+      makeNode(ResourceNodeType::DescriptorCombinedTexture, 0, 1, 0, 12, 12),
+      immutableSampler,
+      // Duplicate bindings: the first is only visible to the fragment shader.
+      makeNode(ResourceNodeType::DescriptorBuffer, 0, 3, stageBit(ShaderStage::Fragment)),
+      makeNode(ResourceNodeType::DescriptorBuffer, 0, 3),
+      // With useResourceBindingRange, covers bindings 4 to 7, hiding the node for binding 6 below.
+      makeNode(ResourceNodeType::DescriptorResource, 0, 4, 0, 32, 8),
+      makeNode(ResourceNodeType::DescriptorResource, 0, 6),
+      makeNode(ResourceNodeType::DescriptorFmask, 0, 0),
+      makeNode(ResourceNodeType::DescriptorTexelBuffer, 0, 8),
+  };
+  const ResourceNode set1VertexOnly[] = {
+      makeNode(ResourceNodeType::DescriptorBuffer, 1, 0),
+      makeNode(ResourceNodeType::DescriptorCombinedTexture, 1, 1, 0, 12, 12),
+  };
+  const ResourceNode set1[] = {
+      makeNode(ResourceNodeType::DescriptorBuffer, 1, 0),
+      makeNode(ResourceNodeType::DescriptorSampler, 1, 1),
+      makeNode(ResourceNodeType::DescriptorConstBuffer, 1, 2, stageBit(ShaderStage::Compute)),
+  };
+  const ResourceNode topNodes[] = {
+      makeTable(set0),
+      makeTable(set1VertexOnly, stageBit(ShaderStage::Vertex)),
+      makeTable(set1),
+      makeNode(ResourceNodeType::PushConst, 0, 0),
+      makeNode(ResourceNodeType::DescriptorBuffer, 2, 0),
+      makeNode(ResourceNodeType::DescriptorBuffer, 2, 0, stageBit(ShaderStage::Fragment)),
+      makeNode(ResourceNodeType::InlineBuffer, 2, 1),
+      makeNode(ResourceNodeType::DescriptorConstBufferCompact, 2, 2),
+      makeNode(ResourceNodeType::DescriptorResource, 0, 3),
+  };
+  std::unique_ptr<PipelineState> pipelineState = createPipelineState(topNodes);
+  ArrayRef<ResourceNode> nodes = pipelineState->getUserDataNodes();
+
+  // A pipeline holding just one node tells whether that node matches a query, without the index having to choose
+  // between nodes.
+  DenseMap<const ResourceNode *, std::unique_ptr<PipelineState>> singleNodePipelines;
+  for (const ResourceNode &node : nodes) {
+    if (node.concreteType == ResourceNodeType::DescriptorTableVaPtr) {
+      for (const ResourceNode &innerNode : node.innerTable)
+        singleNodePipelines[&innerNode] = createPipelineState(innerNode);
+    } else if (node.concreteType != ResourceNodeType::PushConst) {
+      singleNodePipelines[&node] = createPipelineState(node);
+    }
+  }
+
+  const ResourceNodeType nodeTypes[] = {ResourceNodeType::Unknown,
+                                        ResourceNodeType::DescriptorResource,
+                                        ResourceNodeType::DescriptorSampler,
+                                        ResourceNodeType::DescriptorCombinedTexture,
+                                        ResourceNodeType::DescriptorTexelBuffer,
+                                        ResourceNodeType::DescriptorFmask,
+                                        ResourceNodeType::DescriptorBuffer,
+                                        ResourceNodeType::DescriptorConstBuffer,
+                                        ResourceNodeType::InlineBuffer,
+                                        DescriptorAnyBuffer};
+  const std::optional<ShaderStageEnum> stages[] = {std::nullopt, ShaderStage::Vertex, ShaderStage::Fragment,
+                                                   ShaderStage::Compute};
+
+  unsigned found = 0;
+  Options options = {};
+  for (bool useResourceBindingRange : {false, true}) {
+    options.useResourceBindingRange = useResourceBindingRange;
+    pipelineState->setOptions(options);
+    for (auto &singleNodePipeline : singleNodePipelines)
+      singleNodePipeline.second->setOptions(options);
+
+    for (ResourceNodeType nodeType : nodeTypes) {
+      for (uint64_t set = 0; set != 4; ++set) {
+        for (unsigned binding = 0; binding != 10; ++binding) {
+          auto matches = [&](const ResourceNode &node) {
+            return singleNodePipelines[&node]->findResourceNode(nodeType, set, binding).second != nullptr;
+          };
+          for (std::optional<ShaderStageEnum> stage : stages) {
+            NodePair expected = linearSearch(nodes, stage, matches);
+            EXPECT_EQ(pipelineState->findResourceNode(nodeType, set, binding, stage), expected)
+                << "type " << unsigned(nodeType) << " set " << set << " binding " << binding << " stage "
+                << (stage ? int(*stage) : -1) << " range " << useResourceBindingRange;
+            found += expected.second != nullptr;
+          }
+        }
+      }
+    }
+  }
+  EXPECT_GT(found, 0u);
+
+  // Spot check the cases the layout was built for.
+  ArrayRef<ResourceNode> tableSet0 = nodes[0].innerTable;
+  options.useResourceBindingRange = false;
+  pipelineState->setOptions(options);
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorBuffer, 0, 3, ShaderStage::Fragment),
+            NodePair(&nodes[0], &tableSet0[3]));
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorBuffer, 0, 3, ShaderStage::Vertex),
+            NodePair(&nodes[0], &tableSet0[4]));
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorSampler, 0, 1, std::nullopt),
+            NodePair(&nodes[0], &tableSet0[1]));
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorSampler, 0, 2, std::nullopt),
+            NodePair(&nodes[0], &tableSet0[2]));
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorBuffer, 1, 0, ShaderStage::Vertex),
+            NodePair(&nodes[1], &nodes[1].innerTable[0]));
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorBuffer, 1, 0, ShaderStage::Fragment),
+            NodePair(&nodes[2], &nodes[2].innerTable[0]));
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorResource, 0, 6, std::nullopt),
+            NodePair(&nodes[0], &tableSet0[6]));
+  options.useResourceBindingRange = true;
+  pipelineState->setOptions(options);
+  EXPECT_EQ(pipelineState->findResourceNode(ResourceNodeType::DescriptorResource, 0, 6, std::nullopt),
+            NodePair(&nodes[0], &tableSet0[5]));
+}
+
+} // namespace
@@ -50,6 +50,8 @@
 #include "llpcSpirvLowerRayTracing.h"
 #include "llpcSpirvLowerTranslator.h"
 #include "llpcSpirvLowerUtil.h"
+#include "llpcSpirvModuleIndex.h"
+#include "llpcStructuralHash.h"
 #include "llpcThreading.h"
 #include "llpcTimerProfiler.h"
 #include "llpcUtil.h"
@@ -58,6 +60,7 @@
 #include "vkgcElfReader.h"
 #include "vkgcPipelineDumper.h"
 #include "lgc/Builder.h"
+#include "lgc/Disassembler.h"
 #include "lgc/ElfLinker.h"
 #include "lgc/EnumIterator.h"
 #include "lgc/LgcRtDialect.h"
@@ -93,6 +96,7 @@
 #include "llvm/Transforms/Utils/Cloning.h"
 #include <cassert>
 #include <condition_variable>
+#include <limits>
 #include <mutex>
 #include <set>
 #include <unordered_set>
@@ -174,6 +178,26 @@ opt<bool> EnablePartPipeline("enable-part-pipeline", cl::desc("Enable part pipel
 opt<int> AddRtHelpers("add-rt-helpers", cl::desc("Add this number of helper threads for each RT pipeline compile"),
                       init(0));
 
+// -dedup-rt-shaders: compile structurally identical ray-tracing shaders of an indirect pipeline only once
+opt<bool> DedupRtShaders("dedup-rt-shaders",
+                         cl::desc("Compile structurally identical ray-tracing shaders only once (indirect mode)"),
+                         init(true));
+
+// -auto-tune-compute: compile compute pipelines under several wave-size and VGPR-limit variants and keep the variant
+// that scores best under a static cost model
+opt<bool> AutoTuneCompute("auto-tune-compute",
+                          cl::desc("Pick wave size and VGPR limit of compute pipelines by compiling variants"),
+                          init(false));
+
+// -auto-tune-vgpr-limits: VGPR limits tried by -auto-tune-compute in addition to the unlimited one
+cl::list<unsigned> AutoTuneVgprLimits("auto-tune-vgpr-limits",
+                                      cl::desc("VGPR limits tried by -auto-tune-compute besides the default"),
+                                      cl::CommaSeparated);
+
+// -auto-tune-threads: number of threads compiling -auto-tune-compute variants, 0 for all available cores
+opt<unsigned> AutoTuneThreads("auto-tune-threads", cl::desc("Threads used to compile -auto-tune-compute variants"),
+                              init(1));
+
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 66
 // -shader-cache-file-dir: root directory to store shader cache
 opt<std::string> ShaderCacheFileDir("shader-cache-file-dir", desc("Root directory to store shader cache"),
@@ -427,6 +451,37 @@ bool VKAPI_CALL ICompiler::IsVertexFormatSupported(VkFormat format) {
   return dfmt != BufDataFormatInvalid;
 }
 
+// =====================================================================================================================
+// Writes a JSON static performance report of a pipeline ELF into the buffer, truncating it if the buffer is too small.
+//
+// @param pipelineBin : Pipeline ELF binary
+// @param buffer : Buffer receiving the null-terminated report, or nullptr to query the size
+// @param bufferSize : Size of the buffer in bytes
+// @returns : Size in bytes of the full report including the null terminator, or 0 if the binary is not a pipeline ELF
+//            that the report can be produced for
+size_t VKAPI_CALL ICompiler::GetPerfReport(const BinaryData *pipelineBin, char *buffer, size_t bufferSize) {
+  if (!pipelineBin || !pipelineBin->pCode || pipelineBin->codeSize == 0)
+    return 0;
+
+  // The reporter fully decodes the ELF and its PAL metadata, and returns an error rather than aborting on a malformed
+  // binary.
+  std::string report;
+  raw_string_ostream reportStream(report);
+  StringRef elf(static_cast<const char *>(pipelineBin->pCode), pipelineBin->codeSize);
+  if (Error err = lgc::reportObjectPerformance(MemoryBufferRef(elf, "pipeline"), reportStream)) {
+    LLPC_ERRS("Cannot produce performance report: " << toString(std::move(err)) << "\n");
+    return 0;
+  }
+  reportStream.flush();
+
+  if (buffer && bufferSize != 0) {
+    size_t copySize = std::min(report.size(), bufferSize - 1);
+    memcpy(buffer, report.data(), copySize);
+    buffer[copySize] = '\0';
+  }
+  return report.size() + 1;
+}
+
 // =====================================================================================================================
 //
 // @param gfxIp : Graphics IP version info
@@ -520,18 +575,13 @@ void Compiler::Destroy() {
 // Merge location and binding value, and replace the binding decoration in spirv binary.
 //
 // @param codeBuffer : Spirv binary
+// @param decorations : Word offsets of the decoration instructions in codeBuffer, from the SPIR-V module index
 // @param imageSymbolInfo : Image symbol infos
-static void mergeSpirvLocationAndBinding(MutableArrayRef<unsigned> codeBuffer,
+static void mergeSpirvLocationAndBinding(MutableArrayRef<unsigned> codeBuffer, ArrayRef<unsigned> decorations,
                                          std::vector<ResourceNodeData> &imageSymbolInfo) {
-  constexpr unsigned wordSize = sizeof(unsigned);
-
-  unsigned *code = codeBuffer.data();
-  unsigned *end = code + codeBuffer.size();
-  unsigned *codePos = code + sizeof(SpirvHeader) / wordSize;
-
-  while (codePos < end) {
+  for (unsigned decorationOffset : decorations) {
+    unsigned *codePos = &codeBuffer[decorationOffset];
     unsigned opCode = (codePos[0] & OpCodeMask);
-    unsigned wordCount = (codePos[0] >> WordCountShift);
 
     switch (opCode) {
     case OpDecorate: {
@@ -554,8 +604,6 @@ static void mergeSpirvLocationAndBinding(MutableArrayRef<unsigned> codeBuffer,
     default:
       break;
     }
-
-    codePos += wordCount;
   }
 }
 
@@ -563,20 +611,16 @@ static void mergeSpirvLocationAndBinding(MutableArrayRef<unsigned> codeBuffer,
 // Recalculate resource binding for separate shader object
 //
 // @param codeBuffer : Spirv binary
+// @param decorations : Word offsets of the decoration instructions in codeBuffer, from the SPIR-V module index
 // @param resourceBindingOffset : resource binding offset
 // @param symbolInfo : resource symbol infos
-static void recalcResourceBinding(MutableArrayRef<unsigned> codeBuffer, unsigned resourceBindingOffset,
+static void recalcResourceBinding(MutableArrayRef<unsigned> codeBuffer, ArrayRef<unsigned> decorations,
+                                  unsigned resourceBindingOffset,
                                   std::vector<ResourceNodeData> &uniformBufferInfo,
                                   std::vector<ResourceNodeData> &storageBufferInfo,
                                   std::vector<ResourceNodeData> &textureSymbolInfo,
                                   std::vector<ResourceNodeData> &imageSymbolInfo,
                                   std::vector<ResourceNodeData> &atomicCounterSymbolInfo) {
-  constexpr unsigned wordSize = sizeof(unsigned);
-
-  unsigned *code = codeBuffer.data();
-  unsigned *end = code + codeBuffer.size();
-  unsigned *codePos = code + sizeof(SpirvHeader) / wordSize;
-
   auto updateResourceBinding = [resourceBindingOffset](uint32_t varId, uint32_t binding,
                                                        std::vector<ResourceNodeData> &symbolInfo) {
     for (auto it = symbolInfo.begin(); it != symbolInfo.end(); ++it) {
@@ -586,9 +630,9 @@ static void recalcResourceBinding(MutableArrayRef<unsigned> codeBuffer, unsigned
     }
   };
 
-  while (codePos < end) {
+  for (unsigned decorationOffset : decorations) {
+    unsigned *codePos = &codeBuffer[decorationOffset];
     unsigned opCode = (codePos[0] & OpCodeMask);
-    unsigned wordCount = (codePos[0] >> WordCountShift);
 
     switch (opCode) {
     case OpDecorate: {
@@ -609,8 +653,6 @@ static void recalcResourceBinding(MutableArrayRef<unsigned> codeBuffer, unsigned
     default:
       break;
     }
-
-    codePos += wordCount;
   }
 }
 
@@ -631,18 +673,24 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
     return Result::ErrorInvalidPointer;
   }
 
-  auto codeSizeOrErr = ShaderModuleHelper::getCodeSize(shaderInfo);
+  SpirvModuleIndexBuilder spirvIndexBuilder;
+  auto codeSizeOrErr = ShaderModuleHelper::getCodeSize(shaderInfo, spirvIndexBuilder);
   if (Error err = codeSizeOrErr.takeError())
     return errorToResult(std::move(err));
 
   const unsigned codeSize = *codeSizeOrErr;
-  size_t allocSize = sizeof(ShaderModuleData) + codeSize;
+  size_t allocSize = sizeof(ShaderModuleDataEx) + codeSize;
 
   ShaderModuleData moduleData = {};
   std::vector<unsigned> codeBufferVector(codeSize / sizeof(unsigned));
   MutableArrayRef<unsigned> codeBuffer(codeBufferVector);
   memcpy(moduleData.hash, &hash, sizeof(hash));
-  Result result = ShaderModuleHelper::getModuleData(shaderInfo, codeBuffer, moduleData);
+  Result result = ShaderModuleHelper::getModuleData(shaderInfo, spirvIndexBuilder, codeBuffer, moduleData);
+
+  // The SPIR-V index is stored last in the module data, since it only needs 4-byte alignment.
+  SpirvModuleIndex spirvIndex = spirvIndexBuilder.getIndex();
+  if (moduleData.binType == BinaryType::Spirv)
+    allocSize += spirvIndex.getBlobSize();
 
   ResourcesNodes resourceNodes = {};
   std::vector<ResourceNodeData> inputSymbolInfo;
@@ -671,12 +719,13 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
 
     // Solve binding conflictions for separate shader object
     if (shaderInfo->options.resourceBindingOffset > 0) {
-      recalcResourceBinding(codeBuffer, shaderInfo->options.resourceBindingOffset, uniformBufferInfo, storageBufferInfo,
-                            textureSymbolInfo, imageSymbolInfo, atomicCounterSymbolInfo);
+      recalcResourceBinding(codeBuffer, spirvIndex.getDecorations(), shaderInfo->options.resourceBindingOffset,
+                            uniformBufferInfo, storageBufferInfo, textureSymbolInfo, imageSymbolInfo,
+                            atomicCounterSymbolInfo);
     } else if (imageSymbolInfo.size() && shaderInfo->options.mergeLocationAndBinding)
       // Merge location and binding if image binding doesn't exist, the issue only exist on spirv binary cases,
       // separate shader object doesn't support spirv binary, so it doesn't have such issue
-      mergeSpirvLocationAndBinding(codeBuffer, imageSymbolInfo);
+      mergeSpirvLocationAndBinding(codeBuffer, spirvIndex.getDecorations(), imageSymbolInfo);
   }
 
   uint8_t *allocBuf =
@@ -688,9 +737,14 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
   ShaderModuleData *pShaderModuleData = nullptr;
   ResourcesNodes *pResourcesNodes = nullptr;
 
+  // The public module data is followed by the LLPC-internal part of ShaderModuleDataEx.
+  ShaderModuleDataEx *pShaderModuleDataEx = reinterpret_cast<ShaderModuleDataEx *>(bufferWritePtr);
   memcpy(bufferWritePtr, &moduleData, sizeof(moduleData));
-  pShaderModuleData = reinterpret_cast<ShaderModuleData *>(bufferWritePtr);
-  bufferWritePtr += sizeof(ShaderModuleData);
+  pShaderModuleData = &pShaderModuleDataEx->common;
+  pShaderModuleDataEx->magic = ShaderModuleDataExMagic;
+  pShaderModuleDataEx->size = sizeof(ShaderModuleDataEx);
+  pShaderModuleDataEx->spirvIndex = nullptr;
+  bufferWritePtr += sizeof(ShaderModuleDataEx);
 
   memcpy(bufferWritePtr, codeBuffer.data(), codeBuffer.size() * sizeof(unsigned));
   pShaderModuleData->binCode.pCode = bufferWritePtr;
@@ -736,6 +790,12 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
     bufferWritePtr += defaultUniformSymbolInfo.size() * sizeof(ResourceNodeData);
   }
 
+  if (moduleData.binType == BinaryType::Spirv) {
+    spirvIndex.writeBlob(bufferWritePtr);
+    pShaderModuleDataEx->spirvIndex = bufferWritePtr;
+    bufferWritePtr += spirvIndex.getBlobSize();
+  }
+
   shaderOut->pModuleData = pShaderModuleData;
 
   if (moduleData.binType == BinaryType::Spirv && cl::EnablePipelineDump) {
@@ -1873,7 +1933,9 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
           timerProfiler.getTimer(TimerCodeGen),
       };
 
+      timerProfiler.sampleMemoryUsage();
       pipeline->generate(std::move(pipelineModule), elfStream, checkShaderCacheFunc, timers);
+      timerProfiler.sampleMemoryUsage();
 #if LLPC_ENABLE_EXCEPTION
       result = Result::Success;
 #endif
@@ -2369,6 +2431,152 @@ Result Compiler::buildComputePipelineInternal(ComputeContext *computeContext,
   return result;
 }
 
+// =====================================================================================================================
+// Estimates the cost of running a compiled compute pipeline from its PAL metadata and code size. Lower is better. The
+// model only ranks variants of the same shader: it charges the code size per lane, divided by how well the achievable
+// occupancy hides latency, and doubles the cost when the shader spills to scratch.
+//
+// @param gfxIp : Graphics IP version the pipeline was compiled for
+// @param pipelineElf : Compiled pipeline ELF
+// @param [out] outs : Stream receiving a one-line summary of the metadata the cost is based on
+static double estimateComputePipelineCost(GfxIpVersion gfxIp, const ElfPackage &pipelineElf, raw_ostream &outs) {
+  ElfWriter<Elf64> writer(gfxIp);
+  if (writer.ReadFromBuffer(pipelineElf.data(), pipelineElf.size()) != Result::Success)
+    return std::numeric_limits<double>::max();
+
+  ElfNote metaNote = writer.getNote(Abi::MetadataNoteType);
+  msgpack::Document document;
+  if (!document.readFromBlob(StringRef(reinterpret_cast<const char *>(metaNote.data), metaNote.hdr.descSize), false))
+    return std::numeric_limits<double>::max();
+  auto pipeline = document.getRoot().getMap(true)[PalAbi::CodeObjectMetadataKey::Pipelines].getArray(true)[0];
+  auto hwStages = pipeline.getMap(true)[PalAbi::PipelineMetadataKey::HardwareStages].getMap(true);
+  auto csStage = hwStages[".cs"].getMap(true);
+  auto getUInt = [&](StringRef key) -> uint64_t {
+    auto it = csStage.find(key);
+    return it != csStage.end() && it->second.getKind() == msgpack::Type::UInt ? it->second.getUInt() : 0;
+  };
+
+  const uint64_t vgprCount = std::max<uint64_t>(getUInt(PalAbi::HardwareStageMetadataKey::VgprCount), 1);
+  const uint64_t sgprCount = getUInt(PalAbi::HardwareStageMetadataKey::SgprCount);
+  const uint64_t ldsSize = getUInt(PalAbi::HardwareStageMetadataKey::LdsSize);
+  const uint64_t scratchSize = getUInt(PalAbi::HardwareStageMetadataKey::ScratchMemorySize);
+  uint64_t waveSize = getUInt(PalAbi::HardwareStageMetadataKey::WavefrontSize);
+  if (waveSize == 0)
+    waveSize = 64;
+
+  uint64_t threadsPerGroup = 1;
+  auto threadgroupDims = csStage.find(StringRef(PalAbi::HardwareStageMetadataKey::ThreadgroupDimensions));
+  if (threadgroupDims != csStage.end() && threadgroupDims->second.isArray()) {
+    for (auto &dim : threadgroupDims->second.getArray())
+      threadsPerGroup *= std::max<uint64_t>(dim.getUInt(), 1);
+  }
+
+  const void *text = nullptr;
+  size_t textSize = 0;
+  if (writer.getSectionData(".text", &text, &textSize) != Result::Success)
+    textSize = 0;
+
+  // Use the same occupancy model as the static performance report.
+  const uint64_t occupancy =
+      lgc::estimateWaveOccupancy(gfxIp.major, waveSize, vgprCount, sgprCount, ldsSize, threadsPerGroup);
+
+  // Beyond a handful of waves per SIMD, more occupancy stops buying latency hiding.
+  constexpr uint64_t SaturatingOccupancy = 8;
+  const double latencyHiding = double(std::min(occupancy, SaturatingOccupancy)) / SaturatingOccupancy;
+  // On GFX10+ a wave64 VALU instruction issues in two passes over a SIMD32, so the issue cost per lane is the same for
+  // both wave sizes and only scalar work is amortized over more lanes in wave64.
+  const double passes = gfxIp.major >= 10 && waveSize == 64 ? 2.0 : 1.0;
+  double cost = (std::max<size_t>(textSize, 4) / 4.0) * passes / waveSize / latencyHiding;
+  if (scratchSize != 0)
+    cost *= 2.0;
+
+  outs << "wave" << waveSize << " vgprs=" << vgprCount << " sgprs=" << sgprCount << " lds=" << ldsSize
+       << " scratch=" << scratchSize << " code=" << textSize << " occupancy=" << occupancy
+       << format(" cost=%.4f", cost);
+  return cost;
+}
+
+// =====================================================================================================================
+// Build compute pipeline under several wave-size and VGPR-limit variants, and keep the one with the lowest cost as
+// estimated by estimateComputePipelineCost. Only options the application left at their defaults are varied.
+//
+// @param pipelineInfo : Info to build this compute pipeline
+// @param pipelineHash : Pipeline hash of the original pipeline info, stamped into every variant
+// @param buildingRelocatableElf : Build the pipeline by linking relocatable elf
+// @param [out] pipelineElf : Output Elf package
+// @param [out] stageCacheAccess : Compute shader stage cache access result
+Result Compiler::buildComputePipelineAutoTuned(const ComputePipelineBuildInfo *pipelineInfo,
+                                               const MetroHash::Hash *pipelineHash, bool buildingRelocatableElf,
+                                               ElfPackage *pipelineElf, CacheAccessInfo *stageCacheAccess) {
+  const PipelineShaderOptions &options = pipelineInfo->cs.options;
+  const auto *moduleData = reinterpret_cast<const ShaderModuleData *>(pipelineInfo->cs.pModuleData);
+
+  // Ray query shaders always use the ray tracing wave size, and GFX9 only has wave64.
+  SmallVector<unsigned, 2> waveSizes = {options.waveSize};
+  if (options.waveSize == 0 && m_gfxIp.major >= 10 && !moduleData->usage.enableRayQuery)
+    waveSizes = {32, 64};
+  SmallVector<unsigned, 4> vgprLimits = {options.vgprLimit};
+  if (options.vgprLimit == 0 || options.vgprLimit == UINT_MAX)
+    vgprLimits.append(cl::AutoTuneVgprLimits.begin(), cl::AutoTuneVgprLimits.end());
+
+  struct Variant {
+    ComputePipelineBuildInfo pipelineInfo;
+    ElfPackage pipelineElf;
+    CacheAccessInfo stageCacheAccess;
+    Result result;
+    double cost;
+    std::string summary;
+  };
+  std::vector<Variant> variants;
+  for (unsigned waveSize : waveSizes) {
+    for (unsigned vgprLimit : vgprLimits) {
+      Variant &variant = variants.emplace_back();
+      variant.pipelineInfo = *pipelineInfo;
+      variant.pipelineInfo.cs.options.waveSize = waveSize;
+      variant.pipelineInfo.cs.options.vgprLimit = vgprLimit;
+      variant.stageCacheAccess = CacheAccessInfo::CacheNotChecked;
+      variant.result = Result::ErrorUnavailable;
+      variant.cost = std::numeric_limits<double>::max();
+    }
+  }
+
+  // Variants are independent compiles, each on its own context from the pool. Each variant has its own cache hash, so
+  // the variants do not share shader cache entries, but they all carry the pipeline hash of the original pipeline info:
+  // that is the hash the application and tools know the pipeline by, whichever variant is picked.
+  auto buildVariant = [this, pipelineHash, buildingRelocatableElf](Variant &variant) -> Error {
+    MetroHash::Hash cacheHash = PipelineDumper::generateHashForComputePipeline(&variant.pipelineInfo, true);
+    MetroHash::Hash originalPipelineHash = *pipelineHash;
+    ComputeContext computeContext(m_gfxIp, &variant.pipelineInfo, &originalPipelineHash, &cacheHash);
+    variant.result = buildComputePipelineInternal(&computeContext, &variant.pipelineInfo, buildingRelocatableElf,
+                                                  &variant.pipelineElf, &variant.stageCacheAccess);
+    if (variant.result == Result::Success) {
+      raw_string_ostream summary(variant.summary);
+      variant.cost = estimateComputePipelineCost(m_gfxIp, variant.pipelineElf, summary);
+    }
+    return Error::success();
+  };
+  cantFail(parallelFor(cl::AutoTuneThreads, variants, buildVariant));
+
+  // Keep the cheapest variant; on a tie the earlier one, which has the larger register budget.
+  Variant *best = nullptr;
+  for (Variant &variant : variants) {
+    LLPC_OUTS("Auto-tune variant wave-size=" << variant.pipelineInfo.cs.options.waveSize
+                                             << " vgpr-limit=" << variant.pipelineInfo.cs.options.vgprLimit << ": "
+                                             << (variant.result == Result::Success ? variant.summary : "failed")
+                                             << "\n");
+    if (variant.result == Result::Success && (!best || variant.cost < best->cost))
+      best = &variant;
+  }
+  if (!best)
+    return variants.front().result;
+
+  LLPC_OUTS("Auto-tune picked wave-size=" << best->pipelineInfo.cs.options.waveSize
+                                          << " vgpr-limit=" << best->pipelineInfo.cs.options.vgprLimit << "\n");
+  *pipelineElf = std::move(best->pipelineElf);
+  *stageCacheAccess = best->stageCacheAccess;
+  return Result::Success;
+}
+
 // =====================================================================================================================
 // Build compute pipeline from the specified info.
 //
@@ -2417,9 +2625,15 @@ Result Compiler::BuildComputePipeline(const ComputePipelineBuildInfo *pipelineIn
   ElfPackage candidateElf;
   if (!cacheAccessor || !cacheAccessor->isInCache()) {
     LLPC_OUTS("Cache miss for compute pipeline.\n");
-    ComputeContext computeContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
-    result = buildComputePipelineInternal(&computeContext, pipelineInfo, buildUsingRelocatableElf, &candidateElf,
-                                          &pipelineOut->stageCacheAccess);
+    if (cl::AutoTuneCompute) {
+      // The chosen variant is stored under the original cache hash, so later builds reuse the decision.
+      result = buildComputePipelineAutoTuned(pipelineInfo, &pipelineHash, buildUsingRelocatableElf, &candidateElf,
+                                             &pipelineOut->stageCacheAccess);
+    } else {
+      ComputeContext computeContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
+      result = buildComputePipelineInternal(&computeContext, pipelineInfo, buildUsingRelocatableElf, &candidateElf,
+                                            &pipelineOut->stageCacheAccess);
+    }
 
     if (cacheAccessor && pipelineOut->pipelineCacheAccess == CacheAccessInfo::CacheNotChecked)
       pipelineOut->pipelineCacheAccess = CacheAccessInfo::CacheMiss;
@@ -2804,6 +3018,11 @@ void helperThreadBuildRayTracingPipelineElf(IHelperThreadProvider *helperThreadP
     // context here to ensure we can do the work simultaneously. We achieve this by outputting the module as bitcode and
     // read it back in another context.
     Module *originalModule = helperThreadPayload->modules[moduleIndex];
+    if (!originalModule) {
+      // Dropped as a duplicate
+      helperThreadProvider->TaskCompleted();
+      continue;
+    }
 
     // FIXME: There will be out of sync assertion when the main thread is doing something related to context (probably
     // in PipelineState::generate), and the helper thread is using bitcode writer, we need to find a decent solution for
@@ -2884,6 +3103,65 @@ private:
   std::mutex m_lock;
 };
 
+// =====================================================================================================================
+// Drop lowered ray-tracing shader modules that are structurally identical to an earlier one, so that each distinct
+// shader is only compiled once. A dropped module is reset to null rather than removed, so that every remaining module
+// keeps its index: the index is the shader ID and is hashed into the pipeline options of the shader. The first (entry)
+// module is never dropped, nor is the last one if keepLast is set.
+//
+// @param [in/out] modules : Lowered modules
+// @param moduleCallsTraceRay : Whether each module other than the first calls OpTraceRay
+// @param keepLast : Whether the last module must stay unique
+// @returns : For each module, the index of the module compiled for it; empty if none was dropped
+static SmallVector<unsigned> dedupRayTracingModules(std::vector<std::unique_ptr<Module>> &modules,
+                                                    const std::vector<bool> &moduleCallsTraceRay, bool keepLast) {
+  SmallVector<unsigned> compiledIndices(modules.size());
+  DenseMap<uint64_t, SmallVector<unsigned, 2>> candidates;
+  bool droppedAny = false;
+
+  for (unsigned moduleIndex = 0; moduleIndex < modules.size(); ++moduleIndex) {
+    compiledIndices[moduleIndex] = moduleIndex;
+    if (moduleIndex == 0 || (keepLast && moduleIndex == modules.size() - 1))
+      continue;
+
+    auto &bucket = candidates[getStructuralHash(*modules[moduleIndex])];
+    auto original = find_if(bucket, [&](unsigned keptIndex) {
+      return moduleCallsTraceRay[keptIndex - 1] == moduleCallsTraceRay[moduleIndex - 1] &&
+             isStructurallyEqual(*modules[keptIndex], *modules[moduleIndex]);
+    });
+    if (original == bucket.end()) {
+      bucket.push_back(moduleIndex);
+      continue;
+    }
+    compiledIndices[moduleIndex] = *original;
+    modules[moduleIndex] = nullptr;
+    droppedAny = true;
+  }
+
+  if (!droppedAny)
+    compiledIndices.clear();
+  return compiledIndices;
+}
+
+// =====================================================================================================================
+// Fill in the outputs of the modules dropped by dedupRayTracingModules. A dropped shader gets a copy of the ELF of the
+// shader it duplicates, and its property names that shader's entry symbol in it. The copies keep the output at one
+// ELF per shader as the interface requires, so deduplication saves compile time, not output size.
+//
+// @param compiledIndices : Result of dedupRayTracingModules
+// @param [in/out] pipelineElfs : ELF packages
+// @param [in/out] shaderProps : Shader properties
+static void expandDedupedRayTracingOutputs(ArrayRef<unsigned> compiledIndices, std::vector<ElfPackage> &pipelineElfs,
+                                           std::vector<RayTracingShaderProperty> &shaderProps) {
+  for (auto [moduleIndex, compiledIndex] : enumerate(compiledIndices)) {
+    if (compiledIndex == moduleIndex)
+      continue;
+    pipelineElfs[moduleIndex] = pipelineElfs[compiledIndex];
+    shaderProps[moduleIndex - 1] = shaderProps[compiledIndex - 1];
+    shaderProps[moduleIndex - 1].shaderId = moduleIndex;
+  }
+}
+
 // =====================================================================================================================
 // Build raytracing pipeline internally
 //
@@ -3077,6 +3355,12 @@ Result Compiler::buildRayTracingPipelineInternal(RayTracingContext &rtContext,
     newModules.erase(newModules.begin() + 1, newModules.end());
   }
 
+  // Compile each group of structurally identical shaders once. This is only possible in indirect mode, where every
+  // shader is a separate ELF.
+  SmallVector<unsigned> compiledIndices;
+  if (indirectStageMask != 0 && cl::DedupRtShaders)
+    compiledIndices = dedupRayTracingModules(newModules, moduleCallsTraceRay, needTraversal);
+
   rtContext.setLinked(true);
   pipelineElfs.resize(newModules.size());
   shaderProps.resize(newModules.size() - 1);
@@ -3105,6 +3389,11 @@ Result Compiler::buildRayTracingPipelineInternal(RayTracingContext &rtContext,
     unsigned moduleIndex = 0;
 
     while (!helperThreadPayload.helperThreadJoined && helperThreadProvider->GetNextTask(&moduleIndex)) {
+      // Skip modules dropped as duplicates
+      if (!newModules[moduleIndex]) {
+        helperThreadProvider->TaskCompleted();
+        continue;
+      }
       // NOTE: When a helper thread joins, it will move modules from the original context into a new one. However,
       // main thread may be processing on the original context at the same time, results in out of sync situation.
       // Here we keep main thread working on the original context until helper thread joins, to reduce the cost of
@@ -3135,6 +3424,8 @@ Result Compiler::buildRayTracingPipelineInternal(RayTracingContext &rtContext,
 
   } else {
     for (auto [moduleIndex, module] : llvm::enumerate(newModules)) {
+      if (!module)
+        continue; // Dropped as a duplicate
       Result result = buildRayTracingPipelineElf(mainContext, std::move(module), pipelineElfs[moduleIndex], shaderProps,
                                                  moduleCallsTraceRay, moduleIndex, pipeline, timerProfiler);
       if (result != Result::Success)
@@ -3142,6 +3433,9 @@ Result Compiler::buildRayTracingPipelineInternal(RayTracingContext &rtContext,
     }
   }
 
+  if (!compiledIndices.empty())
+    expandDedupedRayTracingOutputs(compiledIndices, pipelineElfs, shaderProps);
+
   return hasError ? Result::ErrorInvalidShader : Result::Success;
 }
 
@@ -3275,7 +3569,10 @@ Result Compiler::validatePipelineShaderInfo(const PipelineShaderInfo *shaderInfo
     if (moduleData->binType == BinaryType::Spirv) {
       auto spirvBin = &moduleData->binCode;
       if (shaderInfo->pEntryTarget) {
-        unsigned stageMask = ShaderModuleHelper::getStageMaskFromSpirvBinary(spirvBin, shaderInfo->pEntryTarget);
+        const void *spirvIndex = ShaderModuleHelper::getSpirvIndex(moduleData);
+        unsigned stageMask =
+            spirvIndex ? SpirvModuleIndex::fromBlob(spirvIndex).getStageMask(*spirvBin, shaderInfo->pEntryTarget)
+                       : ShaderModuleHelper::getStageMaskFromSpirvBinary(spirvBin, shaderInfo->pEntryTarget);
 
         if ((stageMask & shaderStageToMask(shaderStage)) == 0) {
           LLPC_ERRS("Fail to find entry-point " << shaderInfo->pEntryTarget << " for "
@@ -3445,6 +3742,9 @@ bool Compiler::linkRelocatableShaderElf(ElfPackage *shaderElfs, ElfPackage *pipe
   context->getPipelineContext()->setPipelineState(&*pipeline, /*hasher=*/nullptr, /*unlinked=*/false);
 
   // Create linker, passing ELFs to it.
+  // TODO: Every link lays out and relocates all the stage ELFs again, even when only the glue shaders differ from an
+  // earlier link. Caching a prelinked stage (final section layout and resolved relocations) keyed by its stage hash
+  // would reduce such a link to copying the stage and patching the glue.
   SmallVector<MemoryBufferRef, 3> elfs;
   for (auto stage : enumRange<UnlinkedShaderStage>()) {
     if (!shaderElfs[stage].empty())
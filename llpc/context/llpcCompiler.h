@@ -187,6 +187,9 @@ private:
   bool canUseRelocatableGraphicsShaderElf(const llvm::ArrayRef<const PipelineShaderInfo *> &shaderInfo,
                                           const GraphicsPipelineBuildInfo *pipelineInfo);
   bool canUseRelocatableComputeShaderElf(const ComputePipelineBuildInfo *pipelineInfo);
+  Result buildComputePipelineAutoTuned(const ComputePipelineBuildInfo *pipelineInfo,
+                                       const MetroHash::Hash *pipelineHash, bool buildingRelocatableElf,
+                                       ElfPackage *pipelineElf, CacheAccessInfo *stageCacheAccess);
   Result buildRayTracingPipelineInternal(RayTracingContext &rtContext,
                                          llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo, bool unlinked,
                                          std::vector<ElfPackage> &pipelineElfs,
@@ -68,6 +68,7 @@
 #include "llvm/Transforms/IPO/AlwaysInliner.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include <atomic>
 
 #define DEBUG_TYPE "llpc-context"
 
@@ -78,6 +79,23 @@ using namespace lgc::cps;
 
 namespace Llpc {
 
+// Number of parsed library modules cached by all contexts. A cached module belongs to the LLVMContext of the context
+// that parsed it, so the modules cannot be shared, but the memory they take is bounded across the whole context pool.
+static std::atomic<unsigned> CachedLibraryCount{0};
+
+// =====================================================================================================================
+// Takes one slot of the process-wide library cache budget.
+//
+// @returns : True if a slot was taken, false if the budget is used up
+static bool reserveLibraryCacheSlot() {
+  unsigned count = CachedLibraryCount.load();
+  do {
+    if (count >= Context::MaxCachedLibraries)
+      return false;
+  } while (!CachedLibraryCount.compare_exchange_weak(count, count + 1));
+  return true;
+}
+
 // =====================================================================================================================
 //
 // @param gfxIp : Graphics IP version info
@@ -90,6 +108,13 @@ Context::Context(GfxIpVersion gfxIp) : LLVMContext(), m_gfxIp(gfxIp) {
 
 // =====================================================================================================================
 Context::~Context() {
+  CachedLibraryCount -= m_libraryCache.size();
+}
+
+// =====================================================================================================================
+// Returns the number of parsed library modules currently cached by all contexts.
+unsigned Context::getCachedLibraryCount() {
+  return CachedLibraryCount.load();
 }
 
 // =====================================================================================================================
@@ -174,8 +199,20 @@ CodeGenOptLevel Context::getLastOptimizationLevel() const {
 // =====================================================================================================================
 // Loads library from external LLVM library.
 //
+// The bitcode is read lazily and only the function bodies that can be reached from the pipeline's entry points and
+// global initializers are materialized. Functions that nothing reaches are dropped without ever being parsed. The
+// resulting module is cached in this context, keyed by the hash of the bitcode, and later loads of the same library
+// return a clone of the cached module. At most MaxCachedLibraries modules are cached over all contexts.
+//
 // @param lib : Bitcodes of external LLVM library
 std::unique_ptr<Module> Context::loadLibrary(const BinaryData *lib) {
+  MetroHash::Hash hash = {};
+  MetroHash64::Hash(static_cast<const uint8_t *>(lib->pCode), lib->codeSize, hash.bytes);
+
+  auto cached = m_libraryCache.find(hash);
+  if (cached != m_libraryCache.end())
+    return CloneModule(*cached->second);
+
   auto memBuffer =
       MemoryBuffer::getMemBuffer(StringRef(static_cast<const char *>(lib->pCode), lib->codeSize), "", false);
 
@@ -185,17 +222,65 @@ std::unique_ptr<Module> Context::loadLibrary(const BinaryData *lib) {
   if (!moduleOrErr) {
     Error error = moduleOrErr.takeError();
     LLPC_ERRS("Fails to load LLVM bitcode \n");
-  } else {
-    libModule = std::move(*moduleOrErr);
-    if (Error errCode = libModule->materializeAll()) {
-      LLPC_ERRS("Fails to materialize \n");
-      libModule = nullptr;
-    }
+    return nullptr;
+  }
+
+  libModule = std::move(*moduleOrErr);
+  if (Error errCode = materializeReachableFunctions(*libModule)) {
+    LLPC_ERRS("Fails to materialize \n");
+    return nullptr;
+  }
+
+  // When the budget is used up, reuse the slot of one of this context's own entries. Entries of other contexts cannot
+  // be dropped from here, as those contexts may be in use on other threads.
+  if (reserveLibraryCacheSlot()) {
+    m_libraryCache[hash] = CloneModule(*libModule);
+  } else if (!m_libraryCache.empty()) {
+    m_libraryCache.erase(m_libraryCache.begin());
+    m_libraryCache[hash] = CloneModule(*libModule);
   }
 
   return libModule;
 }
 
+// =====================================================================================================================
+// Materializes the function bodies of a lazily loaded module on demand. A body is materialized if the function is a
+// pipeline entry point (external linkage, as getEntryPoints() sees it, or DLL-exported, as lgc::isShaderEntryPoint()
+// sees it) or is referenced from something that has already been loaded. Any use counts, not only direct calls: a
+// function whose address is taken, or that is referred to from a constant or from metadata, is kept. Global
+// initializers and module-level metadata are always loaded eagerly, so functions they refer to count as referenced.
+// Functions that have no use and no metadata reference at the fixpoint, such as unused linkonce or internal helpers,
+// are erased without being parsed. On return, the module's materializer has been released.
+//
+// @param [in/out] module : Lazily loaded module
+Error Context::materializeReachableFunctions(Module &module) {
+  auto isEntryPoint = [](const Function &func) {
+    return func.getLinkage() == GlobalValue::ExternalLinkage || func.hasDLLExportStorageClass();
+  };
+  auto isReferenced = [](const Function &func) { return !func.use_empty() || func.isUsedByMetadata(); };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Function &func : module) {
+      if (!func.isMaterializable() || (!isEntryPoint(func) && !isReferenced(func)))
+        continue;
+      if (Error errCode = func.materialize())
+        return errCode;
+      changed = true;
+    }
+  }
+
+  // Only unreachable bodies are left unmaterialized, and nothing that was loaded refers to them.
+  for (Function &func : make_early_inc_range(module)) {
+    if (func.isMaterializable() && !isReferenced(func))
+      func.eraseFromParent();
+  }
+
+  // Nothing should be left to materialize; this also drops the materializer and its reference to the bitcode buffer.
+  return module.materializeAll();
+}
+
 // =====================================================================================================================
 // Sets triple and data layout in specified module from the context's target machine.
 //
@@ -35,7 +35,9 @@
 #include "lgc/LgcContext.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Target/TargetMachine.h"
 #include <unordered_map>
 #include <unordered_set>
@@ -96,6 +98,12 @@ public:
 
   std::unique_ptr<llvm::Module> loadLibrary(const BinaryData *lib);
 
+  // Maximum number of parsed library modules cached by loadLibrary(), summed over all contexts in the process.
+  static constexpr unsigned MaxCachedLibraries = 4;
+
+  // Returns the number of parsed library modules currently cached by all contexts.
+  static unsigned getCachedLibraryCount();
+
   // Wrappers of interfaces of pipeline context
   PipelineType getPipelineType() const { return m_pipelineContext->getPipelineType(); }
 
@@ -129,6 +137,8 @@ private:
   Context(const Context &) = delete;
   Context &operator=(const Context &) = delete;
 
+  llvm::Error materializeReachableFunctions(llvm::Module &module);
+
   GfxIpVersion m_gfxIp;                                 // Graphics IP version info
   PipelineContext *m_pipelineContext;                   // Pipeline-specific context
   bool m_isInUse = false;                               // Whether this context is in use
@@ -148,6 +158,11 @@ private:
 
   unsigned m_useCount = 0; // Number of times this context is used.
 
+  // Parsed library modules, keyed by the hash of their bitcode. loadLibrary() returns clones of these, so repeated
+  // loads of the same library in a pooled context skip bitcode parsing. Each entry takes one slot of the process-wide
+  // MaxCachedLibraries budget.
+  std::unordered_map<MetroHash::Hash, std::unique_ptr<llvm::Module>> m_libraryCache;
+
   struct GpurtKey {
     unsigned gpurtFeatureFlags;
     bool hwIntersectRay;
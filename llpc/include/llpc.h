@@ -275,6 +275,17 @@ public:
   /// @returns : True if the specified format is supported by fetch shader. Otherwise, FALSE is returned.
   static bool VKAPI_CALL IsVertexFormatSupported(VkFormat format);
 
+  /// Writes a JSON static performance report of a pipeline ELF: per hardware stage register, LDS and scratch usage,
+  /// estimated occupancy, instruction mix, waterfall loops and spills.
+  ///
+  /// @param [in]  pPipelineBin  Pipeline ELF binary, as returned in a pipeline build output
+  /// @param [out] pBuffer       Buffer receiving the null-terminated report, or nullptr to query the size
+  /// @param [in]  bufferSize    Size of pBuffer in bytes
+  ///
+  /// @returns : Size in bytes of the full report including the null terminator. The report is truncated if this is
+  ///            larger than bufferSize. Returns 0 if pPipelineBin is not a well-formed pipeline ELF.
+  static size_t VKAPI_CALL GetPerfReport(const BinaryData *pPipelineBin, char *pBuffer, size_t bufferSize);
+
   /// Destroys the pipeline compiler.
   virtual void VKAPI_CALL Destroy() = 0;
 
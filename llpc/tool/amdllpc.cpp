@@ -46,6 +46,7 @@
 #ifndef LLPC_DISABLE_SPVGEN
 #include "spvgen.h"
 #endif
+#include "vfx.h"
 #include "vkgcCapability.h"
 #include "vkgcExtension.h"
 #include "lgc/LgcContext.h"
@@ -303,6 +304,11 @@ cl::opt<bool> DumpDuplicatePipelines(
     "dump-duplicate-pipelines",
     cl::desc("If TRUE, duplicate pipelines will be dumped to a file with a numeric suffix attached"), cl::init(false));
 
+// -perf-report: write a JSON static performance report of each output pipeline ELF
+cl::opt<bool> PerfReport("perf-report",
+                         cl::desc("Write a JSON static performance report of each pipeline ELF to <output>.perf.json"),
+                         cl::init(false));
+
 // -llpc_opt: Override the optimization level passed in to LGC with the given one.  This options is the same as the
 // `-opt` option in lgc.  The reason for the second option is to be able to test the LLPC API.  If both options are set
 // then `-opt` wins.
@@ -361,6 +367,12 @@ LlpcRaytracingModeSetting("llpc-raytracing-mode", cl::init(LlpcRaytracingMode::L
 cl::opt<bool> EnableColorExportShader("enable-color-export-shader",
                                       cl::desc("Enable color export shader, only compile each stage of the pipeline without linking"),
                                       cl::init(false));
+
+// -vfx-shader-cache-dir: directory caching the SPIR-V translated from shader source in .pipe files
+cl::opt<std::string> VfxShaderCacheDir("vfx-shader-cache-dir",
+                                       cl::desc("Directory in which to cache SPIR-V assembled or compiled from shader "
+                                                "source in .pipe files, to skip the translation on later runs"),
+                                       cl::value_desc("dir"), cl::init(""));
 } // namespace
 // clang-format on
 namespace llvm {
@@ -513,6 +525,9 @@ static Result init(int argc, char *argv[], ICompiler *&compiler, ShaderCacheWrap
   }
 #endif
 
+  if (!VfxShaderCacheDir.empty())
+    Vfx::vfxSetShaderCacheDir(VfxShaderCacheDir.c_str());
+
   // Check to see that the ParsedGfxIp is valid
   std::string gfxIpName = lgc::LgcContext::getGpuNameString(ParsedGfxIp.major, ParsedGfxIp.minor, ParsedGfxIp.stepping);
   if (!lgc::LgcContext::isGpuNameValid(gfxIpName)) {
@@ -782,6 +797,7 @@ static Error processInputs(ICompiler *compiler, InputSpecGroup &inputSpecs) {
 
   std::unique_ptr<PipelineBuilder> builder =
       createPipelineBuilder(*compiler, compileInfo, dumpOptions, TimePassesIsEnabled || cl::EnableTimerProfile);
+  builder->setPerfReport(PerfReport);
   if (Error err = builder->build())
     return err;
 
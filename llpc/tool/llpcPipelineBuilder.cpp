@@ -61,6 +61,7 @@
 #include "llpcCompilationUtils.h"
 #include "llpcComputePipelineBuilder.h"
 #include "llpcDebug.h"
+#include "llpcError.h"
 #include "llpcGraphicsPipelineBuilder.h"
 #include "llpcRayTracingPipelineBuilder.h"
 #include "llpcUtil.h"
@@ -169,7 +170,23 @@ Error PipelineBuilder::outputElf(const BinaryData &pipelineBin, const StringRef
     sys::path::replace_extension(outFileName, ext);
   }
 
-  return writeFile(pipelineBin, outFileName);
+  if (Error err = writeFile(pipelineBin, outFileName))
+    return err;
+
+  // The performance report is only available for ELF binaries, not for ISA text or LLVM bitcode.
+  if (!m_perfReport || !isElfBinary(pipelineBin.pCode, pipelineBin.codeSize))
+    return Error::success();
+
+  size_t reportSize = ICompiler::GetPerfReport(&pipelineBin, nullptr, 0);
+  if (reportSize == 0)
+    return createResultError(Result::ErrorInvalidValue,
+                             Twine("Failed to produce performance report for ") + outFileName);
+  std::string report(reportSize, '\0');
+  ICompiler::GetPerfReport(&pipelineBin, report.data(), report.size());
+  report.pop_back();
+
+  std::string reportFileName = outFileName == "-" ? "-" : (Twine(outFileName) + ".perf.json").str();
+  return writeFile({report.size(), report.data()}, reportFileName);
 }
 
 } // namespace StandaloneCompiler
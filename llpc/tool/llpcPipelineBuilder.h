@@ -103,6 +103,11 @@ public:
   // @returns : `true` is pipeline dumps were requested, `false` if not.
   LLPC_NODISCARD bool shouldDumpPipelines() const { return m_dumpOptions.has_value(); }
 
+  // Requests a JSON static performance report next to each output ELF.
+  //
+  // @param perfReport : Whether to write `<output file>.perf.json` for each pipeline ELF.
+  void setPerfReport(bool perfReport) { m_perfReport = perfReport; }
+
   // Runs optional pre-build code (pipeline dumping, pipeline info printing).
   LLPC_NODISCARD void *runPreBuildActions(Vkgc::PipelineBuildInfo buildInfo);
 
@@ -122,6 +127,7 @@ private:
   CompileInfo &m_compileInfo;
   std::optional<Vkgc::PipelineDumpOptions> m_dumpOptions = {};
   bool m_printPipelineInfo = false;
+  bool m_perfReport = false;
 };
 
 } // namespace StandaloneCompiler
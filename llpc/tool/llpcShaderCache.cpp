@@ -627,6 +627,13 @@ Result ShaderCache::retrieveShader(CacheEntryHandle hEntry, const void **ppBlob,
   return *size > 0 ? Result::Success : Result::ErrorUnknown;
 }
 
+// =====================================================================================================================
+// Returns the lock-hold statistics collected since setCollectLockStats(true) was called.
+ShaderCache::LockStats ShaderCache::getLockStats() {
+  std::lock_guard<sys::Mutex> lock(m_lock);
+  return m_lockStats;
+}
+
 // =====================================================================================================================
 // Adds data for a new shader to the on-disk file
 //
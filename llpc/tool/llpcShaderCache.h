@@ -35,6 +35,7 @@
 #include "llpcUtil.h"
 #include "vkgcMetroHash.h"
 #include "llvm/Support/Mutex.h"
+#include <chrono>
 #include <condition_variable>
 #include <list>
 #include <mutex>
@@ -205,6 +206,17 @@ public:
 
   LLPC_NODISCARD Result waitForEntry(CacheEntryHandle hEntry);
 
+  // Statistics on how long the cache map lock has been held, collected only while enabled.
+  struct LockStats {
+    uint64_t acquisitions;    // Number of times the lock has been taken
+    uint64_t holdNanoseconds; // Total time the lock has been held
+  };
+
+  // Enables or disables lock-hold statistics. Must not be called while other threads use the cache.
+  void setCollectLockStats(bool collect) { m_collectLockStats = collect; }
+
+  LockStats getLockStats();
+
 private:
   ShaderCache(const ShaderCache &) = delete;
   ShaderCache &operator=(const ShaderCache &) = delete;
@@ -223,10 +235,22 @@ private:
   void *getCacheSpace(size_t numBytes);
 
   // Lock cache map
-  void lockCacheMap(bool readOnly) { m_lock.lock(); }
+  void lockCacheMap(bool readOnly) {
+    m_lock.lock();
+    if (m_collectLockStats)
+      m_lockAcquireTime = std::chrono::steady_clock::now();
+  }
 
   // Unlock cache map
-  void unlockCacheMap(bool readOnly) { m_lock.unlock(); }
+  void unlockCacheMap(bool readOnly) {
+    if (m_collectLockStats) {
+      m_lockStats.holdNanoseconds +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_lockAcquireTime)
+              .count();
+      ++m_lockStats.acquisitions;
+    }
+    m_lock.unlock();
+  }
 
   // Satisfies `BasicLockable`, so that we can pass it to `std::condition_variable_any::wait`.
   // Does *not* automatically lock/unlock on construction/destruction.
@@ -273,6 +297,10 @@ private:
   ShaderCacheStoreValue m_storeValueFunc;          // StoreValue function used to store shader data in an external cache
   GfxIpVersion m_gfxIp;                            // Graphics IP version info
   MetroHash::Hash m_hash;                          // Hash code of compilation options
+
+  bool m_collectLockStats = false;                         // Whether to collect lock-hold statistics
+  LockStats m_lockStats = {};                              // Lock-hold statistics, guarded by m_lock
+  std::chrono::steady_clock::time_point m_lockAcquireTime; // When m_lock was last taken, guarded by m_lock
 };
 
 } // namespace Llpc
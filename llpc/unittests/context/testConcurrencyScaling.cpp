@@ -0,0 +1,348 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+
+// Concurrency stress and scalability harness for the structures shared between compiling threads: the Compiler
+// context pool, ShaderCache, CacheAccessor and parallelFor.
+//
+// By default each component is run with a small number of threads and operations, so that the tests stay cheap and
+// act as stress tests. To collect numbers, run the test binary with e.g.
+//
+//   LlpcContextTests --gtest_filter='ConcurrencyScaling*' -llpc-scaling-report \
+//     -llpc-scaling-threads=1,2,4,8,16,32,64 -llpc-scaling-ops=4096 -llpc-scaling-hit-percent=90 \
+//     -llpc-scaling-entry-size=16384
+//
+// which prints throughput, p50/p99 latency and, where the component exposes it, lock-hold time per operation.
+
+#include "llpc.h"
+#include "llpcCacheAccessor.h"
+#include "llpcCompiler.h"
+#include "llpcContext.h"
+#include "llpcError.h"
+#include "llpcShaderCache.h"
+#include "llpcShaderCacheWrap.h"
+#include "llpcThreading.h"
+#include "vkgcDefs.h"
+#include "vkgcMetroHash.h"
+#include "llvm/ADT/Sequence.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Testing/Support/Error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+// -llpc-scaling-threads: thread counts to run each component with
+static cl::list<unsigned> ScalingThreads("llpc-scaling-threads", cl::desc("Thread counts for the scaling tests"),
+                                         cl::CommaSeparated);
+
+// -llpc-scaling-ops: operations per thread
+static cl::opt<unsigned> ScalingOps("llpc-scaling-ops", cl::desc("Operations per thread for the scaling tests"),
+                                    cl::init(256));
+
+// -llpc-scaling-hit-percent: percentage of cache lookups that hit an existing entry
+static cl::opt<unsigned> ScalingHitPercent("llpc-scaling-hit-percent",
+                                           cl::desc("Percentage of cache lookups that hit in the scaling tests"),
+                                           cl::init(90));
+
+// -llpc-scaling-entry-size: size in bytes of each cache entry
+static cl::opt<unsigned> ScalingEntrySize("llpc-scaling-entry-size",
+                                          cl::desc("Size of each cache entry in bytes for the scaling tests"),
+                                          cl::init(1024));
+
+// -llpc-scaling-report: print the measurements
+static cl::opt<bool> ScalingReport("llpc-scaling-report", cl::desc("Print throughput and latency of scaling tests"),
+                                   cl::init(false));
+
+namespace Llpc {
+namespace {
+
+constexpr GfxIpVersion GfxIp = {10, 1, 0};
+
+using Clock = std::chrono::steady_clock;
+
+// Number of distinct entries each cache is populated with before measuring, used as the hit set.
+constexpr unsigned NumPopulatedEntries = 256;
+
+// Measurements of one component at one thread count.
+struct ScalingResult {
+  size_t numThreads = 0;
+  uint64_t numOps = 0;
+  uint64_t wallNanoseconds = 0;
+  std::vector<uint64_t> latencyNanoseconds; // One sample per operation
+  std::optional<ShaderCache::LockStats> lockStats;
+};
+
+// Returns the thread counts to run with.
+SmallVector<size_t> getThreadCounts() {
+  if (ScalingThreads.empty())
+    return {1, 2, 4, 8};
+  return SmallVector<size_t>(ScalingThreads.begin(), ScalingThreads.end());
+}
+
+// Creates a hash that is unique for the given key.
+MetroHash::Hash hashFromKey(uint64_t key) {
+  MetroHash::Hash hash = {};
+  MetroHash::MetroHash64::Hash(reinterpret_cast<const uint8_t *>(&key), sizeof(key), hash.bytes);
+  hash.dwords[2] = static_cast<uint32_t>(key);
+  hash.dwords[3] = static_cast<uint32_t>(key >> 32);
+  return hash;
+}
+
+// Returns the key for operation opIdx of thread threadIdx: with probability ScalingHitPercent one of the populated
+// entries, otherwise a key that no other operation uses.
+uint64_t pickKey(std::mt19937 &generator, size_t threadIdx, unsigned opIdx) {
+  std::uniform_int_distribution<unsigned> percent(0, 99);
+  if (percent(generator) < ScalingHitPercent)
+    return std::uniform_int_distribution<unsigned>(0, NumPopulatedEntries - 1)(generator);
+  return NumPopulatedEntries + threadIdx * ScalingOps + opIdx;
+}
+
+// Runs op(threadIdx, opIdx) ScalingOps times on each of numThreads threads, all released at the same time, and records
+// the latency of every call.
+template <typename OpT> ScalingResult runThreads(size_t numThreads, OpT op) {
+  ScalingResult result;
+  result.numThreads = numThreads;
+  result.numOps = numThreads * ScalingOps;
+
+  std::vector<std::vector<uint64_t>> latencies(numThreads);
+  std::atomic<size_t> numReady(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (size_t threadIdx = 0; threadIdx != numThreads; ++threadIdx) {
+    threads.emplace_back([&, threadIdx] {
+      std::vector<uint64_t> &samples = latencies[threadIdx];
+      samples.reserve(ScalingOps);
+      ++numReady;
+      while (!go)
+        std::this_thread::yield();
+      for (unsigned opIdx = 0; opIdx != ScalingOps; ++opIdx) {
+        Clock::time_point start = Clock::now();
+        op(threadIdx, opIdx);
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+      }
+    });
+  }
+
+  while (numReady != numThreads)
+    std::this_thread::yield();
+  Clock::time_point start = Clock::now();
+  go = true;
+  for (std::thread &thread : threads)
+    thread.join();
+  result.wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+  for (std::vector<uint64_t> &samples : latencies)
+    result.latencyNanoseconds.insert(result.latencyNanoseconds.end(), samples.begin(), samples.end());
+  return result;
+}
+
+// Returns the given percentile of the latency samples, in nanoseconds.
+uint64_t getPercentile(std::vector<uint64_t> &samples, unsigned percentile) {
+  if (samples.empty())
+    return 0;
+  size_t idx = std::min(samples.size() - 1, samples.size() * percentile / 100);
+  std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+  return samples[idx];
+}
+
+// Prints one line of the report if -llpc-scaling-report is given.
+void report(StringRef component, ScalingResult &result) {
+  if (!ScalingReport)
+    return;
+  double seconds = std::max(result.wallNanoseconds, uint64_t(1)) * 1e-9;
+  outs() << format("%-16s threads=%-3zu ops=%-8llu ops/s=%-12.0f p50=%8.2fus p99=%8.2fus", component.data(),
+                   result.numThreads, static_cast<unsigned long long>(result.numOps), result.numOps / seconds,
+                   getPercentile(result.latencyNanoseconds, 50) * 1e-3,
+                   getPercentile(result.latencyNanoseconds, 99) * 1e-3);
+  if (result.lockStats && result.lockStats->acquisitions != 0) {
+    outs() << format(" lock-hold=%.0fns/acq (%.1f%% of wall)",
+                     double(result.lockStats->holdNanoseconds) / result.lockStats->acquisitions,
+                     100.0 * result.lockStats->holdNanoseconds / std::max(result.wallNanoseconds, uint64_t(1)));
+  }
+  outs() << "\n";
+}
+
+// Creates a runtime ShaderCache populated with the hit set.
+std::unique_ptr<ShaderCache> createPopulatedCache(ArrayRef<char> entry) {
+  ShaderCacheCreateInfo createInfo = {};
+  ShaderCacheAuxCreateInfo auxCreateInfo = {};
+  auxCreateInfo.shaderCacheMode = ShaderCacheMode::ShaderCacheEnableRuntime;
+  auxCreateInfo.gfxIp = GfxIp;
+
+  auto cache = std::make_unique<ShaderCache>();
+  EXPECT_EQ(cache->init(&createInfo, &auxCreateInfo), Result::Success);
+  for (unsigned key = 0; key != NumPopulatedEntries; ++key) {
+    CacheEntryHandle handle = nullptr;
+    EXPECT_EQ(cache->findShader(hashFromKey(key), true, &handle), ShaderEntryState::Compiling);
+    cache->insertShader(handle, entry.data(), entry.size());
+  }
+  return cache;
+}
+
+// Lookups and insertions on ShaderCache::findShader/insertShader/retrieveShader.
+// cppcheck-suppress syntaxError
+TEST(ConcurrencyScalingTest, ShaderCache) {
+  SmallVector<char> entry(ScalingEntrySize);
+  std::iota(entry.begin(), entry.end(), 0);
+
+  for (size_t numThreads : getThreadCounts()) {
+    std::unique_ptr<ShaderCache> cache = createPopulatedCache(entry);
+    cache->setCollectLockStats(true);
+
+    std::vector<std::mt19937> generators;
+    for (size_t threadIdx = 0; threadIdx != numThreads; ++threadIdx)
+      generators.emplace_back(threadIdx);
+    std::atomic<uint64_t> numHits(0);
+    std::atomic<uint64_t> numInsertions(0);
+
+    ScalingResult result = runThreads(numThreads, [&](size_t threadIdx, unsigned opIdx) {
+      MetroHash::Hash hash = hashFromKey(pickKey(generators[threadIdx], threadIdx, opIdx));
+      CacheEntryHandle handle = nullptr;
+      ShaderEntryState state = cache->findShader(hash, true, &handle);
+      if (state == ShaderEntryState::Compiling) {
+        cache->insertShader(handle, entry.data(), entry.size());
+        ++numInsertions;
+        return;
+      }
+      EXPECT_EQ(state, ShaderEntryState::Ready);
+      const void *blob = nullptr;
+      size_t blobSize = 0;
+      EXPECT_EQ(cache->retrieveShader(handle, &blob, &blobSize), Result::Success);
+      EXPECT_EQ(blobSize, entry.size());
+      ++numHits;
+    });
+    result.lockStats = cache->getLockStats();
+    report("ShaderCache", result);
+
+    EXPECT_EQ(numHits + numInsertions, result.numOps);
+    EXPECT_GT(result.lockStats->acquisitions, 0u);
+  }
+}
+
+// Lookups through CacheAccessor on an ICache backed by ShaderCache, as done by the compiler for each pipeline.
+TEST(ConcurrencyScalingTest, CacheAccessor) {
+  SmallVector<char> entry(ScalingEntrySize);
+  std::iota(entry.begin(), entry.end(), 0);
+
+  for (size_t numThreads : getThreadCounts()) {
+    std::unique_ptr<ShaderCache> ownedCache = createPopulatedCache(entry);
+    ShaderCache *cache = ownedCache.get();
+    cache->setCollectLockStats(true);
+    // The wrapper takes ownership of the ShaderCache.
+    ShaderCacheWrap *cacheWrap = new ShaderCacheWrap(ownedCache.release());
+
+    std::vector<std::mt19937> generators;
+    for (size_t threadIdx = 0; threadIdx != numThreads; ++threadIdx)
+      generators.emplace_back(threadIdx);
+    std::atomic<uint64_t> numHits(0);
+    std::atomic<uint64_t> numInsertions(0);
+
+    ScalingResult result = runThreads(numThreads, [&](size_t threadIdx, unsigned opIdx) {
+      MetroHash::Hash hash = hashFromKey(pickKey(generators[threadIdx], threadIdx, opIdx));
+      CacheAccessor accessor(hash, cacheWrap);
+      if (accessor.isInCache()) {
+        EXPECT_EQ(accessor.getElfFromCache().codeSize, entry.size());
+        ++numHits;
+        return;
+      }
+      accessor.setElfInCache({entry.size(), entry.data()});
+      EXPECT_TRUE(accessor.isInCache());
+      ++numInsertions;
+    });
+    result.lockStats = cache->getLockStats();
+    report("CacheAccessor", result);
+
+    EXPECT_EQ(numHits + numInsertions, result.numOps);
+    cacheWrap->Destroy();
+  }
+}
+
+// Compiler::acquireContext/releaseContext on the shared context pool. The pool keeps its contexts across compiler
+// instances, so after the first round every acquire is served from the pool.
+TEST(ConcurrencyScalingTest, ContextPool) {
+  const char *options[] = {"amdllpc"};
+  ICompiler *compilerInterface = nullptr;
+  ASSERT_EQ(ICompiler::Create(GfxIp, 1, options, &compilerInterface), Result::Success);
+  auto *compiler = static_cast<Compiler *>(compilerInterface);
+
+  for (size_t numThreads : getThreadCounts()) {
+    ScalingResult result = runThreads(numThreads, [compiler](size_t, unsigned) {
+      Context *context = compiler->acquireContext();
+      EXPECT_TRUE(context->isInUse());
+      compiler->releaseContext(context);
+    });
+    report("ContextPool", result);
+  }
+
+  compiler->Destroy();
+}
+
+// Dispatch overhead of parallelFor with short tasks. Each operation is one parallelFor call with ScalingOps tasks per
+// thread that hash a cache-entry-sized buffer.
+TEST(ConcurrencyScalingTest, ParallelFor) {
+  SmallVector<uint8_t> data(ScalingEntrySize);
+  std::iota(data.begin(), data.end(), 0);
+  constexpr unsigned NumCalls = 8;
+
+  for (size_t numThreads : getThreadCounts()) {
+    const size_t numTasks = numThreads * ScalingOps;
+    std::atomic<uint64_t> numExecutions(0);
+
+    ScalingResult result;
+    result.numThreads = numThreads;
+    result.numOps = NumCalls * numTasks;
+    Clock::time_point wallStart = Clock::now();
+    for (unsigned call = 0; call != NumCalls; ++call) {
+      Clock::time_point start = Clock::now();
+      Error err = parallelFor(numThreads, seq(size_t(0), numTasks), [&](size_t) -> Error {
+        MetroHash::Hash hash = {};
+        MetroHash::MetroHash64::Hash(data.data(), data.size(), hash.bytes);
+        ++numExecutions;
+        return Error::success();
+      });
+      result.latencyNanoseconds.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+      EXPECT_THAT_ERROR(std::move(err), Succeeded());
+    }
+    result.wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - wallStart).count();
+    report("parallelFor", result);
+
+    EXPECT_EQ(numExecutions, result.numOps);
+  }
+}
+
+} // namespace
+} // namespace Llpc
@@ -0,0 +1,150 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+
+#include "llpc.h"
+#include "llpcContext.h"
+#include "lgc/LgcContext.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gmock/gmock.h"
+
+using namespace lgc;
+using namespace llvm;
+
+namespace Llpc {
+namespace {
+
+constexpr GfxIpVersion GfxIp = {10, 3, 0};
+
+// A pipeline module with one entry point, a helper it calls, a helper whose address it takes, a helper that is only
+// named in metadata, and functions that nothing reaches.
+constexpr const char PipelineIr[] = R"(
+define dllexport void @main() {
+  call void @usedHelper()
+  call void @sink(ptr @addressTakenHelper)
+  ret void
+}
+
+declare void @sink(ptr)
+
+define internal void @usedHelper() {
+  ret void
+}
+
+define internal void @addressTakenHelper() {
+  ret void
+}
+
+define internal void @metadataHelper() {
+  ret void
+}
+
+define internal void @unusedHelper() {
+  ret void
+}
+
+define linkonce_odr void @unusedLinkOnce() {
+  call void @unusedHelper()
+  ret void
+}
+
+!lgc.test.functions = !{!0}
+!0 = !{ptr @metadataHelper}
+)";
+
+// Returns the bitcode of the pipeline module, with the given name for the entry point so that tests can make
+// libraries with different hashes.
+std::string getPipelineBitcode(StringRef entryName = "main") {
+  LLVMContext context;
+  SMDiagnostic error;
+  std::unique_ptr<Module> module = parseAssemblyString(PipelineIr, error, context);
+  EXPECT_TRUE(module);
+  module->getFunction("main")->setName(entryName);
+  std::string bitcode;
+  raw_string_ostream stream(bitcode);
+  WriteBitcodeToFile(*module, stream);
+  stream.flush();
+  return bitcode;
+}
+
+BinaryData getBinaryData(const std::string &bitcode) {
+  BinaryData data = {};
+  data.pCode = bitcode.data();
+  data.codeSize = bitcode.size();
+  return data;
+}
+
+// cppcheck-suppress syntaxError
+TEST(LlpcContextTests, LoadLibraryDropsUnreachableFunctions) {
+  LgcContext::initialize();
+  std::string bitcode = getPipelineBitcode();
+  BinaryData lib = getBinaryData(bitcode);
+  Context context(GfxIp);
+
+  for (unsigned load = 0; load < 2; ++load) {
+    // The second load comes from the cache and must look the same.
+    std::unique_ptr<Module> module = context.loadLibrary(&lib);
+    ASSERT_TRUE(module);
+    ASSERT_TRUE(module->getFunction("main"));
+    EXPECT_FALSE(module->getFunction("main")->isDeclaration());
+    ASSERT_TRUE(module->getFunction("usedHelper"));
+    EXPECT_FALSE(module->getFunction("usedHelper")->isDeclaration());
+    // Functions referenced other than by a direct call must not be dropped.
+    ASSERT_TRUE(module->getFunction("addressTakenHelper"));
+    EXPECT_FALSE(module->getFunction("addressTakenHelper")->isDeclaration());
+    ASSERT_TRUE(module->getFunction("metadataHelper"));
+    EXPECT_FALSE(module->getFunction("metadataHelper")->isDeclaration());
+    EXPECT_FALSE(module->getFunction("unusedHelper"));
+    EXPECT_FALSE(module->getFunction("unusedLinkOnce"));
+  }
+}
+
+TEST(LlpcContextTests, LibraryCacheIsBoundedAcrossContexts) {
+  LgcContext::initialize();
+  std::vector<std::string> bitcodes;
+  for (unsigned i = 0; i < Context::MaxCachedLibraries + 2; ++i)
+    bitcodes.push_back(getPipelineBitcode(("main" + Twine(i)).str()));
+
+  // Contexts of earlier tests are gone, so nothing is cached.
+  ASSERT_EQ(Context::getCachedLibraryCount(), 0u);
+  {
+    Context firstContext(GfxIp);
+    Context secondContext(GfxIp);
+    for (const auto &[index, bitcode] : enumerate(bitcodes)) {
+      BinaryData lib = getBinaryData(bitcode);
+      Context &context = index % 2 == 0 ? firstContext : secondContext;
+      EXPECT_TRUE(context.loadLibrary(&lib));
+      EXPECT_LE(Context::getCachedLibraryCount(), Context::MaxCachedLibraries);
+    }
+    EXPECT_EQ(Context::getCachedLibraryCount(), Context::MaxCachedLibraries);
+  }
+  // Destroying the contexts gives their slots back.
+  EXPECT_EQ(Context::getCachedLibraryCount(), 0u);
+}
+
+} // namespace
+} // namespace Llpc
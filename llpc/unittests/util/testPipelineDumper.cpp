@@ -397,5 +397,126 @@ TEST(PipelineDumperTest, TestForceNonUniformResourceIndexStageMaskCompute) {
   runComputePipelineVariations(modifyBuildInfo, expectHashToBeEqual);
 }
 
+// =====================================================================================================================
+// Returns the cache hash of a compute pipeline with the given shader module and specialization info.
+//
+// @param moduleData : Shader module data of the compute shader
+// @param specializationInfo : Specialization info of the compute shader (may be null)
+MetroHash::Hash getComputeCacheHashWithSpecInfo(const ShaderModuleData &moduleData,
+                                                const VkSpecializationInfo *specializationInfo) {
+  auto buildInfo = std::make_unique<ComputePipelineBuildInfo>();
+  buildInfo->cs.pModuleData = &moduleData;
+  buildInfo->cs.pSpecializationInfo = specializationInfo;
+  return PipelineDumper::generateHashForComputePipeline(buildInfo.get(), /*isCacheHash=*/true);
+}
+
+// =====================================================================================================================
+// Test that specialization info is left out of the cache hash of a module that uses no specialization constants.
+
+TEST(PipelineDumperTest, TestSpecConstantsIgnoredWithoutUse) {
+  ShaderModuleData moduleData = {};
+  moduleData.usage.useSpecConstant = false;
+
+  const uint32_t data[] = {1, 2};
+  VkSpecializationMapEntry mapEntries[] = {{0, 0, sizeof(uint32_t)}, {1, sizeof(uint32_t), sizeof(uint32_t)}};
+  VkSpecializationInfo specInfo = {};
+  specInfo.mapEntryCount = 2;
+  specInfo.pMapEntries = mapEntries;
+  specInfo.dataSize = sizeof(data);
+  specInfo.pData = data;
+
+  EXPECT_EQ(getComputeCacheHashWithSpecInfo(moduleData, nullptr),
+            getComputeCacheHashWithSpecInfo(moduleData, &specInfo));
+
+  // The non-cache hash still covers the specialization info.
+  auto buildInfo = std::make_unique<ComputePipelineBuildInfo>();
+  buildInfo->cs.pModuleData = &moduleData;
+  auto originalHash = PipelineDumper::generateHashForComputePipeline(buildInfo.get(), /*isCacheHash=*/false);
+  buildInfo->cs.pSpecializationInfo = &specInfo;
+  EXPECT_NE(originalHash, PipelineDumper::generateHashForComputePipeline(buildInfo.get(), /*isCacheHash=*/false));
+}
+
+// =====================================================================================================================
+// Test that the order of the map entries, and how the values are packed in the data, do not change the cache hash.
+
+TEST(PipelineDumperTest, TestSpecConstantsMapEntryOrder) {
+  ShaderModuleData moduleData = {};
+  moduleData.usage.useSpecConstant = true;
+
+  const uint32_t data[] = {7, 9};
+  VkSpecializationMapEntry mapEntries[] = {{0, 0, sizeof(uint32_t)}, {3, sizeof(uint32_t), sizeof(uint32_t)}};
+  VkSpecializationInfo specInfo = {};
+  specInfo.mapEntryCount = 2;
+  specInfo.pMapEntries = mapEntries;
+  specInfo.dataSize = sizeof(data);
+  specInfo.pData = data;
+
+  const uint32_t reorderedData[] = {9, 7};
+  VkSpecializationMapEntry reorderedMapEntries[] = {{3, 0, sizeof(uint32_t)}, {0, sizeof(uint32_t), sizeof(uint32_t)}};
+  VkSpecializationInfo reorderedSpecInfo = {};
+  reorderedSpecInfo.mapEntryCount = 2;
+  reorderedSpecInfo.pMapEntries = reorderedMapEntries;
+  reorderedSpecInfo.dataSize = sizeof(reorderedData);
+  reorderedSpecInfo.pData = reorderedData;
+
+  EXPECT_EQ(getComputeCacheHashWithSpecInfo(moduleData, &specInfo),
+            getComputeCacheHashWithSpecInfo(moduleData, &reorderedSpecInfo));
+}
+
+// =====================================================================================================================
+// Test that a different value of a used specialization constant changes the cache hash.
+
+TEST(PipelineDumperTest, TestSpecConstantsValueChange) {
+  ShaderModuleData moduleData = {};
+  moduleData.usage.useSpecConstant = true;
+
+  uint32_t data[] = {7, 9};
+  VkSpecializationMapEntry mapEntries[] = {{0, 0, sizeof(uint32_t)}, {3, sizeof(uint32_t), sizeof(uint32_t)}};
+  VkSpecializationInfo specInfo = {};
+  specInfo.mapEntryCount = 2;
+  specInfo.pMapEntries = mapEntries;
+  specInfo.dataSize = sizeof(data);
+  specInfo.pData = data;
+
+  auto originalHash = getComputeCacheHashWithSpecInfo(moduleData, &specInfo);
+  data[1] = 10;
+  EXPECT_NE(originalHash, getComputeCacheHashWithSpecInfo(moduleData, &specInfo));
+}
+
+// =====================================================================================================================
+// Test the hash of uber fetch shader pipelines specialized for an observed vertex input state.
+
+TEST(PipelineDumperTest, TestUberFetchSpecializedPipelineHash) {
+  auto buildInfo = std::make_unique<GraphicsPipelineBuildInfo>();
+  buildInfo->enableUberFetchShader = true;
+
+  VkVertexInputBindingDescription binding = {0, 16, VK_VERTEX_INPUT_RATE_VERTEX};
+  VkVertexInputAttributeDescription attribute = {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0};
+  VkPipelineVertexInputStateCreateInfo vertexInput = {};
+  vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInput.vertexBindingDescriptionCount = 1;
+  vertexInput.pVertexBindingDescriptions = &binding;
+  vertexInput.vertexAttributeDescriptionCount = 1;
+  vertexInput.pVertexAttributeDescriptions = &attribute;
+
+  const uint64_t uberHash = IPipelineDumper::GetPipelineHash(buildInfo.get());
+  const uint64_t specializedHash = IPipelineDumper::GetUberFetchSpecializedPipelineHash(buildInfo.get(), &vertexInput);
+  EXPECT_NE(uberHash, specializedHash);
+
+  // The specialized hash is the hash of the pipeline built with the observed formats and no uber fetch shader.
+  GraphicsPipelineBuildInfo specializedInfo = *buildInfo;
+  specializedInfo.pVertexInput = &vertexInput;
+  specializedInfo.enableUberFetchShader = false;
+  EXPECT_EQ(specializedHash, IPipelineDumper::GetPipelineHash(&specializedInfo));
+
+  // The caller's build info is left untouched.
+  EXPECT_TRUE(buildInfo->enableUberFetchShader);
+  EXPECT_EQ(buildInfo->pVertexInput, nullptr);
+
+  // Different observed formats give different variants.
+  attribute.format = VK_FORMAT_R8G8B8A8_UNORM;
+  EXPECT_NE(specializedHash, IPipelineDumper::GetUberFetchSpecializedPipelineHash(buildInfo.get(), &vertexInput));
+}
+
 } // namespace
 } // namespace Llpc
@@ -0,0 +1,181 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+
+#include "llpcShaderModuleHelper.h"
+#include "llpcSpirvModuleIndex.h"
+#include "llpcUtil.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace spv;
+
+namespace Llpc {
+namespace {
+
+constexpr unsigned inst(unsigned wordCount, Op opCode) {
+  return (wordCount << WordCountShift) | opCode;
+}
+
+// "main" packed into words, with its null terminator.
+constexpr unsigned MainName0 = 0x6e69616d;
+constexpr unsigned MainName1 = 0;
+
+// A compute shader module header: one capability, one entry point, one execution mode, a debug instruction and a
+// decoration. Nothing is inside the functions; the index does not look at them.
+const unsigned ComputeModule[] = {
+    // Header
+    MagicNumber, 0x00010000, 0, 10, 0,
+    // OpCapability Shader
+    inst(2, OpCapability), CapabilityShader,
+    // OpCapability GroupNonUniform
+    inst(2, OpCapability), CapabilityGroupNonUniform,
+    // OpMemoryModel Logical GLSL450
+    inst(3, OpMemoryModel), AddressingModelLogical, MemoryModelGLSL450,
+    // OpEntryPoint GLCompute %4 "main"
+    inst(5, OpEntryPoint), ExecutionModelGLCompute, 4, MainName0, MainName1,
+    // OpExecutionMode %4 LocalSize 8 8 1
+    inst(6, OpExecutionMode), 4, ExecutionModeLocalSize, 8, 8, 1,
+    // OpSource GLSL 450
+    inst(3, OpSource), SourceLanguageGLSL, 450,
+    // OpDecorate %5 Binding 2
+    inst(4, OpDecorate), 5, DecorationBinding, 2,
+};
+
+constexpr unsigned SourceOffset = 23;
+constexpr unsigned SourceWords = 3;
+constexpr unsigned DecorateOffset = 26;
+
+BinaryData getComputeModule() {
+  BinaryData spvBin = {};
+  spvBin.pCode = ComputeModule;
+  spvBin.codeSize = sizeof(ComputeModule);
+  return spvBin;
+}
+
+TEST(SpirvModuleIndexTest, RecordsModuleInfo) {
+  BinaryData spvBin = getComputeModule();
+  SpirvModuleIndexBuilder builder;
+  ASSERT_FALSE(errorToBool(builder.build(spvBin, /*trimDebugInfo=*/false)));
+  SpirvModuleIndex index = builder.getIndex();
+
+  EXPECT_EQ(index.getIdBound(), 10u);
+  EXPECT_EQ(builder.getCodeSize(), sizeof(ComputeModule));
+  EXPECT_TRUE(index.hasCapability(CapabilityShader));
+  EXPECT_FALSE(index.hasCapability(CapabilityFloat64));
+  EXPECT_TRUE(builder.getUsage().useSubgroupSize);
+
+  ASSERT_EQ(index.getEntryPoints().size(), 1u);
+  EXPECT_EQ(index.getEntryPoints()[0].functionId, 4u);
+  EXPECT_EQ(index.getStageMask(spvBin, "main"), shaderStageToMask(ShaderStageCompute));
+  EXPECT_EQ(index.getStageMask(spvBin, "other"), 0u);
+
+  ASSERT_EQ(index.getExecutionModes().size(), 1u);
+  EXPECT_EQ(index.getExecutionModes()[0].mode, unsigned(ExecutionModeLocalSize));
+
+  ASSERT_EQ(index.getDecorations().size(), 1u);
+  EXPECT_EQ(index.getDecorations()[0], DecorateOffset);
+
+  ASSERT_EQ(index.getDebugRanges().size(), 1u);
+  EXPECT_EQ(index.getDebugRanges()[0].offset, SourceOffset);
+  EXPECT_EQ(index.getDebugRanges()[0].count, SourceWords);
+}
+
+TEST(SpirvModuleIndexTest, OffsetsFollowTrimmedCode) {
+  BinaryData spvBin = getComputeModule();
+  SpirvModuleIndexBuilder builder;
+  ASSERT_FALSE(errorToBool(builder.build(spvBin, /*trimDebugInfo=*/true)));
+  SpirvModuleIndex index = builder.getIndex();
+
+  ASSERT_EQ(builder.getCodeSize(), sizeof(ComputeModule) - SourceWords * sizeof(unsigned));
+  std::vector<unsigned> code(builder.getCodeSize() / sizeof(unsigned));
+  builder.copyCode(spvBin, code);
+
+  EXPECT_TRUE(index.getDebugRanges().empty());
+  ASSERT_EQ(index.getDecorations().size(), 1u);
+  unsigned decorateOffset = index.getDecorations()[0];
+  EXPECT_EQ(decorateOffset, DecorateOffset - SourceWords);
+  EXPECT_EQ(code[decorateOffset], inst(4, OpDecorate));
+}
+
+TEST(SpirvModuleIndexTest, BlobRoundTrip) {
+  BinaryData spvBin = getComputeModule();
+  SpirvModuleIndexBuilder builder;
+  ASSERT_FALSE(errorToBool(builder.build(spvBin, /*trimDebugInfo=*/false)));
+  SpirvModuleIndex index = builder.getIndex();
+
+  std::vector<unsigned> blob(index.getBlobSize() / sizeof(unsigned));
+  index.writeBlob(blob.data());
+  SpirvModuleIndex copy = SpirvModuleIndex::fromBlob(blob.data());
+
+  EXPECT_EQ(copy.getIdBound(), index.getIdBound());
+  EXPECT_EQ(copy.getCapabilities(), index.getCapabilities());
+  EXPECT_EQ(copy.getDecorations(), index.getDecorations());
+  EXPECT_EQ(copy.getStageMask(spvBin, "main"), shaderStageToMask(ShaderStageCompute));
+}
+
+TEST(SpirvModuleIndexTest, RejectsTruncatedInstruction) {
+  BinaryData spvBin = getComputeModule();
+  spvBin.codeSize -= sizeof(unsigned);
+  SpirvModuleIndexBuilder builder;
+  EXPECT_TRUE(errorToBool(builder.build(spvBin, /*trimDebugInfo=*/false)));
+}
+
+TEST(SpirvModuleIndexTest, ForeignModuleDataHasNoIndex) {
+  // Module data that was not built by BuildShaderModule must not be read past its public fields.
+  ShaderModuleData moduleData = {};
+  moduleData.binType = BinaryType::Spirv;
+  moduleData.binCode = getComputeModule();
+  EXPECT_EQ(ShaderModuleHelper::getSpirvIndex(&moduleData), nullptr);
+}
+
+TEST(SpirvModuleIndexTest, ModuleDataExIndexIsFound) {
+  BinaryData spvBin = getComputeModule();
+  SpirvModuleIndexBuilder builder;
+  ASSERT_FALSE(errorToBool(builder.build(spvBin, /*trimDebugInfo=*/false)));
+  SpirvModuleIndex index = builder.getIndex();
+
+  // Lay the data out the way BuildShaderModule does: ShaderModuleDataEx, the code, then the index blob.
+  size_t allocSize = sizeof(ShaderModuleDataEx) + spvBin.codeSize + index.getBlobSize();
+  std::vector<uint64_t> buffer(allocSize / sizeof(uint64_t) + 1);
+  uint8_t *base = reinterpret_cast<uint8_t *>(buffer.data());
+  ShaderModuleDataEx *moduleDataEx = reinterpret_cast<ShaderModuleDataEx *>(base);
+  moduleDataEx->common.binType = BinaryType::Spirv;
+  moduleDataEx->common.binCode.pCode = base + sizeof(ShaderModuleDataEx);
+  moduleDataEx->common.binCode.codeSize = spvBin.codeSize;
+  memcpy(base + sizeof(ShaderModuleDataEx), spvBin.pCode, spvBin.codeSize);
+  moduleDataEx->magic = ShaderModuleDataExMagic;
+  moduleDataEx->size = sizeof(ShaderModuleDataEx);
+  uint8_t *blob = base + sizeof(ShaderModuleDataEx) + spvBin.codeSize;
+  index.writeBlob(blob);
+  moduleDataEx->spirvIndex = blob;
+  EXPECT_EQ(ShaderModuleHelper::getSpirvIndex(&moduleDataEx->common), blob);
+
+  // A wrong tag means the data is not ours.
+  moduleDataEx->magic = 0;
+  EXPECT_EQ(ShaderModuleHelper::getSpirvIndex(&moduleDataEx->common), nullptr);
+}
+
+} // namespace
+} // namespace Llpc
@@ -0,0 +1,176 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+
+#include "llpcStructuralHash.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace Llpc {
+namespace {
+
+// A shader entry point reading from a buffer through a declared runtime function, with debug info.
+const char *const ShaderA = R"(
+@buf = internal addrspace(1) global [4 x i32] zeroinitializer
+
+declare i32 @runtime.get(i32)
+
+define void @_chit_1(i32 %idx) !lgc.rt.shaderstage !0 !dbg !4 {
+entry:
+  %val = call i32 @runtime.get(i32 %idx), !dbg !3
+  %ptr = getelementptr [4 x i32], ptr addrspace(1) @buf, i32 0, i32 %idx
+  store i32 %val, ptr addrspace(1) %ptr
+  ret void
+}
+
+!llvm.dbg.cu = !{!1}
+!llvm.module.flags = !{!5}
+!0 = !{i32 5}
+!1 = distinct !DICompileUnit(language: DW_LANG_C, file: !2, emissionKind: FullDebug)
+!2 = !DIFile(filename: "a.hlsl", directory: "")
+!3 = !DILocation(line: 1, scope: !4)
+!4 = distinct !DISubprogram(name: "a", unit: !1, spFlags: DISPFlagDefinition)
+!5 = !{i32 2, !"Debug Info Version", i32 3}
+)";
+
+// ShaderA with different names and without debug info.
+const char *const ShaderARenamed = R"(
+@data = internal addrspace(1) global [4 x i32] zeroinitializer
+
+declare i32 @runtime.get(i32)
+
+define void @_chit_7(i32 %i) !lgc.rt.shaderstage !0 {
+start:
+  %x = call i32 @runtime.get(i32 %i)
+  %p = getelementptr [4 x i32], ptr addrspace(1) @data, i32 0, i32 %i
+  store i32 %x, ptr addrspace(1) %p
+  ret void
+}
+
+!llvm.module.flags = !{!1}
+!0 = !{i32 5}
+!1 = !{i32 2, !"Debug Info Version", i32 3}
+)";
+
+// ShaderA with a different shader stage.
+const char *const ShaderADifferentStage = R"(
+@buf = internal addrspace(1) global [4 x i32] zeroinitializer
+
+declare i32 @runtime.get(i32)
+
+define void @_ahit_2(i32 %idx) !lgc.rt.shaderstage !0 {
+entry:
+  %val = call i32 @runtime.get(i32 %idx)
+  %ptr = getelementptr [4 x i32], ptr addrspace(1) @buf, i32 0, i32 %idx
+  store i32 %val, ptr addrspace(1) %ptr
+  ret void
+}
+
+!0 = !{i32 4}
+)";
+
+// ShaderA calling a different runtime function.
+const char *const ShaderADifferentCallee = R"(
+@buf = internal addrspace(1) global [4 x i32] zeroinitializer
+
+declare i32 @runtime.other(i32)
+
+define void @_chit_3(i32 %idx) !lgc.rt.shaderstage !0 {
+entry:
+  %val = call i32 @runtime.other(i32 %idx)
+  %ptr = getelementptr [4 x i32], ptr addrspace(1) @buf, i32 0, i32 %idx
+  store i32 %val, ptr addrspace(1) %ptr
+  ret void
+}
+
+!0 = !{i32 5}
+)";
+
+// ShaderA with a different constant.
+const char *const ShaderADifferentConstant = R"(
+@buf = internal addrspace(1) global [4 x i32] zeroinitializer
+
+declare i32 @runtime.get(i32)
+
+define void @_chit_4(i32 %idx) !lgc.rt.shaderstage !0 {
+entry:
+  %val = call i32 @runtime.get(i32 %idx)
+  %ptr = getelementptr [4 x i32], ptr addrspace(1) @buf, i32 0, i32 1
+  store i32 %val, ptr addrspace(1) %ptr
+  ret void
+}
+
+!0 = !{i32 5}
+)";
+
+class StructuralHashTest : public testing::Test {
+protected:
+  std::unique_ptr<Module> parse(const char *source) {
+    SMDiagnostic error;
+    std::unique_ptr<Module> module = parseAssemblyString(source, error, m_context);
+    EXPECT_TRUE(module) << error.getMessage().str();
+    return module;
+  }
+
+  LLVMContext m_context;
+};
+
+// cppcheck-suppress syntaxError
+TEST_F(StructuralHashTest, IgnoresNamesAndDebugInfo) {
+  std::unique_ptr<Module> lhs = parse(ShaderA);
+  std::unique_ptr<Module> rhs = parse(ShaderARenamed);
+  ASSERT_TRUE(lhs && rhs);
+  EXPECT_EQ(getStructuralHash(*lhs), getStructuralHash(*rhs));
+  EXPECT_TRUE(isStructurallyEqual(*lhs, *rhs));
+  EXPECT_TRUE(isStructurallyEqual(*rhs, *lhs));
+}
+
+TEST_F(StructuralHashTest, DistinguishesShaderStage) {
+  std::unique_ptr<Module> lhs = parse(ShaderA);
+  std::unique_ptr<Module> rhs = parse(ShaderADifferentStage);
+  ASSERT_TRUE(lhs && rhs);
+  EXPECT_FALSE(isStructurallyEqual(*lhs, *rhs));
+}
+
+TEST_F(StructuralHashTest, DistinguishesCallee) {
+  std::unique_ptr<Module> lhs = parse(ShaderA);
+  std::unique_ptr<Module> rhs = parse(ShaderADifferentCallee);
+  ASSERT_TRUE(lhs && rhs);
+  EXPECT_FALSE(isStructurallyEqual(*lhs, *rhs));
+}
+
+TEST_F(StructuralHashTest, DistinguishesConstants) {
+  std::unique_ptr<Module> lhs = parse(ShaderA);
+  std::unique_ptr<Module> rhs = parse(ShaderADifferentConstant);
+  ASSERT_TRUE(lhs && rhs);
+  EXPECT_FALSE(isStructurallyEqual(*lhs, *rhs));
+}
+
+} // namespace
+} // namespace Llpc
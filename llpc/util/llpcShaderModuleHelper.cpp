@@ -31,13 +31,12 @@
 #include "llpcShaderModuleHelper.h"
 #include "llpcDebug.h"
 #include "llpcError.h"
+#include "llpcSpirvModuleIndex.h"
 #include "llpcUtil.h"
 #include "spirvExt.h"
 #include "vkgcUtil.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
-#include <set>
-#include <unordered_set>
 
 using namespace llvm;
 using namespace MetroHash;
@@ -56,274 +55,6 @@ opt<bool> TrimDebugInfo("trim-debug-info", cl::desc("Trim debug information in S
 } // namespace llvm
 
 namespace Llpc {
-// =====================================================================================================================
-// Returns the shader module usage for the given Spir-V binary.
-//
-// @param spvBinCode : SPIR-V binary data
-// @returns : Shader module usage info
-ShaderModuleUsage ShaderModuleHelper::getShaderModuleUsageInfo(const BinaryData *spvBinCode) {
-  const unsigned *code = reinterpret_cast<const unsigned *>(spvBinCode->pCode);
-  const unsigned *end = code + spvBinCode->codeSize / sizeof(unsigned);
-  const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
-
-  ShaderModuleUsage shaderModuleUsage = {};
-  // Parse SPIR-V instructions
-  std::unordered_set<unsigned> capabilities;
-
-  while (codePos < end) {
-    unsigned opCode = (codePos[0] & OpCodeMask);
-    unsigned wordCount = (codePos[0] >> WordCountShift);
-    assert(wordCount > 0 && codePos + wordCount <= end && "Invalid SPIR-V binary\n");
-
-    // Parse each instruction and find those we are interested in
-    switch (opCode) {
-    case OpCapability: {
-      assert(wordCount == 2);
-      auto capability = static_cast<Capability>(codePos[1]);
-      capabilities.insert(capability);
-      break;
-    }
-    case OpExtInst: {
-      auto extInst = static_cast<GLSLstd450>(codePos[4]);
-      switch (extInst) {
-      case GLSLstd450InterpolateAtSample:
-        shaderModuleUsage.useSampleInfo = true;
-        break;
-      case GLSLstd450NMin:
-      case GLSLstd450NMax:
-        shaderModuleUsage.useIsNan = true;
-        break;
-      default:
-        break;
-      }
-      break;
-    }
-    case OpExtension: {
-      StringRef extName = reinterpret_cast<const char *>(&codePos[1]);
-      if (extName == "SPV_AMD_shader_ballot") {
-        shaderModuleUsage.useSubgroupSize = true;
-      }
-      break;
-    }
-    case OpExecutionMode: {
-      auto execMode = static_cast<ExecutionMode>(codePos[2]);
-      switch (execMode) {
-      case ExecutionModeOriginUpperLeft:
-        shaderModuleUsage.originUpperLeft = true;
-        break;
-      case ExecutionModePixelCenterInteger:
-        shaderModuleUsage.pixelCenterInteger = true;
-        break;
-      case ExecutionModeXfb:
-        shaderModuleUsage.enableXfb = true;
-      default: {
-        break;
-      }
-      }
-      break;
-    }
-    case OpDecorate:
-    case OpMemberDecorate: {
-      auto decoration =
-          (opCode == OpDecorate) ? static_cast<Decoration>(codePos[2]) : static_cast<Decoration>(codePos[3]);
-      if (decoration == DecorationInvariant) {
-        shaderModuleUsage.useInvariant = true;
-      }
-      if (decoration == DecorationBuiltIn) {
-        auto builtIn = (opCode == OpDecorate) ? static_cast<BuiltIn>(codePos[3]) : static_cast<BuiltIn>(codePos[4]);
-        switch (builtIn) {
-        case BuiltInPointSize: {
-          shaderModuleUsage.usePointSize = true;
-          break;
-        }
-        case BuiltInPrimitiveShadingRateKHR:
-        case BuiltInShadingRateKHR: {
-          shaderModuleUsage.useShadingRate = true;
-          break;
-        }
-        case BuiltInSamplePosition: {
-          shaderModuleUsage.useSampleInfo = true;
-          break;
-        }
-        case BuiltInFragCoord: {
-          shaderModuleUsage.useFragCoord = true;
-          break;
-        }
-        case BuiltInPointCoord:
-        case BuiltInPrimitiveId:
-        case BuiltInLayer:
-        case BuiltInClipDistance:
-        case BuiltInCullDistance: {
-          shaderModuleUsage.useGenericBuiltIn = true;
-          break;
-        }
-        case BuiltInBaryCoordKHR:
-        case BuiltInBaryCoordNoPerspKHR:
-          shaderModuleUsage.useBarycentric = true;
-          break;
-        default: {
-          break;
-        }
-        }
-      } else if (decoration == DecorationLocation) {
-        auto location = (opCode == OpDecorate) ? codePos[3] : codePos[4];
-        if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::ClipVertex))
-          shaderModuleUsage.useClipVertex = true;
-        if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::FrontColor))
-          shaderModuleUsage.useFrontColor = true;
-        if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::BackColor))
-          shaderModuleUsage.useBackColor = true;
-        if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::FrontSecondaryColor))
-          shaderModuleUsage.useFrontSecondaryColor = true;
-        if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::BackSecondaryColor))
-          shaderModuleUsage.useBackSecondaryColor = true;
-      } else if (decoration == DecorationPerVertexKHR) {
-        shaderModuleUsage.useBarycentric = true;
-      }
-      break;
-    }
-    case OpSpecConstantTrue:
-    case OpSpecConstantFalse:
-    case OpSpecConstant:
-    case OpSpecConstantComposite:
-    case OpSpecConstantOp: {
-      shaderModuleUsage.useSpecConstant = true;
-      break;
-    }
-    case OpTraceNV:
-    case OpTraceRayKHR: {
-      shaderModuleUsage.hasTraceRay = true;
-      break;
-    }
-    case OpExecuteCallableNV:
-    case OpExecuteCallableKHR:
-      shaderModuleUsage.hasExecuteCallable = true;
-      break;
-    case OpIsNan: {
-      shaderModuleUsage.useIsNan = true;
-      break;
-    }
-    default: {
-      break;
-    }
-    }
-    codePos += wordCount;
-  }
-
-  if (capabilities.find(CapabilityVariablePointersStorageBuffer) != capabilities.end())
-    shaderModuleUsage.enableVarPtrStorageBuf = true;
-
-  if (capabilities.find(CapabilityVariablePointers) != capabilities.end())
-    shaderModuleUsage.enableVarPtr = true;
-
-  if (capabilities.find(CapabilityRayQueryKHR) != capabilities.end())
-    shaderModuleUsage.enableRayQuery = true;
-
-  if ((!shaderModuleUsage.useSubgroupSize) &&
-          ((capabilities.count(CapabilityGroupNonUniform) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformVote) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformArithmetic) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformBallot) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformShuffle) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformShuffleRelative) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformClustered) > 0) ||
-           (capabilities.count(CapabilityGroupNonUniformQuad) > 0) ||
-           (capabilities.count(CapabilitySubgroupBallotKHR) > 0) ||
-           (capabilities.count(CapabilitySubgroupVoteKHR) > 0) || (capabilities.count(CapabilityGroups) > 0)) ||
-      (capabilities.count(CapabilityGroupNonUniformRotateKHR) > 0)) {
-    shaderModuleUsage.useSubgroupSize = true;
-  }
-
-  return shaderModuleUsage;
-}
-
-// =====================================================================================================================
-// Returns the number of bytes in the spir-v binary if the debug instructions are removed.  If codeBuffer is not empty,
-// then the spir-v binary without the debug instructions will be written to it.  The size of codeBuffer must be large
-// enough to contain the binary.
-//
-// @param spvBin : SPIR-V binary code
-// @param codeBuffer : The buffer in which to copy the shader code.
-// @returns : The number of bytes written to trimSpvBin or an error if invalid data was encountered
-Expected<unsigned> ShaderModuleHelper::trimSpirvDebugInfo(const BinaryData *spvBin,
-                                                          llvm::MutableArrayRef<unsigned> codeBuffer) {
-  bool writeCode = !codeBuffer.empty();
-  assert(codeBuffer.empty() || codeBuffer.size() > sizeof(SpirvHeader));
-
-  constexpr unsigned wordSize = sizeof(unsigned);
-  const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
-  const unsigned *end = code + spvBin->codeSize / wordSize;
-  const unsigned *codePos = code + sizeof(SpirvHeader) / wordSize;
-
-  unsigned totalSizeInWords = sizeof(Vkgc::SpirvHeader) / wordSize;
-  static_assert(sizeof(Vkgc::SpirvHeader) % wordSize == 0,
-                "The size of the spir-v header must be a multiple of the word size, otherwise later calculations will "
-                "be incorrect.");
-
-  // Copy SPIR-V header
-  if (writeCode) {
-    memcpy(codeBuffer.data(), code, sizeof(SpirvHeader));
-    codeBuffer = codeBuffer.drop_front(sizeof(Vkgc::SpirvHeader) / wordSize);
-  }
-
-  unsigned nonSemanticShaderDebug = ~0;
-
-  // Copy SPIR-V instructions
-  while (codePos < end) {
-    unsigned opCode = (codePos[0] & OpCodeMask);
-    unsigned wordCount = (codePos[0] >> WordCountShift);
-
-    if (wordCount == 0 || codePos + wordCount > end) {
-      LLPC_ERRS("Invalid SPIR-V binary\n");
-      return createResultError(Result::ErrorInvalidShader);
-    }
-
-    bool skip = false;
-    switch (opCode) {
-    case OpSource:
-    case OpSourceContinued:
-    case OpSourceExtension:
-    case OpMemberName:
-    case OpLine:
-    case OpNop:
-    case OpNoLine:
-    case OpModuleProcessed:
-      skip = true;
-      break;
-    case OpExtInstImport: {
-      unsigned id = codePos[1];
-      const char *name = reinterpret_cast<const char *>(&codePos[2]);
-      if (!strcmp(name, "NonSemantic.Shader.DebugInfo.100")) {
-        nonSemanticShaderDebug = id;
-        skip = true;
-      }
-      break;
-    }
-    case OpExtInst: {
-      unsigned set = codePos[3];
-      if (set == nonSemanticShaderDebug)
-        skip = true;
-      break;
-    }
-    default:
-      break;
-    }
-
-    if (!skip) {
-      if (writeCode) {
-        assert(codePos + wordCount <= end);
-        assert(wordCount <= codeBuffer.size());
-        memcpy(codeBuffer.data(), codePos, wordCount * wordSize);
-        codeBuffer = codeBuffer.drop_front(wordCount);
-      }
-      totalSizeInWords += wordCount;
-    }
-
-    codePos += wordCount;
-  }
-  return totalSizeInWords * wordSize;
-}
-
 // =====================================================================================================================
 // Optimizes SPIR-V binary
 //
@@ -420,43 +151,40 @@ unsigned ShaderModuleHelper::getStageMaskFromSpirvBinary(const BinaryData *spvBi
   return stageMask;
 }
 
+// =====================================================================================================================
+// Gets the serialized SpirvModuleIndex of shader module data built by BuildShaderModule.
+//
+// Returns null if the module data does not have the ShaderModuleDataEx layout (e.g. it was built by another compiler
+// version or by the client), in which case the caller must scan the SPIR-V binary instead.
+//
+// @param moduleData : Shader module data passed in a pipeline build
+const void *ShaderModuleHelper::getSpirvIndex(const ShaderModuleData *moduleData) {
+  // BuildShaderModule places the code directly after ShaderModuleDataEx in the same allocation. Check that using only
+  // the public fields before touching anything past them.
+  const uint8_t *moduleBase = reinterpret_cast<const uint8_t *>(moduleData);
+  if (moduleData->binCode.pCode != moduleBase + sizeof(ShaderModuleDataEx))
+    return nullptr;
+
+  const ShaderModuleDataEx *moduleDataEx = reinterpret_cast<const ShaderModuleDataEx *>(moduleData);
+  if (moduleDataEx->magic != ShaderModuleDataExMagic || moduleDataEx->size != sizeof(ShaderModuleDataEx))
+    return nullptr;
+
+  // The index blob follows the code in the same allocation.
+  const uint8_t *codeEnd = moduleBase + sizeof(ShaderModuleDataEx) + moduleData->binCode.codeSize;
+  if (moduleDataEx->spirvIndex && moduleDataEx->spirvIndex < codeEnd)
+    return nullptr;
+  return moduleDataEx->spirvIndex;
+}
+
 // =====================================================================================================================
 // Verifies if the SPIR-V binary is valid and is supported
 //
 // @param spvBin : SPIR-V binary
 Result ShaderModuleHelper::verifySpirvBinary(const BinaryData *spvBin) {
-  Result result = Result::Success;
-
-#define _SPIRV_OP(x, ...) Op##x,
-  static const std::set<Op> OpSet{{
-#include "SPIRVOpCodeEnum.h"
-  }};
-#undef _SPIRV_OP
-
-  const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
-  const unsigned *end = code + spvBin->codeSize / sizeof(unsigned);
-
-  // Skip SPIR-V header
-  const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
-
-  while (codePos < end) {
-    Op opCode = static_cast<Op>(codePos[0] & OpCodeMask);
-    unsigned wordCount = (codePos[0] >> WordCountShift);
-
-    if (wordCount == 0 || codePos + wordCount > end) {
-      result = Result::ErrorInvalidShader;
-      break;
-    }
-
-    if (OpSet.find(opCode) == OpSet.end()) {
-      result = Result::ErrorInvalidShader;
-      break;
-    }
-
-    codePos += wordCount;
-  }
-
-  return result;
+  SpirvModuleIndexBuilder spirvIndex;
+  if (Error err = spirvIndex.build(*spvBin, /*trimDebugInfo=*/false))
+    return errorToResult(std::move(err));
+  return Result::Success;
 }
 
 // =====================================================================================================================
@@ -497,87 +225,65 @@ Result ShaderModuleHelper::getShaderBinaryType(BinaryData shaderBinary, BinaryTy
 }
 
 // =====================================================================================================================
-// Returns the extended module data for the given binary data.  If the code needs to be trimmed then the module data
-// will point to the data in trimmed code.  It should not be resized or deallocated while moduleData is still needed.
+// Returns the extended module data for the given binary data.  If the code is SPIR-V, it is copied from the input
+// as recorded by spirvIndex, which has the debug instructions removed if the module is trimmed.  The module data will
+// point to the data in codeBuffer.  It should not be resized or deallocated while moduleData is still needed.
 //
 // @param shaderInfo : Shader module build info
-// @param codeBuffer [out] : A buffer to hold the trimmed code if it is needed.
+// @param spirvIndex : The index built by getCodeSize
+// @param codeBuffer [out] : A buffer to hold the code, of the size returned by getCodeSize.
 // @param moduleData [out] : If successful, the module data for the module.  Undefined if unsuccessful.
 // @return : Success if the data was read.  The appropriate error otherwise.
 Result ShaderModuleHelper::getModuleData(const ShaderModuleBuildInfo *shaderInfo,
+                                         const SpirvModuleIndexBuilder &spirvIndex,
                                          llvm::MutableArrayRef<unsigned> codeBuffer,
                                          Vkgc::ShaderModuleData &moduleData) {
   const BinaryData &shaderBinary = shaderInfo->shaderBin;
-  Result result = ShaderModuleHelper::getShaderBinaryType(shaderBinary, moduleData.binType);
-  if (result != Result::Success)
-    return result;
-
-  if (moduleData.binType == BinaryType::Spirv) {
-    moduleData.usage = ShaderModuleHelper::getShaderModuleUsageInfo(&shaderBinary);
-    moduleData.usage.isInternalRtShader = shaderInfo->options.pipelineOptions.internalRtShaders;
-    auto codeOrErr = getShaderCode(shaderInfo, codeBuffer);
-    if (Error err = codeOrErr.takeError())
-      return errorToResult(std::move(err));
-
-    moduleData.binCode = *codeOrErr;
-
-    // Calculate SPIR-V cache hash
-    Hash cacheHash = {};
-    MetroHash64::Hash(reinterpret_cast<const uint8_t *>(moduleData.binCode.pCode), moduleData.binCode.codeSize,
-                      cacheHash.bytes);
-    static_assert(sizeof(moduleData.cacheHash) == sizeof(cacheHash),
-                  "Expecting the cacheHash entry in the module data to be the same size as the MetroHash hash!");
-    memcpy(moduleData.cacheHash, cacheHash.dwords, sizeof(cacheHash));
-  } else {
+  if (isLlvmBitcode(&shaderBinary)) {
+    moduleData.binType = BinaryType::LlvmBc;
     moduleData.binCode = shaderBinary;
     memcpy(codeBuffer.data(), shaderBinary.pCode, shaderBinary.codeSize);
+    return Result::Success;
   }
 
+  moduleData.binType = BinaryType::Spirv;
+  moduleData.usage = spirvIndex.getUsage();
+  moduleData.usage.isInternalRtShader = shaderInfo->options.pipelineOptions.internalRtShaders;
+  spirvIndex.copyCode(shaderBinary, codeBuffer);
+  moduleData.binCode.pCode = codeBuffer.data();
+  moduleData.binCode.codeSize = spirvIndex.getCodeSize();
+
+  // Calculate SPIR-V cache hash
+  Hash cacheHash = {};
+  MetroHash64::Hash(reinterpret_cast<const uint8_t *>(moduleData.binCode.pCode), moduleData.binCode.codeSize,
+                    cacheHash.bytes);
+  static_assert(sizeof(moduleData.cacheHash) == sizeof(cacheHash),
+                "Expecting the cacheHash entry in the module data to be the same size as the MetroHash hash!");
+  memcpy(moduleData.cacheHash, cacheHash.dwords, sizeof(cacheHash));
+
   return Result::Success;
 }
 
 // =====================================================================================================================
-// Copies the shader code that should go into the module data into the codeBuffer and returns the BinaryData for it.
-// The debug info will be removed if cl::TrimDebugInfo is set.
+// Returns the number of bytes needed to hold the code of this shader module. For SPIR-V, this scans the binary once
+// into spirvIndex, verifying it and recording what getModuleData needs; the debug info will be removed if
+// cl::TrimDebugInfo is set.
 //
 // @param shaderInfo : Shader module build info
-// @param codeBuffer [out] : A buffer to hold the shader code.
-// @return : The BinaryData for the shaderCode written to codeBuffer.
-Expected<BinaryData> ShaderModuleHelper::getShaderCode(const ShaderModuleBuildInfo *shaderInfo,
-                                                       MutableArrayRef<unsigned int> &codeBuffer) {
-  BinaryData code;
-  const BinaryData &shaderBinary = shaderInfo->shaderBin;
-  bool trimDebugInfo = cl::TrimDebugInfo && !(shaderInfo->options.pipelineOptions.internalRtShaders);
-  if (trimDebugInfo) {
-    auto sizeOrErr = trimSpirvDebugInfo(&shaderBinary, codeBuffer);
-    if (Error err = sizeOrErr.takeError())
-      return std::move(err);
-    code.codeSize = *sizeOrErr;
-  } else {
-    assert(shaderBinary.codeSize <= codeBuffer.size() * sizeof(codeBuffer.front()));
-    memcpy(codeBuffer.data(), shaderBinary.pCode, shaderBinary.codeSize);
-    code.codeSize = shaderBinary.codeSize;
-  }
-  code.pCode = codeBuffer.data();
-  return code;
-}
-
-// =====================================================================================================================
-// @param shaderInfo : Shader module build info
+// @param [out] spirvIndex : Index of the SPIR-V binary
 // @return : The number of bytes need to hold the code for this shader module.
-Expected<unsigned> ShaderModuleHelper::getCodeSize(const ShaderModuleBuildInfo *shaderInfo) {
+Expected<unsigned> ShaderModuleHelper::getCodeSize(const ShaderModuleBuildInfo *shaderInfo,
+                                                   SpirvModuleIndexBuilder &spirvIndex) {
   const BinaryData &shaderBinary = shaderInfo->shaderBin;
-  BinaryType binaryType;
-  Result result = ShaderModuleHelper::getShaderBinaryType(shaderBinary, binaryType);
-  if (result != Result::Success)
+  if (isLlvmBitcode(&shaderBinary))
+    return shaderBinary.codeSize;
+  if (!Vkgc::isSpirvBinary(&shaderBinary))
     return createResultError(Result::ErrorInvalidShader);
 
-  bool trimDebugInfo =
-      binaryType != BinaryType::LlvmBc && cl::TrimDebugInfo && !(shaderInfo->options.pipelineOptions.internalRtShaders);
-
-  if (!trimDebugInfo)
-    return shaderBinary.codeSize;
-  return ShaderModuleHelper::trimSpirvDebugInfo(&shaderBinary, {});
+  bool trimDebugInfo = cl::TrimDebugInfo && !(shaderInfo->options.pipelineOptions.internalRtShaders);
+  if (Error err = spirvIndex.build(shaderBinary, trimDebugInfo))
+    return std::move(err);
+  return spirvIndex.getCodeSize();
 }
 
 } // namespace Llpc
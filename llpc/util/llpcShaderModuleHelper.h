@@ -37,6 +37,8 @@
 
 namespace Llpc {
 
+class SpirvModuleIndexBuilder;
+
 // Represents the information of one shader entry in ShaderModuleData
 struct ShaderModuleEntry {
   unsigned entryNameHash[4]; // Hash code of entry name
@@ -45,6 +47,19 @@ struct ShaderModuleEntry {
   unsigned passIndex;        // Indices of passes, It is only for internal debug.
 };
 
+// Represents the shader module data returned by BuildShaderModule: the public part, then data that only LLPC uses.
+// The pModuleData passed in a pipeline build may have been built elsewhere, so use
+// ShaderModuleHelper::getSpirvIndex rather than reading the LLPC-only fields directly.
+struct ShaderModuleDataEx {
+  Vkgc::ShaderModuleData common; // Public shader module data
+  unsigned magic;                // Must be ShaderModuleDataExMagic
+  unsigned size;                 // Must be sizeof(ShaderModuleDataEx)
+  const void *spirvIndex;        // Serialized SpirvModuleIndex of the SPIR-V in common.binCode, or null
+};
+
+// Tag identifying the LLPC-internal part of ShaderModuleDataEx ("LLSX")
+static constexpr unsigned ShaderModuleDataExMagic = 0x58534C4C;
+
 // Represents the name map <stage, name> of shader entry-point
 struct ShaderEntryName {
   ShaderStage stage; // Shader stage
@@ -55,26 +70,22 @@ struct ShaderEntryName {
 // Represents LLPC shader module helper class
 class ShaderModuleHelper {
 public:
-  static ShaderModuleUsage getShaderModuleUsageInfo(const BinaryData *spvBinCode);
-
-  static llvm::Expected<unsigned> trimSpirvDebugInfo(const BinaryData *spvBin,
-                                                     llvm::MutableArrayRef<unsigned> codeBuffer);
-
   static Result optimizeSpirv(const BinaryData *spirvBinIn, BinaryData *spirvBinOut);
 
   static void cleanOptimizedSpirv(BinaryData *spirvBin);
 
   static unsigned getStageMaskFromSpirvBinary(const BinaryData *spvBin, const char *entryName);
 
+  static const void *getSpirvIndex(const Vkgc::ShaderModuleData *moduleData);
+
   static Result verifySpirvBinary(const BinaryData *spvBin);
 
   static bool isLlvmBitcode(const BinaryData *shaderBin);
   static Result getShaderBinaryType(BinaryData shaderBinary, BinaryType &binaryType);
-  static Result getModuleData(const ShaderModuleBuildInfo *shaderInfo, llvm::MutableArrayRef<unsigned> codeBuffer,
-                              Vkgc::ShaderModuleData &moduleData);
-  static llvm::Expected<unsigned> getCodeSize(const ShaderModuleBuildInfo *shaderInfo);
-  static llvm::Expected<BinaryData> getShaderCode(const ShaderModuleBuildInfo *shaderInfo,
-                                                  llvm::MutableArrayRef<unsigned int> &codeBuffer);
+  static Result getModuleData(const ShaderModuleBuildInfo *shaderInfo, const SpirvModuleIndexBuilder &spirvIndex,
+                              llvm::MutableArrayRef<unsigned> codeBuffer, Vkgc::ShaderModuleData &moduleData);
+  static llvm::Expected<unsigned> getCodeSize(const ShaderModuleBuildInfo *shaderInfo,
+                                              SpirvModuleIndexBuilder &spirvIndex);
 };
 
 } // namespace Llpc
@@ -0,0 +1,447 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcSpirvModuleIndex.cpp
+ * @brief LLPC source file: contains implementation of the SPIR-V module index built with the shader module data
+ ***********************************************************************************************************************
+ */
+#include "llpcSpirvModuleIndex.h"
+#include "llpcDebug.h"
+#include "llpcError.h"
+#include "llpcUtil.h"
+#include "spirvExt.h"
+#include "vkgcUtil.h"
+#include "llvm/ADT/STLExtras.h"
+#include <set>
+
+using namespace llvm;
+using namespace spv;
+
+using Vkgc::SpirvHeader;
+
+namespace {
+
+// Header of the serialized index, followed by the arrays in the order of the counts
+struct SpirvModuleIndexBlobHeader {
+  unsigned idBound;
+  unsigned entryPointCount;
+  unsigned executionModeCount;
+  unsigned capabilityCount;
+  unsigned decorationCount;
+  unsigned debugRangeCount;
+};
+
+// =====================================================================================================================
+// Gets an array from the serialized index and advances past it.
+//
+// @param [in/out] data : Start of the array
+// @param count : Number of elements
+template <typename T> llvm::ArrayRef<T> takeArray(const void *&data, unsigned count) {
+  llvm::ArrayRef<T> array(static_cast<const T *>(data), count);
+  data = array.end();
+  return array;
+}
+
+} // anonymous namespace
+
+namespace Llpc {
+
+// =====================================================================================================================
+// Gets a view of an index serialized by writeBlob.
+//
+// @param blob : Serialized index
+SpirvModuleIndex SpirvModuleIndex::fromBlob(const void *blob) {
+  const auto *header = static_cast<const SpirvModuleIndexBlobHeader *>(blob);
+  const void *arrays = header + 1;
+  auto entryPoints = takeArray<EntryPoint>(arrays, header->entryPointCount);
+  auto executionModes = takeArray<ExecutionMode>(arrays, header->executionModeCount);
+  auto capabilities = takeArray<unsigned>(arrays, header->capabilityCount);
+  auto decorations = takeArray<unsigned>(arrays, header->decorationCount);
+  auto debugRanges = takeArray<WordRange>(arrays, header->debugRangeCount);
+  return SpirvModuleIndex(header->idBound, entryPoints, executionModes, capabilities, decorations, debugRanges);
+}
+
+// =====================================================================================================================
+// Gets the size in bytes of the serialized index.
+size_t SpirvModuleIndex::getBlobSize() const {
+  return sizeof(SpirvModuleIndexBlobHeader) + m_entryPoints.size() * sizeof(EntryPoint) +
+         m_executionModes.size() * sizeof(ExecutionMode) + m_capabilities.size() * sizeof(unsigned) +
+         m_decorations.size() * sizeof(unsigned) + m_debugRanges.size() * sizeof(WordRange);
+}
+
+// =====================================================================================================================
+// Serializes the index. The serialized form does not contain pointers, so it can be copied together with the shader
+// module data.
+//
+// @param [out] buffer : Buffer of getBlobSize() bytes, aligned to 4 bytes
+void SpirvModuleIndex::writeBlob(void *buffer) const {
+  SpirvModuleIndexBlobHeader header = {};
+  header.idBound = m_idBound;
+  header.entryPointCount = m_entryPoints.size();
+  header.executionModeCount = m_executionModes.size();
+  header.capabilityCount = m_capabilities.size();
+  header.decorationCount = m_decorations.size();
+  header.debugRangeCount = m_debugRanges.size();
+
+  uint8_t *writePtr = static_cast<uint8_t *>(buffer);
+  auto write = [&writePtr](const void *data, size_t size) {
+    if (size != 0)
+      memcpy(writePtr, data, size);
+    writePtr += size;
+  };
+  write(&header, sizeof(header));
+  write(m_entryPoints.data(), m_entryPoints.size() * sizeof(EntryPoint));
+  write(m_executionModes.data(), m_executionModes.size() * sizeof(ExecutionMode));
+  write(m_capabilities.data(), m_capabilities.size() * sizeof(unsigned));
+  write(m_decorations.data(), m_decorations.size() * sizeof(unsigned));
+  write(m_debugRanges.data(), m_debugRanges.size() * sizeof(WordRange));
+}
+
+// =====================================================================================================================
+// Checks whether the module declares a capability.
+//
+// @param capability : spv::Capability to look for
+bool SpirvModuleIndex::hasCapability(unsigned capability) const {
+  return std::binary_search(m_capabilities.begin(), m_capabilities.end(), capability);
+}
+
+// =====================================================================================================================
+// Gets the mask of shader stages that have an entry point with the given name.
+//
+// @param code : The stored code that the index describes
+// @param entryName : Name of entry-point
+unsigned SpirvModuleIndex::getStageMask(const BinaryData &code, StringRef entryName) const {
+  const unsigned *words = static_cast<const unsigned *>(code.pCode);
+  unsigned stageMask = 0;
+  for (const EntryPoint &entryPoint : m_entryPoints) {
+    if (entryName == reinterpret_cast<const char *>(&words[entryPoint.nameOffset]))
+      stageMask |= shaderStageToMask(convertToShaderStage(entryPoint.executionModel));
+  }
+  return stageMask;
+}
+
+// =====================================================================================================================
+// Scans the SPIR-V binary once, recording the index, the module usage and which words to store. Fails if the binary
+// is malformed or uses unsupported instructions.
+//
+// @param spvBin : SPIR-V binary
+// @param trimDebugInfo : Whether debug instructions are removed from the stored code
+Error SpirvModuleIndexBuilder::build(const BinaryData &spvBin, bool trimDebugInfo) {
+#define _SPIRV_OP(x, ...) Op##x,
+  static const std::set<Op> OpSet{{
+#include "SPIRVOpCodeEnum.h"
+  }};
+#undef _SPIRV_OP
+
+  *this = SpirvModuleIndexBuilder();
+
+  constexpr unsigned HeaderWords = sizeof(SpirvHeader) / sizeof(unsigned);
+  static_assert(sizeof(SpirvHeader) % sizeof(unsigned) == 0,
+                "The size of the spir-v header must be a multiple of the word size");
+  const unsigned *code = static_cast<const unsigned *>(spvBin.pCode);
+  const unsigned totalWords = spvBin.codeSize / sizeof(unsigned);
+  if (totalWords < HeaderWords) {
+    LLPC_ERRS("Invalid SPIR-V binary\n");
+    return createResultError(Result::ErrorInvalidShader);
+  }
+
+  m_idBound = reinterpret_cast<const SpirvHeader *>(code)->idBound;
+  addKeptWords(0, HeaderWords);
+
+  unsigned nonSemanticShaderDebug = InvalidValue;
+  for (unsigned offset = HeaderWords; offset < totalWords;) {
+    const unsigned *inst = code + offset;
+    unsigned opCode = (inst[0] & OpCodeMask);
+    unsigned wordCount = (inst[0] >> WordCountShift);
+    if (wordCount == 0 || wordCount > totalWords - offset) {
+      LLPC_ERRS("Invalid SPIR-V binary\n");
+      return createResultError(Result::ErrorInvalidShader);
+    }
+    if (OpSet.find(static_cast<Op>(opCode)) == OpSet.end()) {
+      LLPC_ERRS("Unsupported SPIR-V instructions found in the SPIR-V binary!\n");
+      return createResultError(Result::ErrorInvalidShader);
+    }
+
+    // Debug instructions do not affect the generated code.
+    bool isDebug = false;
+    switch (opCode) {
+    case OpSource:
+    case OpSourceContinued:
+    case OpSourceExtension:
+    case OpMemberName:
+    case OpLine:
+    case OpNop:
+    case OpNoLine:
+    case OpModuleProcessed:
+      isDebug = true;
+      break;
+    case OpExtInstImport:
+      if (wordCount > 2 && StringRef(reinterpret_cast<const char *>(&inst[2])) == "NonSemantic.Shader.DebugInfo.100") {
+        nonSemanticShaderDebug = inst[1];
+        isDebug = true;
+      }
+      break;
+    case OpExtInst:
+      isDebug = wordCount > 3 && inst[3] == nonSemanticShaderDebug;
+      break;
+    default:
+      break;
+    }
+
+    addUsage(inst, opCode);
+    if (isDebug && trimDebugInfo) {
+      offset += wordCount;
+      continue;
+    }
+
+    const unsigned storedOffset = m_codeWords;
+    addKeptWords(offset, wordCount);
+
+    switch (opCode) {
+    case OpCapability:
+      if (wordCount >= 2)
+        m_capabilities.push_back(inst[1]);
+      break;
+    case OpEntryPoint:
+      if (wordCount >= 4)
+        m_entryPoints.push_back({inst[1], inst[2], storedOffset + 3});
+      break;
+    case OpExecutionMode:
+    case OpExecutionModeId:
+      if (wordCount >= 3)
+        m_executionModes.push_back({inst[1], inst[2], storedOffset});
+      break;
+    case OpDecorate:
+    case OpMemberDecorate:
+      m_decorations.push_back(storedOffset);
+      break;
+    default:
+      if (isDebug) {
+        if (!m_debugRanges.empty() && m_debugRanges.back().offset + m_debugRanges.back().count == storedOffset)
+          m_debugRanges.back().count += wordCount;
+        else
+          m_debugRanges.push_back({storedOffset, wordCount});
+      }
+      break;
+    }
+    offset += wordCount;
+  }
+
+  llvm::sort(m_capabilities);
+  m_capabilities.erase(std::unique(m_capabilities.begin(), m_capabilities.end()), m_capabilities.end());
+
+  if (hasCapability(CapabilityVariablePointersStorageBuffer))
+    m_usage.enableVarPtrStorageBuf = true;
+  if (hasCapability(CapabilityVariablePointers))
+    m_usage.enableVarPtr = true;
+  if (hasCapability(CapabilityRayQueryKHR))
+    m_usage.enableRayQuery = true;
+
+  static const unsigned SubgroupCapabilities[] = {
+      CapabilityGroupNonUniform,          CapabilityGroupNonUniformVote,
+      CapabilityGroupNonUniformArithmetic, CapabilityGroupNonUniformBallot,
+      CapabilityGroupNonUniformShuffle,    CapabilityGroupNonUniformShuffleRelative,
+      CapabilityGroupNonUniformClustered,  CapabilityGroupNonUniformQuad,
+      CapabilitySubgroupBallotKHR,         CapabilitySubgroupVoteKHR,
+      CapabilityGroups,                    CapabilityGroupNonUniformRotateKHR,
+  };
+  if (any_of(SubgroupCapabilities, [this](unsigned capability) { return hasCapability(capability); }))
+    m_usage.useSubgroupSize = true;
+
+  return Error::success();
+}
+
+// =====================================================================================================================
+// Checks whether the module declares a capability. Only valid once the scan has finished.
+//
+// @param capability : spv::Capability to look for
+bool SpirvModuleIndexBuilder::hasCapability(unsigned capability) const {
+  return getIndex().hasCapability(capability);
+}
+
+// =====================================================================================================================
+// Records that a run of input words is stored, merging it with the previous run when contiguous.
+//
+// @param inputOffset : Word offset in the input binary
+// @param wordCount : Number of words
+void SpirvModuleIndexBuilder::addKeptWords(unsigned inputOffset, unsigned wordCount) {
+  if (!m_keptRanges.empty() && m_keptRanges.back().offset + m_keptRanges.back().count == inputOffset)
+    m_keptRanges.back().count += wordCount;
+  else
+    m_keptRanges.push_back({inputOffset, wordCount});
+  m_codeWords += wordCount;
+}
+
+// =====================================================================================================================
+// Copies the code to store, without the debug instructions if they were trimmed.
+//
+// @param spvBin : The SPIR-V binary passed to build()
+// @param [out] codeBuffer : Buffer of at least getCodeSize() bytes
+void SpirvModuleIndexBuilder::copyCode(const BinaryData &spvBin, MutableArrayRef<unsigned> codeBuffer) const {
+  assert(codeBuffer.size() >= m_codeWords);
+  const unsigned *code = static_cast<const unsigned *>(spvBin.pCode);
+  unsigned *writePtr = codeBuffer.data();
+  for (const SpirvModuleIndex::WordRange &range : m_keptRanges) {
+    memcpy(writePtr, code + range.offset, range.count * sizeof(unsigned));
+    writePtr += range.count;
+  }
+}
+
+// =====================================================================================================================
+// Updates the module usage for one instruction.
+//
+// @param inst : Instruction words
+// @param opCode : Opcode of the instruction
+void SpirvModuleIndexBuilder::addUsage(const unsigned *inst, unsigned opCode) {
+  ShaderModuleUsage &usage = m_usage;
+  switch (opCode) {
+  case OpExtInst: {
+    auto extInst = static_cast<GLSLstd450>(inst[4]);
+    switch (extInst) {
+    case GLSLstd450InterpolateAtSample:
+      usage.useSampleInfo = true;
+      break;
+    case GLSLstd450NMin:
+    case GLSLstd450NMax:
+      usage.useIsNan = true;
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+  case OpExtension: {
+    StringRef extName = reinterpret_cast<const char *>(&inst[1]);
+    if (extName == "SPV_AMD_shader_ballot") {
+      usage.useSubgroupSize = true;
+    }
+    break;
+  }
+  case OpExecutionMode: {
+    auto execMode = static_cast<ExecutionMode>(inst[2]);
+    switch (execMode) {
+    case ExecutionModeOriginUpperLeft:
+      usage.originUpperLeft = true;
+      break;
+    case ExecutionModePixelCenterInteger:
+      usage.pixelCenterInteger = true;
+      break;
+    case ExecutionModeXfb:
+      usage.enableXfb = true;
+    default: {
+      break;
+    }
+    }
+    break;
+  }
+  case OpDecorate:
+  case OpMemberDecorate: {
+    auto decoration =
+        (opCode == OpDecorate) ? static_cast<Decoration>(inst[2]) : static_cast<Decoration>(inst[3]);
+    if (decoration == DecorationInvariant) {
+      usage.useInvariant = true;
+    }
+    if (decoration == DecorationBuiltIn) {
+      auto builtIn = (opCode == OpDecorate) ? static_cast<BuiltIn>(inst[3]) : static_cast<BuiltIn>(inst[4]);
+      switch (builtIn) {
+      case BuiltInPointSize: {
+        usage.usePointSize = true;
+        break;
+      }
+      case BuiltInPrimitiveShadingRateKHR:
+      case BuiltInShadingRateKHR: {
+        usage.useShadingRate = true;
+        break;
+      }
+      case BuiltInSamplePosition: {
+        usage.useSampleInfo = true;
+        break;
+      }
+      case BuiltInFragCoord: {
+        usage.useFragCoord = true;
+        break;
+      }
+      case BuiltInPointCoord:
+      case BuiltInPrimitiveId:
+      case BuiltInLayer:
+      case BuiltInClipDistance:
+      case BuiltInCullDistance: {
+        usage.useGenericBuiltIn = true;
+        break;
+      }
+      case BuiltInBaryCoordKHR:
+      case BuiltInBaryCoordNoPerspKHR:
+        usage.useBarycentric = true;
+        break;
+      default: {
+        break;
+      }
+      }
+    } else if (decoration == DecorationLocation) {
+      auto location = (opCode == OpDecorate) ? inst[3] : inst[4];
+      if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::ClipVertex))
+        usage.useClipVertex = true;
+      if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::FrontColor))
+        usage.useFrontColor = true;
+      if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::BackColor))
+        usage.useBackColor = true;
+      if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::FrontSecondaryColor))
+        usage.useFrontSecondaryColor = true;
+      if (location == static_cast<unsigned>(Vkgc::GlCompatibilityInOutLocation::BackSecondaryColor))
+        usage.useBackSecondaryColor = true;
+    } else if (decoration == DecorationPerVertexKHR) {
+      usage.useBarycentric = true;
+    }
+    break;
+  }
+  case OpSpecConstantTrue:
+  case OpSpecConstantFalse:
+  case OpSpecConstant:
+  case OpSpecConstantComposite:
+  case OpSpecConstantOp: {
+    usage.useSpecConstant = true;
+    break;
+  }
+  case OpTraceNV:
+  case OpTraceRayKHR: {
+    usage.hasTraceRay = true;
+    break;
+  }
+  case OpExecuteCallableNV:
+  case OpExecuteCallableKHR:
+    usage.hasExecuteCallable = true;
+    break;
+  case OpIsNan: {
+    usage.useIsNan = true;
+    break;
+  }
+  default: {
+    break;
+  }
+  }
+}
+
+} // namespace Llpc
@@ -0,0 +1,137 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcSpirvModuleIndex.h
+ * @brief LLPC header file: contains declaration of the SPIR-V module index built with the shader module data
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llpc.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <vector>
+
+namespace Llpc {
+
+// =====================================================================================================================
+// Compact side table of a SPIR-V module: entry points, execution modes, capabilities, decorations and debug
+// instructions. It is built in one pass over the words by SpirvModuleIndexBuilder and stored after the code in the
+// shader module data, so that later consumers do not need to rescan the binary. All word offsets refer to the stored
+// code, which has the debug instructions removed when the module was trimmed.
+//
+// This is a view: it points either into a SpirvModuleIndexBuilder or into the serialized form in the module data.
+class SpirvModuleIndex {
+public:
+  // An OpEntryPoint
+  struct EntryPoint {
+    unsigned executionModel; // spv::ExecutionModel
+    unsigned functionId;     // ID of the entry function
+    unsigned nameOffset;     // Word offset of the null-terminated entry name
+  };
+
+  // An OpExecutionMode or OpExecutionModeId
+  struct ExecutionMode {
+    unsigned entryId;    // ID of the entry function
+    unsigned mode;       // spv::ExecutionMode
+    unsigned instOffset; // Word offset of the instruction
+  };
+
+  // A run of instructions
+  struct WordRange {
+    unsigned offset; // Word offset of the first instruction
+    unsigned count;  // Number of words
+  };
+
+  SpirvModuleIndex() = default;
+  SpirvModuleIndex(unsigned idBound, llvm::ArrayRef<EntryPoint> entryPoints,
+                   llvm::ArrayRef<ExecutionMode> executionModes, llvm::ArrayRef<unsigned> capabilities,
+                   llvm::ArrayRef<unsigned> decorations, llvm::ArrayRef<WordRange> debugRanges)
+      : m_idBound(idBound), m_entryPoints(entryPoints), m_executionModes(executionModes),
+        m_capabilities(capabilities), m_decorations(decorations), m_debugRanges(debugRanges) {}
+
+  // Serialization into the shader module data
+  static SpirvModuleIndex fromBlob(const void *blob);
+  size_t getBlobSize() const;
+  void writeBlob(void *buffer) const;
+
+  unsigned getIdBound() const { return m_idBound; }
+  llvm::ArrayRef<EntryPoint> getEntryPoints() const { return m_entryPoints; }
+  llvm::ArrayRef<ExecutionMode> getExecutionModes() const { return m_executionModes; }
+  // Sorted without duplicates
+  llvm::ArrayRef<unsigned> getCapabilities() const { return m_capabilities; }
+  // Word offsets of the OpDecorate and OpMemberDecorate instructions
+  llvm::ArrayRef<unsigned> getDecorations() const { return m_decorations; }
+  // Debug instructions left in the stored code
+  llvm::ArrayRef<WordRange> getDebugRanges() const { return m_debugRanges; }
+
+  bool hasCapability(unsigned capability) const;
+  unsigned getStageMask(const BinaryData &code, llvm::StringRef entryName) const;
+
+private:
+  unsigned m_idBound = 0;
+  llvm::ArrayRef<EntryPoint> m_entryPoints;
+  llvm::ArrayRef<ExecutionMode> m_executionModes;
+  llvm::ArrayRef<unsigned> m_capabilities;
+  llvm::ArrayRef<unsigned> m_decorations;
+  llvm::ArrayRef<WordRange> m_debugRanges;
+};
+
+// =====================================================================================================================
+// Builds the SpirvModuleIndex and the ShaderModuleUsage of a SPIR-V binary in a single pass, which also verifies that
+// every instruction is well formed and supported.
+class SpirvModuleIndexBuilder {
+public:
+  llvm::Error build(const BinaryData &spvBin, bool trimDebugInfo);
+
+  SpirvModuleIndex getIndex() const {
+    return SpirvModuleIndex(m_idBound, m_entryPoints, m_executionModes, m_capabilities, m_decorations, m_debugRanges);
+  }
+  const ShaderModuleUsage &getUsage() const { return m_usage; }
+
+  // Size in bytes of the code to store, after removing debug instructions if trimming
+  unsigned getCodeSize() const { return m_codeWords * sizeof(unsigned); }
+  void copyCode(const BinaryData &spvBin, llvm::MutableArrayRef<unsigned> codeBuffer) const;
+
+private:
+  void addUsage(const unsigned *inst, unsigned opCode);
+  void addKeptWords(unsigned inputOffset, unsigned wordCount);
+  bool hasCapability(unsigned capability) const;
+
+  unsigned m_idBound = 0;
+  unsigned m_codeWords = 0;
+  ShaderModuleUsage m_usage = {};
+  std::vector<SpirvModuleIndex::EntryPoint> m_entryPoints;
+  std::vector<SpirvModuleIndex::ExecutionMode> m_executionModes;
+  std::vector<unsigned> m_capabilities;
+  std::vector<unsigned> m_decorations;
+  std::vector<SpirvModuleIndex::WordRange> m_debugRanges;
+  // Runs of the input code that are stored, in input word offsets
+  std::vector<SpirvModuleIndex::WordRange> m_keptRanges;
+};
+
+} // namespace Llpc
@@ -0,0 +1,353 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcStructuralHash.cpp
+ * @brief LLPC source file: contains implementation of utilities to detect structurally identical modules
+ ***********************************************************************************************************************
+ */
+#include "llpcStructuralHash.h"
+#include "vkgcMetroHash.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+using namespace llvm;
+
+namespace {
+
+// Compares two modules, pairing up their definitions by position.
+class ModuleComparator {
+public:
+  ModuleComparator(const Module &lhs, const Module &rhs) : m_lhs(lhs), m_rhs(rhs) {}
+
+  bool compare();
+
+private:
+  bool compareFunctions(const Function &lhs, const Function &rhs);
+  bool compareGlobalVariables(const GlobalVariable &lhs, const GlobalVariable &rhs);
+  bool compareValues(const Value *lhs, const Value *rhs);
+  bool compareConstants(const Constant *lhs, const Constant *rhs);
+
+  const Module &m_lhs;
+  const Module &m_rhs;
+  // Values of the lhs module that have been paired with a value of the rhs module
+  DenseMap<const Value *, const Value *> m_valueMap;
+};
+
+} // anonymous namespace
+
+// =====================================================================================================================
+// Gets the instructions of a basic block other than debug intrinsics.
+//
+// @param block : Basic block
+static SmallVector<const Instruction *, 32> getNonDebugInstructions(const BasicBlock &block) {
+  SmallVector<const Instruction *, 32> insts;
+  for (const Instruction &inst : block) {
+    if (!isa<DbgInfoIntrinsic>(inst))
+      insts.push_back(&inst);
+  }
+  return insts;
+}
+
+// =====================================================================================================================
+// Checks whether two metadata attachment lists are identical apart from debug locations. Metadata nodes are uniqued in
+// the context, so pointer comparison is enough.
+//
+// @param lhs : First attachment list
+// @param rhs : Second attachment list
+static bool compareAttachments(ArrayRef<std::pair<unsigned, MDNode *>> lhs,
+                               ArrayRef<std::pair<unsigned, MDNode *>> rhs) {
+  auto isNotDebug = [](const std::pair<unsigned, MDNode *> &attachment) {
+    return attachment.first != LLVMContext::MD_dbg;
+  };
+  SmallVector<std::pair<unsigned, MDNode *>, 4> lhsFiltered(make_filter_range(lhs, isNotDebug));
+  SmallVector<std::pair<unsigned, MDNode *>, 4> rhsFiltered(make_filter_range(rhs, isNotDebug));
+  return lhsFiltered == rhsFiltered;
+}
+
+// =====================================================================================================================
+// Compares the modules.
+bool ModuleComparator::compare() {
+  if (&m_lhs.getContext() != &m_rhs.getContext() ||
+      m_lhs.getDataLayoutStr() != m_rhs.getDataLayoutStr() || m_lhs.getTargetTriple() != m_rhs.getTargetTriple())
+    return false;
+  if (!m_lhs.alias_empty() || !m_rhs.alias_empty() || !m_lhs.ifunc_empty() || !m_rhs.ifunc_empty())
+    return false;
+
+  // Named metadata must match exactly, except for debug info.
+  auto countNamedMetadata = [](const Module &module) {
+    return count_if(module.named_metadata(),
+                    [](const NamedMDNode &node) { return !node.getName().starts_with("llvm.dbg."); });
+  };
+  if (countNamedMetadata(m_lhs) != countNamedMetadata(m_rhs))
+    return false;
+  for (const NamedMDNode &lhsNode : m_lhs.named_metadata()) {
+    if (lhsNode.getName().starts_with("llvm.dbg."))
+      continue;
+    const NamedMDNode *rhsNode = m_rhs.getNamedMetadata(lhsNode.getName());
+    if (!rhsNode || !equal(lhsNode.operands(), rhsNode->operands()))
+      return false;
+  }
+
+  // Pair up definitions by position before comparing them, so that references between them can be checked.
+  SmallVector<std::pair<const GlobalVariable *, const GlobalVariable *>, 8> globalPairs;
+  auto lhsGlobal = m_lhs.global_begin();
+  auto rhsGlobal = m_rhs.global_begin();
+  for (; lhsGlobal != m_lhs.global_end() && rhsGlobal != m_rhs.global_end(); ++lhsGlobal, ++rhsGlobal) {
+    if (lhsGlobal->isDeclaration() != rhsGlobal->isDeclaration())
+      return false;
+    if (lhsGlobal->isDeclaration())
+      continue;
+    globalPairs.push_back({&*lhsGlobal, &*rhsGlobal});
+    m_valueMap[&*lhsGlobal] = &*rhsGlobal;
+  }
+  if (lhsGlobal != m_lhs.global_end() || rhsGlobal != m_rhs.global_end())
+    return false;
+
+  SmallVector<std::pair<const Function *, const Function *>, 8> functionPairs;
+  auto lhsFunc = m_lhs.begin();
+  auto rhsFunc = m_rhs.begin();
+  for (; lhsFunc != m_lhs.end() && rhsFunc != m_rhs.end(); ++lhsFunc, ++rhsFunc) {
+    if (lhsFunc->isDeclaration() != rhsFunc->isDeclaration())
+      return false;
+    if (lhsFunc->isDeclaration())
+      continue;
+    functionPairs.push_back({&*lhsFunc, &*rhsFunc});
+    m_valueMap[&*lhsFunc] = &*rhsFunc;
+  }
+  if (lhsFunc != m_lhs.end() || rhsFunc != m_rhs.end())
+    return false;
+
+  for (auto [lhs, rhs] : globalPairs) {
+    if (!compareGlobalVariables(*lhs, *rhs))
+      return false;
+  }
+  for (auto [lhs, rhs] : functionPairs) {
+    if (!compareFunctions(*lhs, *rhs))
+      return false;
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Compares two global variable definitions. Names are only significant for globals visible outside the module.
+//
+// @param lhs : Global variable of the first module
+// @param rhs : Global variable of the second module
+bool ModuleComparator::compareGlobalVariables(const GlobalVariable &lhs, const GlobalVariable &rhs) {
+  if (lhs.getValueType() != rhs.getValueType() || lhs.getAddressSpace() != rhs.getAddressSpace() ||
+      lhs.getLinkage() != rhs.getLinkage() || lhs.isConstant() != rhs.isConstant() ||
+      lhs.getAlign() != rhs.getAlign() || lhs.isThreadLocal() != rhs.isThreadLocal() ||
+      lhs.getUnnamedAddr() != rhs.getUnnamedAddr())
+    return false;
+  if (!lhs.hasLocalLinkage() && lhs.getName() != rhs.getName())
+    return false;
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> lhsAttachments;
+  SmallVector<std::pair<unsigned, MDNode *>, 4> rhsAttachments;
+  lhs.getAllMetadata(lhsAttachments);
+  rhs.getAllMetadata(rhsAttachments);
+  if (!compareAttachments(lhsAttachments, rhsAttachments))
+    return false;
+
+  return compareValues(lhs.getInitializer(), rhs.getInitializer());
+}
+
+// =====================================================================================================================
+// Compares two function definitions, ignoring their names.
+//
+// @param lhs : Function of the first module
+// @param rhs : Function of the second module
+bool ModuleComparator::compareFunctions(const Function &lhs, const Function &rhs) {
+  if (lhs.getFunctionType() != rhs.getFunctionType() || lhs.getAttributes() != rhs.getAttributes() ||
+      lhs.getCallingConv() != rhs.getCallingConv() || lhs.getLinkage() != rhs.getLinkage() ||
+      lhs.getVisibility() != rhs.getVisibility() || lhs.size() != rhs.size())
+    return false;
+
+  // Function metadata carries the shader stage and other state that changes code generation.
+  SmallVector<std::pair<unsigned, MDNode *>, 4> lhsAttachments;
+  SmallVector<std::pair<unsigned, MDNode *>, 4> rhsAttachments;
+  lhs.getAllMetadata(lhsAttachments);
+  rhs.getAllMetadata(rhsAttachments);
+  if (!compareAttachments(lhsAttachments, rhsAttachments))
+    return false;
+
+  for (auto [lhsArg, rhsArg] : zip(lhs.args(), rhs.args()))
+    m_valueMap[&lhsArg] = &rhsArg;
+
+  // Pair up all blocks and instructions first, as operands can refer forward.
+  SmallVector<std::pair<const Instruction *, const Instruction *>, 64> instPairs;
+  for (auto [lhsBlock, rhsBlock] : zip(lhs, rhs)) {
+    m_valueMap[&lhsBlock] = &rhsBlock;
+    SmallVector<const Instruction *, 32> lhsInsts = getNonDebugInstructions(lhsBlock);
+    SmallVector<const Instruction *, 32> rhsInsts = getNonDebugInstructions(rhsBlock);
+    if (lhsInsts.size() != rhsInsts.size())
+      return false;
+    for (auto [lhsInst, rhsInst] : zip(lhsInsts, rhsInsts)) {
+      m_valueMap[lhsInst] = rhsInst;
+      instPairs.push_back({lhsInst, rhsInst});
+    }
+  }
+
+  for (auto [lhsInst, rhsInst] : instPairs) {
+    // isSameOperationAs checks opcode, types and instruction specific state such as predicates, alignment and call
+    // attributes; the optional data holds flags like nuw/nsw, exact and fast-math.
+    if (!lhsInst->isSameOperationAs(rhsInst) ||
+        lhsInst->getRawSubclassOptionalData() != rhsInst->getRawSubclassOptionalData())
+      return false;
+    for (auto [lhsOp, rhsOp] : zip(lhsInst->operands(), rhsInst->operands())) {
+      if (!compareValues(lhsOp.get(), rhsOp.get()))
+        return false;
+    }
+    if (auto *lhsPhi = dyn_cast<PHINode>(lhsInst)) {
+      auto *rhsPhi = cast<PHINode>(rhsInst);
+      for (auto [lhsBlock, rhsBlock] : zip(lhsPhi->blocks(), rhsPhi->blocks())) {
+        if (m_valueMap.lookup(lhsBlock) != rhsBlock)
+          return false;
+      }
+    }
+
+    SmallVector<std::pair<unsigned, MDNode *>, 4> lhsInstAttachments;
+    SmallVector<std::pair<unsigned, MDNode *>, 4> rhsInstAttachments;
+    lhsInst->getAllMetadataOtherThanDebugLoc(lhsInstAttachments);
+    rhsInst->getAllMetadataOtherThanDebugLoc(rhsInstAttachments);
+    if (!compareAttachments(lhsInstAttachments, rhsInstAttachments))
+      return false;
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Compares two operands. Values local to a definition must have been paired up; declarations are paired by name.
+//
+// @param lhs : Value of the first module
+// @param rhs : Value of the second module
+bool ModuleComparator::compareValues(const Value *lhs, const Value *rhs) {
+  // Types, constants not referring to globals, inline asm and metadata are uniqued in the context.
+  if (lhs == rhs)
+    return true;
+  if (!lhs || !rhs || lhs->getType() != rhs->getType())
+    return false;
+
+  auto it = m_valueMap.find(lhs);
+  if (it != m_valueMap.end())
+    return it->second == rhs;
+
+  if (auto *lhsGlobal = dyn_cast<GlobalValue>(lhs)) {
+    auto *rhsGlobal = dyn_cast<GlobalValue>(rhs);
+    if (!rhsGlobal || !lhsGlobal->isDeclaration() || !rhsGlobal->isDeclaration() ||
+        lhsGlobal->getValueID() != rhsGlobal->getValueID() || lhsGlobal->getName() != rhsGlobal->getName() ||
+        lhsGlobal->getValueType() != rhsGlobal->getValueType())
+      return false;
+    if (auto *lhsFunc = dyn_cast<Function>(lhsGlobal)) {
+      if (lhsFunc->getAttributes() != cast<Function>(rhsGlobal)->getAttributes())
+        return false;
+    }
+    m_valueMap[lhs] = rhs;
+    return true;
+  }
+
+  if (isa<Constant>(lhs) && isa<Constant>(rhs))
+    return compareConstants(cast<Constant>(lhs), cast<Constant>(rhs));
+  return false;
+}
+
+// =====================================================================================================================
+// Compares two distinct constants of the same type, which can only be equal if they refer to paired globals.
+//
+// @param lhs : Constant of the first module
+// @param rhs : Constant of the second module
+bool ModuleComparator::compareConstants(const Constant *lhs, const Constant *rhs) {
+  if (lhs->getValueID() != rhs->getValueID() || lhs->getNumOperands() != rhs->getNumOperands())
+    return false;
+
+  if (auto *lhsExpr = dyn_cast<ConstantExpr>(lhs)) {
+    auto *rhsExpr = cast<ConstantExpr>(rhs);
+    if (lhsExpr->getOpcode() != rhsExpr->getOpcode() ||
+        lhsExpr->getRawSubclassOptionalData() != rhsExpr->getRawSubclassOptionalData())
+      return false;
+    if (auto *lhsGep = dyn_cast<GEPOperator>(lhsExpr)) {
+      if (lhsGep->getSourceElementType() != cast<GEPOperator>(rhsExpr)->getSourceElementType())
+        return false;
+    } else if (!Instruction::isCast(lhsExpr->getOpcode()) && !Instruction::isBinaryOp(lhsExpr->getOpcode())) {
+      // Other kinds of expression have extra state that is not worth checking here.
+      return false;
+    }
+  } else if (!isa<ConstantAggregate>(lhs)) {
+    return false;
+  }
+
+  for (auto [lhsOp, rhsOp] : zip(lhs->operands(), rhs->operands())) {
+    if (!compareValues(lhsOp.get(), rhsOp.get()))
+      return false;
+  }
+  return true;
+}
+
+namespace Llpc {
+
+// =====================================================================================================================
+// Computes a hash of the function bodies in a module that ignores value names and debug info. Only the shape of the
+// code is hashed: opcodes, types and operand counts.
+//
+// @param module : Module to hash
+uint64_t getStructuralHash(const Module &module) {
+  MetroHash::MetroHash64 hasher;
+  for (const Function &func : module) {
+    if (func.isDeclaration())
+      continue;
+    hasher.Update(static_cast<unsigned>(func.size()));
+    hasher.Update(static_cast<unsigned>(func.arg_size()));
+    for (const BasicBlock &block : func) {
+      for (const Instruction *inst : getNonDebugInstructions(block)) {
+        hasher.Update(inst->getOpcode());
+        hasher.Update(static_cast<unsigned>(inst->getType()->getTypeID()));
+        hasher.Update(inst->getNumOperands());
+      }
+    }
+  }
+  for (const GlobalVariable &global : module.globals())
+    hasher.Update(static_cast<unsigned>(global.isDeclaration()));
+
+  MetroHash::Hash hash = {};
+  hasher.Finalize(hash.bytes);
+  return MetroHash::compact64(&hash);
+}
+
+// =====================================================================================================================
+// Checks whether two modules in the same LLVMContext are identical apart from the names of the module, its defined
+// functions and values, and debug info.
+//
+// @param lhs : First module
+// @param rhs : Second module
+bool isStructurallyEqual(const Module &lhs, const Module &rhs) {
+  return ModuleComparator(lhs, rhs).compare();
+}
+
+} // namespace Llpc
@@ -0,0 +1,49 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcStructuralHash.h
+ * @brief LLPC header file: contains utilities to detect structurally identical modules
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace Llpc {
+
+// Computes a hash of the function bodies in a module that ignores value names and debug info. Modules for which
+// isStructurallyEqual() returns true have the same hash.
+uint64_t getStructuralHash(const llvm::Module &module);
+
+// Checks whether two modules in the same LLVMContext are identical apart from the names of the module, its defined
+// functions and values, and debug info, so that compiling either gives the same code.
+bool isStructurallyEqual(const llvm::Module &lhs, const llvm::Module &rhs);
+
+} // namespace Llpc
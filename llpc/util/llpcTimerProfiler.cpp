@@ -34,9 +34,11 @@
 #include "lgc/LgcContext.h"
 #include "lgc/PassManager.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/IR/PassInstrumentation.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -48,6 +50,11 @@ namespace cl {
 // -enable-time-profile : profile the compile time of pipeline
 opt<bool> EnableTimerProfile("enable-timer-profile", desc("profile the compile time of pipeline"), init(false));
 
+// -enable-memory-profile : report the peak process-wide heap usage sampled during each pipeline compile
+opt<bool> EnableMemoryProfile("enable-memory-profile",
+                              desc("report the peak process-wide heap usage sampled during each pipeline compile"),
+                              init(false));
+
 } // namespace cl
 
 } // namespace llvm
@@ -103,6 +110,14 @@ TimerProfiler::TimerProfiler(uint64_t hash64, const char *descriptionPrefix, uns
     // Start whole timer
     m_wholeTimer.startTimer();
   }
+
+  if (cl::EnableMemoryProfile) {
+    raw_string_ostream ostream(m_memoryDescription);
+    ostream << descriptionPrefix << format(" 0x%016" PRIX64, hash64);
+    ostream.flush();
+    m_baseMemory = sys::Process::GetMallocUsage();
+    m_peakMemory = m_baseMemory;
+  }
 }
 
 // =====================================================================================================================
@@ -111,6 +126,12 @@ TimerProfiler::~TimerProfiler() {
     // Stop whole timer
     m_wholeTimer.stopTimer();
   }
+
+  if (cl::EnableMemoryProfile) {
+    sampleMemoryUsage();
+    outs() << m_memoryDescription << " Peak Heap Usage (process-wide, sampled): " << getPeakMemoryUsage()
+           << " bytes\n";
+  }
 }
 
 // =====================================================================================================================
@@ -122,6 +143,12 @@ TimerProfiler::~TimerProfiler() {
 void TimerProfiler::addTimerStartStopPass(lgc::PassManager &passMgr, TimerKind timerKind, bool start) {
   if (TimePassesIsEnabled || cl::EnableTimerProfile)
     lgc::LgcContext::createAndAddStartStopTimer(passMgr, &m_phaseTimers[timerKind], start);
+
+  // Sample the heap after every pass run by this pass manager, so the peak is seen at pass granularity.
+  if (cl::EnableMemoryProfile && m_instrumentedPassMgrs.insert(&passMgr).second) {
+    passMgr.getInstrumentationCallbacks().registerAfterPassCallback(
+        [this](StringRef, Any, const PreservedAnalyses &) { sampleMemoryUsage(); });
+  }
 }
 
 // =====================================================================================================================
@@ -136,6 +163,17 @@ void TimerProfiler::startStopTimer(TimerKind timerKind, bool start) {
     else
       m_phaseTimers[timerKind].stopTimer();
   }
+  sampleMemoryUsage();
+}
+
+// =====================================================================================================================
+// Samples the current heap usage and updates the peak. The usage is that of the whole process, so allocations by other
+// threads are included. The peak is only as precise as the sampling points: phase boundaries, passes run by pass
+// managers given to addTimerStartStopPass, and explicit calls from the compiler. The patch, optimization and codegen
+// passes run inside lgc::Pipeline::generate are not sampled individually.
+void TimerProfiler::sampleMemoryUsage() {
+  if (cl::EnableMemoryProfile)
+    m_peakMemory = std::max(m_peakMemory, sys::Process::GetMallocUsage());
 }
 
 // =====================================================================================================================
@@ -32,6 +32,7 @@
 #pragma once
 
 #include "llpc.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Timer.h"
 
@@ -72,6 +73,11 @@ public:
 
   static const llvm::StringMap<llvm::TimeRecord> &getDummyTimeRecords();
 
+  void sampleMemoryUsage();
+
+  // Gets the peak process-wide heap usage seen by sampleMemoryUsage() above the usage at construction, in bytes.
+  size_t getPeakMemoryUsage() const { return m_peakMemory - m_baseMemory; }
+
   static const unsigned PipelineTimerEnableMask = ((1 << TimerCount) - 1);
   static const unsigned ShaderModuleTimerEnableMask = ((1 << TimerTranslate) | (1 << TimerLower));
 
@@ -83,6 +89,12 @@ private:
   llvm::TimerGroup m_phases;             // TimeGroup for each phase
   llvm::Timer m_wholeTimer;              // Whole timer
   llvm::Timer m_phaseTimers[TimerCount]; // Phase timer
+
+  std::string m_memoryDescription; // Description used in the peak memory report
+  size_t m_baseMemory = 0;         // Heap usage when the profiler was created
+  size_t m_peakMemory = 0;         // Highest heap usage sampled so far
+
+  llvm::SmallPtrSet<lgc::PassManager *, 4> m_instrumentedPassMgrs; // Pass managers sampling memory after each pass
 };
 
 } // namespace Llpc
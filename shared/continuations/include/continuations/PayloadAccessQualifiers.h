@@ -39,6 +39,7 @@
 #include "llvm/ADT/MapVector.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
+#include <memory>
 #include <optional>
 
 namespace llvm {
@@ -876,6 +877,11 @@ struct PAQCallShaderSerializationInfo : public PAQSerializationInfoBase {
 
 // Helper class to obtain serialization infos, importing DXIL PAQ metadata,
 // and caching already seen serialization infos.
+// The caches live in an LLVMContext extension and are shared by all managers
+// created for modules with the same PAQ annotations, register budget and
+// GPURT library layout, so that PAQ trees and layouts are computed once per
+// context instead of once per module and pass run. The extension only keeps
+// the caches for a bounded number of such keys.
 class PAQSerializationInfoManager {
 public:
   PAQSerializationInfoManager(Module *M, Module *GpurtLibrary,
@@ -969,8 +975,16 @@ private:
                                  const PAQPayloadConfig &PAQConfig);
   };
 
-  PAQCache<PAQTraceRaySerializationInfo> TraceRayCache;
-  PAQCache<PAQCallShaderSerializationInfo> CallShaderCache;
+  struct PAQCaches {
+    PAQCache<PAQTraceRaySerializationInfo> TraceRayCache;
+    PAQCache<PAQCallShaderSerializationInfo> CallShaderCache;
+  };
+
+  // LLVMContext extension owning the PAQCaches, see the .cpp file.
+  class ContextCache;
+
+  // Shared with the ContextCache of Mod's context while it keeps them.
+  std::shared_ptr<PAQCaches> Caches;
 };
 
 } // namespace llvm
@@ -36,11 +36,14 @@
 
 #include "continuations/PayloadAccessQualifiers.h"
 #include "continuations/Continuations.h"
+#include "llvm-dialects/Dialect/ContextExtension.h"
 #include "llvm/ADT/EnumeratedArray.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <list>
 #include <memory>
+#include <tuple>
 
 using namespace llvm;
 
@@ -773,15 +776,18 @@ createTrivialHierarchicalPayloadRootNode(Type &PayloadType) {
 // This function only imports qualifiers on direct members from DXIL metadata.
 // Recursive traversal of nested structs is done later, using the annotations on
 // the top-level payload structs collected in this first phase.
-static MapVector<Type *, std::unique_ptr<PAQNode>>
-importModulePAQRootNodes(const Module &M) {
-  LLVM_DEBUG(dbgs() << "Importing DXIL PAQ metadata\n");
+//
+// findPayloadAnnotationNode locates the struct annotation node, which is then
+// passed to importModulePAQRootNodes. Because metadata tuples are uniqued per
+// LLVMContext, the node also identifies the annotations of a module for the
+// purpose of sharing PAQ caches between modules.
+static MDNode *findPayloadAnnotationNode(const Module &M) {
   auto *MDName = "dx.dxrPayloadAnnotations";
   auto *MD = M.getNamedMetadata(MDName);
   if (!MD) {
     LLVM_DEBUG(dbgs() << "PAQ: metadata " << MDName
                       << " not found, skipping PAQ import\n");
-    return {};
+    return nullptr;
   }
 
   // Traverse the operands, and check that there is a unique node that is a
@@ -807,8 +813,14 @@ importModulePAQRootNodes(const Module &M) {
   if (!AnnotationMDTup) {
     LLVM_DEBUG(dbgs() << "PAQ: failed to find struct annotation node, "
                          "skipping PAQ import\n");
-    return {};
   }
+  return AnnotationMDTup;
+}
+
+static MapVector<Type *, std::unique_ptr<PAQNode>>
+importModulePAQRootNodes(const MDNode *AnnotationMDTup) {
+  if (!AnnotationMDTup)
+    return {};
 
   // Check length: One tag node, plus type/node pairs, so must be odd.
   if (AnnotationMDTup->getNumOperands() % 2 != 1)
@@ -841,13 +853,13 @@ importModulePAQRootNodes(const Module &M) {
 // metadata is present. For payload types without annotations, trivial
 // PAQ trees are created later on demand.
 static MapVector<Type *, std::unique_ptr<PAQNode>>
-importModulePayloadPAQNodes(const Module &M) {
+importModulePayloadPAQNodes(const MDNode *AnnotationMDTup) {
   // Import from metadata. This needs to happen for all structs
   // before we recursively traverse field members, because
   // payload fields can be of payload struct type, in which case
   // the qualifiers are obtained from its type.
   MapVector<Type *, std::unique_ptr<PAQNode>> PayloadRootNodes =
-      importModulePAQRootNodes(M);
+      importModulePAQRootNodes(AnnotationMDTup);
 
   // Recursively create the nested struct hierarchy
   for (auto &TypeWithInfo : PayloadRootNodes) {
@@ -1854,11 +1866,77 @@ PAQCallShaderSerializationInfo::create(Module &M,
   return Result;
 }
 
+// LLVMContext extension holding the PAQ caches of the managers created in the
+// context. Serialization infos only depend on the payload annotations, the
+// payload register budget, the inline hit attribute type of the GPURT library
+// and the data layouts. All of these are captured by CacheKey, with the
+// uniqued annotation node standing in for the annotation contents. Payload
+// types, annotation nodes and the struct types created for layouts are all
+// owned by the context, so cached infos stay valid for its whole lifetime.
+//
+// A context may live across many pipeline compilations, so only the caches
+// for the MaxCacheCount most recently used keys are kept. Managers share
+// ownership of their caches, so dropping one here does not invalidate the
+// infos and layouts a live manager has handed out.
+class PAQSerializationInfoManager::ContextCache
+    : public llvm_dialects::ContextExtensionImpl<ContextCache> {
+public:
+  explicit ContextCache(LLVMContext &) {}
+
+  static Key theKey;
+
+  static constexpr unsigned MaxCacheCount = 16;
+
+  using CacheKey = std::tuple<const MDNode *, uint32_t, Type *, std::string,
+                              std::string>;
+
+  // Get the caches for Key, creating them with the PAQ trees imported from
+  // AnnotationMDTup if they are not cached.
+  std::shared_ptr<PAQCaches> getOrCreate(const CacheKey &Key,
+                                         const MDNode *AnnotationMDTup) {
+    auto It = find_if(Caches, [&](const auto &Entry) {
+      return Entry.first == Key;
+    });
+    if (It != Caches.end()) {
+      Caches.splice(Caches.begin(), Caches, It);
+      return Caches.front().second;
+    }
+
+    auto NewCaches = std::make_shared<PAQCaches>();
+    NewCaches->TraceRayCache.PAQRootNodes =
+        importModulePayloadPAQNodes(AnnotationMDTup);
+    Caches.emplace_front(Key, NewCaches);
+    if (Caches.size() > MaxCacheCount)
+      Caches.pop_back();
+    return NewCaches;
+  }
+
+private:
+  // Most recently used first.
+  std::list<std::pair<CacheKey, std::shared_ptr<PAQCaches>>> Caches;
+};
+
+PAQSerializationInfoManager::ContextCache::Key
+    PAQSerializationInfoManager::ContextCache::theKey;
+
 PAQSerializationInfoManager::PAQSerializationInfoManager(
     Module *M, Module *GpurtLibrary, uint32_t MaxPayloadRegCount)
     : Mod{M}, GpurtLibrary{GpurtLibrary},
       MaxPayloadRegisterCount(MaxPayloadRegCount) {
-  TraceRayCache.PAQRootNodes = importModulePayloadPAQNodes(*M);
+  LLVM_DEBUG(dbgs() << "Importing DXIL PAQ metadata\n");
+  const MDNode *AnnotationMDTup = findPayloadAnnotationNode(*M);
+  Type *InlineHitAttrsTy = nullptr;
+  if (Function *GetTriangleHitAttributes =
+          GpurtLibrary->getFunction("_cont_GetTriangleHitAttributes"))
+    InlineHitAttrsTy = GetTriangleHitAttributes->getReturnType();
+
+  ContextCache::CacheKey Key{AnnotationMDTup, MaxPayloadRegisterCount,
+                             InlineHitAttrsTy,
+                             M->getDataLayout().getStringRepresentation(),
+                             GpurtLibrary->getDataLayout()
+                                 .getStringRepresentation()};
+  Caches =
+      ContextCache::get(M->getContext()).getOrCreate(Key, AnnotationMDTup);
 }
 
 PAQSerializationInfoBase &
@@ -1882,7 +1960,7 @@ PAQSerializationInfoManager::getOrCreateSerializationInfo(
 PAQTraceRaySerializationInfo &
 PAQSerializationInfoManager::getOrCreateTraceRaySerializationInfo(
     const PAQPayloadConfig &PAQConfig) {
-  return TraceRayCache.getOrCreateSerializationInfo(
+  return Caches->TraceRayCache.getOrCreateSerializationInfo(
       *GpurtLibrary, MaxPayloadRegisterCount, PAQConfig);
 }
 
@@ -1892,7 +1970,7 @@ PAQSerializationInfoManager::getOrCreateCallShaderSerializationInfo(
   // Ensure caching doesn't depend on irrelevant fields
   PAQPayloadConfig PAQConfigWithRelevantData = PAQConfig;
   PAQConfigWithRelevantData.MaxHitAttributeByteCount = 0;
-  return CallShaderCache.getOrCreateSerializationInfo(
+  return Caches->CallShaderCache.getOrCreateSerializationInfo(
       *GpurtLibrary, MaxPayloadRegisterCount, PAQConfigWithRelevantData);
 }
 
@@ -0,0 +1,133 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2024 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ **********************************************************************************************************************/
+
+//===----------------------------------------------------------------------===//
+//
+// Unit tests for sharing PAQ serialization infos between modules
+//
+//===----------------------------------------------------------------------===//
+
+#include "continuations/PayloadAccessQualifiers.h"
+#include "lgc/LgcCpsDialect.h"
+#include "llvm-dialects/Dialect/Dialect.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+const char *const TestDataLayout =
+    "e-p:64:64-p1:64:64-p2:32:32-p3:32:32-p4:64:64-p5:32:32-p6:"
+    "32:32-p7:160:256:256:32-p8:128:128-i64:64-v16:16-v24:32-v32:"
+    "32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024-"
+    "v2048:2048-n32:64-S32-A5-G1-ni:7:8";
+
+constexpr uint32_t MaxPayloadRegisterCount = 30;
+
+class PAQCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    DialectContext =
+        llvm_dialects::DialectContext::make<lgc::cps::LgcCpsDialect>(Context);
+    GpurtLibrary = createModule("gpurt");
+    // Two dwords of inline hit attributes, as for triangle barycentrics.
+    Type *InlineHitAttrsTy =
+        StructType::get(FixedVectorType::get(Type::getFloatTy(Context), 2));
+    Function::Create(FunctionType::get(InlineHitAttrsTy, false),
+                     GlobalValue::ExternalLinkage,
+                     "_cont_GetTriangleHitAttributes", *GpurtLibrary);
+    PayloadTy = StructType::create(
+        {Type::getInt32Ty(Context), Type::getFloatTy(Context)},
+        "struct.Payload");
+  }
+
+  std::unique_ptr<Module> createModule(StringRef Name) {
+    auto M = std::make_unique<Module>(Name, Context);
+    M->setDataLayout(TestDataLayout);
+    return M;
+  }
+
+  LLVMContext Context;
+  std::unique_ptr<llvm_dialects::DialectContext> DialectContext;
+  std::unique_ptr<Module> GpurtLibrary;
+  StructType *PayloadTy = nullptr;
+};
+
+TEST_F(PAQCacheTest, SecondModuleReusesSerializationInfo) {
+  std::unique_ptr<Module> M1 = createModule("first");
+  PAQSerializationInfoManager Manager1(&*M1, &*GpurtLibrary,
+                                       MaxPayloadRegisterCount);
+  PAQPayloadConfig Config(PayloadTy, 8);
+  PAQTraceRaySerializationInfo &Info1 =
+      Manager1.getOrCreateTraceRaySerializationInfo(Config);
+  PAQCallShaderSerializationInfo &CallInfo1 =
+      Manager1.getOrCreateCallShaderSerializationInfo(Config);
+
+  // A module compiled later in the same context gets the same infos without
+  // computing them again.
+  std::unique_ptr<Module> M2 = createModule("second");
+  PAQSerializationInfoManager Manager2(&*M2, &*GpurtLibrary,
+                                       MaxPayloadRegisterCount);
+  EXPECT_EQ(&Manager2.getOrCreateTraceRaySerializationInfo(Config), &Info1);
+  EXPECT_EQ(&Manager2.getOrCreateCallShaderSerializationInfo(Config),
+            &CallInfo1);
+
+  // A different register budget gives different layouts.
+  PAQSerializationInfoManager Manager3(&*M2, &*GpurtLibrary,
+                                       MaxPayloadRegisterCount - 1);
+  EXPECT_NE(&Manager3.getOrCreateTraceRaySerializationInfo(Config), &Info1);
+}
+
+TEST_F(PAQCacheTest, CacheIsBounded) {
+  std::unique_ptr<Module> M = createModule("module");
+  PAQPayloadConfig Config(PayloadTy, 8);
+  auto FirstManager = std::make_unique<PAQSerializationInfoManager>(
+      &*M, &*GpurtLibrary, MaxPayloadRegisterCount);
+  PAQTraceRaySerializationInfo &FirstInfo =
+      FirstManager->getOrCreateTraceRaySerializationInfo(Config);
+
+  // Use enough other register budgets to push the first one out of the cache.
+  for (uint32_t RegCount = 1; RegCount <= 32; ++RegCount) {
+    PAQSerializationInfoManager Manager(&*M, &*GpurtLibrary,
+                                        MaxPayloadRegisterCount + RegCount);
+    Manager.getOrCreateTraceRaySerializationInfo(Config);
+  }
+
+  // The evicted infos are recomputed for a new manager, while the manager
+  // that still uses them keeps them alive.
+  PAQSerializationInfoManager NewManager(&*M, &*GpurtLibrary,
+                                         MaxPayloadRegisterCount);
+  EXPECT_NE(&NewManager.getOrCreateTraceRaySerializationInfo(Config),
+            &FirstInfo);
+  EXPECT_EQ(&FirstManager->getOrCreateTraceRaySerializationInfo(Config),
+            &FirstInfo);
+  EXPECT_EQ(FirstInfo.PAQConfig.PayloadTy, PayloadTy);
+}
+
+} // namespace
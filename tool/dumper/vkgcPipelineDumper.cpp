@@ -35,6 +35,7 @@
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <sys/stat.h>
 #include <unordered_set>
@@ -214,6 +215,21 @@ uint64_t VKAPI_CALL IPipelineDumper::GetPipelineHash(const GraphicsPipelineBuild
   return MetroHash::compact64(&hash);
 }
 
+// =====================================================================================================================
+// Calculates the hash code of the vertex-input-specialized variant of a graphics pipeline that uses the uber fetch
+// shader.
+//
+// @param pipelineInfo : Info used to build the uber fetch shader variant of this graphics pipeline
+// @param vertexInput : Vertex input state observed at bind time
+uint64_t VKAPI_CALL IPipelineDumper::GetUberFetchSpecializedPipelineHash(
+    const GraphicsPipelineBuildInfo *pipelineInfo, const VkPipelineVertexInputStateCreateInfo *vertexInput) {
+  GraphicsPipelineBuildInfo specializedInfo = *pipelineInfo;
+  specializedInfo.pVertexInput = vertexInput;
+  specializedInfo.enableUberFetchShader = false;
+  auto hash = PipelineDumper::generateHashForGraphicsPipeline(&specializedInfo, false);
+  return MetroHash::compact64(&hash);
+}
+
 // =====================================================================================================================
 // Get graphics pipeline name.
 //
@@ -1746,6 +1762,30 @@ void PipelineDumper::updateHashForPipelineOptions(const PipelineOptions *options
   hasher->Update(options->enablePrimGeneratedQuery);
 }
 
+// =====================================================================================================================
+// Updates hash code context for the specialization constant values in the specialization info. Each constant ID is
+// hashed together with its effective value, in ascending ID order, so that specialization infos that pack the same
+// values differently hash the same.
+//
+// @param specializationInfo : Specialization info (may be null)
+// @param [in/out] hasher : Hasher to generate hash code
+void PipelineDumper::updateHashForSpecConstants(const VkSpecializationInfo *specializationInfo, MetroHash64 *hasher) {
+  // A later map entry for the same constant ID overrides an earlier one, as in the SPIR-V reader.
+  std::map<unsigned, const VkSpecializationMapEntry *> mapEntries;
+  if (specializationInfo) {
+    for (unsigned i = 0; i < specializationInfo->mapEntryCount; ++i)
+      mapEntries[specializationInfo->pMapEntries[i].constantID] = &specializationInfo->pMapEntries[i];
+  }
+
+  hasher->Update(static_cast<unsigned>(mapEntries.size()));
+  for (const auto &mapEntry : mapEntries) {
+    hasher->Update(mapEntry.first);
+    hasher->Update(static_cast<uint64_t>(mapEntry.second->size));
+    hasher->Update(static_cast<const uint8_t *>(voidPtrInc(specializationInfo->pData, mapEntry.second->offset)),
+                   mapEntry.second->size);
+  }
+}
+
 // =====================================================================================================================
 // Updates hash code context for pipeline shader stage.
 //
@@ -1774,13 +1814,19 @@ void PipelineDumper::updateHashForPipelineShaderInfo(ShaderStage stage, const Pi
       hasher->Update(entryNameLen);
 
     auto specializationInfo = shaderInfo->pSpecializationInfo;
-    unsigned mapEntryCount = specializationInfo ? specializationInfo->mapEntryCount : 0;
-    hasher->Update(mapEntryCount);
-    if (mapEntryCount > 0) {
-      hasher->Update(reinterpret_cast<const uint8_t *>(specializationInfo->pMapEntries),
-                     sizeof(VkSpecializationMapEntry) * specializationInfo->mapEntryCount);
-      hasher->Update(specializationInfo->dataSize);
-      hasher->Update(reinterpret_cast<const uint8_t *>(specializationInfo->pData), specializationInfo->dataSize);
+    if (isCacheHash) {
+      // Specialization info cannot affect the generated code of a module that declares no specialization constants,
+      // so leave it out of the cache hash in that case.
+      updateHashForSpecConstants(moduleData->usage.useSpecConstant ? specializationInfo : nullptr, hasher);
+    } else {
+      unsigned mapEntryCount = specializationInfo ? specializationInfo->mapEntryCount : 0;
+      hasher->Update(mapEntryCount);
+      if (mapEntryCount > 0) {
+        hasher->Update(reinterpret_cast<const uint8_t *>(specializationInfo->pMapEntries),
+                       sizeof(VkSpecializationMapEntry) * specializationInfo->mapEntryCount);
+        hasher->Update(specializationInfo->dataSize);
+        hasher->Update(reinterpret_cast<const uint8_t *>(specializationInfo->pData), specializationInfo->dataSize);
+      }
     }
 
     if (isCacheHash) {
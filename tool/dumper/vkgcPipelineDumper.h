@@ -81,6 +81,8 @@ public:
   static void updateHashForPipelineShaderInfo(ShaderStage stage, const PipelineShaderInfo *shaderInfo, bool isCacheHash,
                                               MetroHash64 *hasher);
 
+  static void updateHashForSpecConstants(const VkSpecializationInfo *specializationInfo, MetroHash64 *hasher);
+
   static void updateHashForResourceMappingInfo(const ResourceMappingData *resourceMapping,
                                                const uint64_t pipelineLayoutApiHash, MetroHash64 *hasher,
                                                ShaderStage stage = ShaderStageInvalid);
@@ -625,4 +625,6 @@ void VFXAPI vfxGetPipelineDoc(void *pDoc, VfxPipelineStatePtr *pPipelineState);
 
 void VFXAPI vfxPrintDoc(void *pDoc);
 
+void VFXAPI vfxSetShaderCacheDir(const char *pCacheDir);
+
 } // namespace Vfx
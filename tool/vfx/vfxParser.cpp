@@ -1429,4 +1429,14 @@ void VFXAPI vfxPrintDoc(void *doc) {
   reinterpret_cast<Document *>(doc)->printSelf();
 }
 
+// =====================================================================================================================
+// Sets the directory of the SPIR-V binary cache. Shader sections given as GLSL, HLSL or SPIR-V assembly are translated
+// to SPIR-V only on a cache miss; the result is then stored in the cache for later loads. An empty or null directory
+// disables the cache. Not thread-safe; call it before parsing any document.
+//
+// @param cacheDir : Cache directory, which must already exist
+void VFXAPI vfxSetShaderCacheDir(const char *cacheDir) {
+  SectionShader::setCacheDir(cacheDir);
+}
+
 } // namespace Vfx
@@ -32,7 +32,17 @@
 #include "vfxSection.h"
 #include "vfxEnumsConverter.h"
 #include "vfxParser.h"
+#include <atomic>
 #include <inttypes.h>
+#include <random>
+#include <set>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 #ifndef VFX_DISABLE_SPVGEN
 #include "spvgen.h"
@@ -43,6 +53,112 @@ namespace Vfx {
 // =====================================================================================================================
 // Static variables in class Section and derived class
 std::map<std::string, SectionInfo> Section::m_sectionInfo;
+std::string SectionShader::m_cacheDir;
+
+namespace {
+
+// =====================================================================================================================
+// 64-bit FNV-1a hasher for the SPIR-V cache key
+class CacheKeyHasher {
+public:
+  void add(const void *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      m_hash ^= static_cast<const uint8_t *>(data)[i];
+      m_hash *= 0x100000001b3ull;
+    }
+  }
+  void add(const std::string &str) { add(str.c_str(), str.size() + 1); }
+  void add(unsigned value) { add(&value, sizeof(value)); }
+  uint64_t get() const { return m_hash; }
+
+private:
+  uint64_t m_hash = 0xcbf29ce484222325ull;
+};
+
+// =====================================================================================================================
+// Gets the directory part of a path, including the trailing separator, or an empty string if there is none.
+//
+// @param path : File path
+std::string getDirectory(const std::string &path) {
+  auto separatorIndex = path.find_last_of("/\\");
+  return separatorIndex == std::string::npos ? "" : path.substr(0, separatorIndex + 1);
+}
+
+// =====================================================================================================================
+// Reads a whole text file. Returns false if the file cannot be opened.
+//
+// @param path : File path
+// @param [out] text : File contents
+bool readTextFile(const std::string &path, std::string *text) {
+  FILE *inFile = fopen(path.c_str(), "rb");
+  if (!inFile)
+    return false;
+  text->clear();
+  char buffer[4096];
+  size_t readSize = 0;
+  while ((readSize = fread(buffer, 1, sizeof(buffer), inFile)) > 0)
+    text->append(buffer, readSize);
+  fclose(inFile);
+  return true;
+}
+
+// =====================================================================================================================
+// Adds the names and contents of the files #included by the given GLSL/HLSL source to the cache key, recursively.
+// Every #include line counts, even one that the preprocessor would skip; that only makes the key stricter. Returns
+// false if an included file cannot be found, in which case the shader must not be cached.
+//
+// @param source : Shader source text
+// @param searchDirs : Directories to look for included files in, in order
+// @param [in/out] visited : Paths of the included files already scanned
+// @param [in/out] hasher : Cache key hasher
+bool hashIncludedFiles(const std::string &source, const std::vector<std::string> &searchDirs,
+                       std::set<std::string> &visited, CacheKeyHasher &hasher) {
+  std::istringstream sourceStream(source);
+  std::string line;
+  while (std::getline(sourceStream, line)) {
+    size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] != '#')
+      continue;
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos || line.compare(pos, 7, "include") != 0)
+      continue;
+    pos = line.find_first_of("\"<", pos + 7);
+    if (pos == std::string::npos)
+      continue;
+    size_t endPos = line.find(line[pos] == '"' ? '"' : '>', pos + 1);
+    if (endPos == std::string::npos)
+      continue;
+    std::string includeName = line.substr(pos + 1, endPos - pos - 1);
+
+    std::string includePath;
+    std::string includeText;
+    bool found = false;
+    for (const std::string &dir : searchDirs) {
+      includePath = dir + includeName;
+      if (readTextFile(includePath, &includeText)) {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      return false;
+
+    hasher.add(includeName);
+    hasher.add(includeText);
+    if (!visited.insert(includePath).second)
+      continue;
+
+    // Nested includes are looked up relative to the including file first.
+    std::vector<std::string> nestedSearchDirs;
+    nestedSearchDirs.push_back(getDirectory(includePath));
+    nestedSearchDirs.insert(nestedSearchDirs.end(), searchDirs.begin(), searchDirs.end());
+    if (!hashIncludedFiles(includeText, nestedSearchDirs, visited, hasher))
+      return false;
+  }
+  return true;
+}
+
+} // anonymous namespace
 
 #ifndef VFX_DISABLE_SPVGEN
 // =====================================================================================================================
@@ -609,11 +725,8 @@ bool SectionShader::compileGlsl(const char *entryPoint, std::string *errorMsg) {
 
   sourceList[0] = &glslText;
   fileList[0] = &fileName;
-  int compileOption = SpvGenOptionDefaultDesktop | SpvGenOptionVulkanRules;
-  if (m_shaderType == Hlsl || m_shaderType == HlslFile)
-    compileOption |= SpvGenOptionReadHlsl;
   bool compileResult = spvCompileAndLinkProgramEx(1, &stage, &sourceStringCount, sourceList, fileList, &entryPoint,
-                                                  &program, &log, compileOption);
+                                                  &program, &log, getCompileOption());
 
   if (compileResult) {
     const unsigned *spvBin = nullptr;
@@ -670,6 +783,147 @@ bool SectionShader::assembleSpirv(std::string *errorMsg) {
   return result;
 }
 
+// =====================================================================================================================
+// Translates shader source to SPIR-V binary, reusing the binary from the SPIR-V cache if one is set and holds it.
+//
+// @param docFilename : File name of parent document
+// @param entryPoint : Shader entry-point, or nullptr for the default
+// @param [out] errorMsg : Error message
+bool SectionShader::translateSource(const std::string &docFilename, const char *entryPoint, std::string *errorMsg) {
+  std::string cachePath = getCachePath(docFilename, entryPoint);
+  if (!cachePath.empty() && readCachedBinary(cachePath))
+    return true;
+
+  bool result = false;
+  if (m_shaderType == SpirvAsm || m_shaderType == SpirvAsmFile)
+    result = assembleSpirv(errorMsg);
+  else
+    result = compileGlsl(entryPoint, errorMsg);
+
+  if (result && !cachePath.empty())
+    writeCachedBinary(cachePath);
+  return result;
+}
+
+#ifndef VFX_DISABLE_SPVGEN
+// =====================================================================================================================
+// Gets the SPVGEN compile options for this GLSL or HLSL shader.
+int SectionShader::getCompileOption() const {
+  int compileOption = SpvGenOptionDefaultDesktop | SpvGenOptionVulkanRules;
+  if (m_shaderType == Hlsl || m_shaderType == HlslFile)
+    compileOption |= SpvGenOptionReadHlsl;
+  return compileOption;
+}
+#endif
+
+// =====================================================================================================================
+// Gets the path of the SPIR-V cache file for this shader, or an empty string if there is no cache or the shader cannot
+// be cached. The file name is a 64-bit FNV-1a hash of everything the translation depends on: the SPVGEN and glslang
+// versions, shader type, stage, compile options, entry-point, file name, source text and the contents of the
+// #included files.
+//
+// @param docFilename : File name of parent document
+// @param entryPoint : Shader entry-point, or nullptr for the default
+std::string SectionShader::getCachePath(const std::string &docFilename, const char *entryPoint) const {
+#ifndef VFX_DISABLE_SPVGEN
+  if (m_cacheDir.empty() || !InitSpvGen())
+    return "";
+
+  CacheKeyHasher hasher;
+  for (SpvGenVersion versionKind : {SpvGenVersionSpvGen, SpvGenVersionGlslang}) {
+    unsigned version = 0;
+    unsigned revision = 0;
+    if (!spvGetVersion(versionKind, &version, &revision))
+      return "";
+    hasher.add(version);
+    hasher.add(revision);
+  }
+
+  bool isSpirvAsm = m_shaderType == SpirvAsm || m_shaderType == SpirvAsmFile;
+  hasher.add(static_cast<unsigned>(m_shaderType));
+  hasher.add(static_cast<unsigned>(m_shaderStage));
+  hasher.add(isSpirvAsm ? 0u : static_cast<unsigned>(getCompileOption()));
+  hasher.add(entryPoint ? entryPoint : "");
+  hasher.add(m_fileName);
+  hasher.add(m_shaderSource);
+
+  if (!isSpirvAsm) {
+    // SPVGEN resolves includes relative to the shader file name it is given; also look next to the parent document
+    // and in the working directory, as a file found there can shadow or stand in for the first one.
+    std::vector<std::string> searchDirs = {getDirectory(m_fileName), getDirectory(docFilename), ""};
+    std::set<std::string> visited;
+    if (!hashIncludedFiles(m_shaderSource, searchDirs, visited, hasher))
+      return "";
+  }
+
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "%016" PRIx64 ".spv", hasher.get());
+  return m_cacheDir + "/" + fileName;
+#else
+  // Without SPVGEN the "binary" is the source text itself, so there is nothing to cache.
+  (void)docFilename;
+  (void)entryPoint;
+  return "";
+#endif
+}
+
+// =====================================================================================================================
+// Reads the SPIR-V binary for this shader from the SPIR-V cache. Returns false if the file is absent or does not hold
+// a SPIR-V module.
+//
+// @param cachePath : Path of the cache file
+bool SectionShader::readCachedBinary(const std::string &cachePath) {
+  FILE *inFile = fopen(cachePath.c_str(), "rb");
+  if (!inFile)
+    return false;
+
+  fseek(inFile, 0, SEEK_END);
+  long fileSize = ftell(inFile);
+  fseek(inFile, 0, SEEK_SET);
+
+  constexpr uint32_t SpirvMagicNumber = 0x07230203;
+  constexpr long SpirvHeaderSize = 5 * sizeof(uint32_t);
+  std::vector<uint8_t> spvBin;
+  if (fileSize >= SpirvHeaderSize && fileSize % sizeof(uint32_t) == 0) {
+    spvBin.resize(fileSize);
+    if (fread(spvBin.data(), 1, fileSize, inFile) != static_cast<size_t>(fileSize))
+      spvBin.clear();
+  }
+  fclose(inFile);
+
+  uint32_t magic = 0;
+  if (!spvBin.empty())
+    memcpy(&magic, spvBin.data(), sizeof(magic));
+  if (magic != SpirvMagicNumber)
+    return false;
+
+  m_spvBin = std::move(spvBin);
+  return true;
+}
+
+// =====================================================================================================================
+// Writes the SPIR-V binary for this shader to the SPIR-V cache. The file is written under a temporary name then
+// renamed, so that concurrent loaders never see a partial file. The temporary name is unique across processes and
+// threads sharing the cache directory. Failures are ignored; the cache is only an optimization.
+//
+// @param cachePath : Path of the cache file
+void SectionShader::writeCachedBinary(const std::string &cachePath) const {
+  static std::atomic<unsigned> tempFileCounter(0);
+  static const unsigned randomSeed = std::random_device()();
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), ".%u.%08x.%u.tmp", static_cast<unsigned>(getpid()), randomSeed,
+           tempFileCounter.fetch_add(1));
+  std::string tempPath = cachePath + suffix;
+
+  FILE *outFile = fopen(tempPath.c_str(), "wb");
+  if (!outFile)
+    return;
+  bool written = fwrite(m_spvBin.data(), 1, m_spvBin.size(), outFile) == m_spvBin.size();
+  written = fclose(outFile) == 0 && written;
+  if (!written || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    remove(tempPath.c_str());
+}
+
 // =====================================================================================================================
 // Returns true if this section contains shader source
 bool SectionShader::isShaderSourceSection() {
@@ -697,25 +951,17 @@ bool SectionShader::compileShader(const std::string &docFilename, const char *en
   bool result = false;
   switch (m_shaderType) {
   case Glsl:
-  case Hlsl: {
-    result = compileGlsl(entryPoint, errorMsg);
-    break;
-  }
-  case GlslFile:
-  case HlslFile: {
-    result = readFile(docFilename, m_fileName, false, &m_spvBin, &m_shaderSource, errorMsg);
-    if (result)
-      compileGlsl(entryPoint, errorMsg);
-    break;
-  }
+  case Hlsl:
   case SpirvAsm: {
-    result = assembleSpirv(errorMsg);
+    result = translateSource(docFilename, entryPoint, errorMsg);
     break;
   }
+  case GlslFile:
+  case HlslFile:
   case SpirvAsmFile: {
     result = readFile(docFilename, m_fileName, false, &m_spvBin, &m_shaderSource, errorMsg);
     if (result)
-      assembleSpirv(errorMsg);
+      translateSource(docFilename, entryPoint, errorMsg);
     break;
   }
   case SpirvFile: {
@@ -545,6 +545,8 @@ public:
   ShaderType getShaderType() { return m_shaderType; }
   ShaderStage getShaderStage() { return m_shaderStage; }
 
+  static void setCacheDir(const char *cacheDir) { m_cacheDir = cacheDir ? cacheDir : ""; }
+
 private:
   static StrToMemberAddrArrayRef getAddrTable() {
     static std::vector<StrToMemberAddr> addrTable = []() {
@@ -557,6 +559,13 @@ private:
 
   bool compileGlsl(const char *entryPoint, std::string *errorMsg);
   bool assembleSpirv(std::string *errorMsg);
+  int getCompileOption() const;
+  bool translateSource(const std::string &docFilename, const char *entryPoint, std::string *errorMsg);
+  std::string getCachePath(const std::string &docFilename, const char *entryPoint) const;
+  bool readCachedBinary(const std::string &cachePath);
+  void writeCachedBinary(const std::string &cachePath) const;
+
+  static std::string m_cacheDir; // Directory of the SPIR-V binary cache, empty if disabled
 
   std::string m_fileName;        // External shader source file name
   std::string m_shaderSource;    // Shader source code